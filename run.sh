@@ -50,8 +50,18 @@ cd ../..
 # Parse arguments to determine implementations and dataset
 SELECTED_IMPLEMENTATIONS=()
 DATASET=""
+CHECK=0
+BENCH=0
+TRACE_FLAGS=""
 for ARG in "$@"; do
-    if [[ -n ${IMPLEMENTATIONS[$ARG]} ]]; then
+    if [[ "$ARG" == "check" ]]; then
+        CHECK=1
+    elif [[ "$ARG" == "bench" ]]; then
+        BENCH=1
+    elif [[ "$ARG" == "trace" ]]; then
+        # Per-step instrumentation (src/trace.h), compiled out otherwise
+        TRACE_FLAGS="-DKMEANS_TRACE"
+    elif [[ -n ${IMPLEMENTATIONS[$ARG]} ]]; then
         SELECTED_IMPLEMENTATIONS+=("$ARG")
     else
         DATASET="$ARG"
@@ -83,6 +93,15 @@ if [ ${#SELECTED_IMPLEMENTATIONS[@]} -eq 0 ]; then
     SELECTED_IMPLEMENTATIONS=("s")
 fi
 
+# check mode compares every implementation against serial.cpp, so run serial first
+if [[ $CHECK -eq 1 ]]; then
+    OTHERS=()
+    for IMPL in "${SELECTED_IMPLEMENTATIONS[@]}"; do
+        [[ "$IMPL" != "s" ]] && OTHERS+=("$IMPL")
+    done
+    SELECTED_IMPLEMENTATIONS=("s" "${OTHERS[@]}")
+fi
+
 # Define directories
 EXECUTABLE_DIR="executables"
 
@@ -105,25 +124,47 @@ for IMPL in "${SELECTED_IMPLEMENTATIONS[@]}"; do
 
     # Compile the implementation and place the executable in the folder
     if [[ "$IMPL" == "p" || "$IMPL" == "a" || "$IMPL" == "b" || "$IMPL" == "u" ]]; then
-        g++ -std=c++11 -O3 -march=native \
+        g++ -std=c++11 -O3 $TRACE_FLAGS \
             -I$TBBROOT/include \
             -L$TBBROOT/lib/intel64/gcc4.8 \
             -ltbb -ltbbmalloc -ltbbmalloc_proxy \
             "$SOURCE_FILE" -o "$EXECUTABLE_PATH"
     else
-        g++ -std=c++11 -O3 -march=native "$SOURCE_FILE" -o "$EXECUTABLE_PATH"
+        g++ -std=c++11 -O3 $TRACE_FLAGS "$SOURCE_FILE" -o "$EXECUTABLE_PATH"
+    fi
+
+    # bench mode only builds here; benchmark.cpp runs the executables below
+    if [[ $BENCH -eq 1 ]]; then
+        BENCH_VARIANTS="${BENCH_VARIANTS:+$BENCH_VARIANTS,}$EXECUTABLE"
+        continue
     fi
 
     # Run K-Means and append results to output file
     echo "===== Running $EXECUTABLE on $DATASET =====" >> "$OUTPUT_FILE"
     echo "===== Running $EXECUTABLE on $DATASET ====="
-    cat "$DATASET" | "$EXECUTABLE_PATH" >> "$OUTPUT_FILE" 2>&1
+    # Redirect instead of piping so the loader can mmap the dataset
+    "$EXECUTABLE_PATH" < "$DATASET" > "$EXECUTABLE_DIR/$EXECUTABLE.out" 2>&1
+    cat "$EXECUTABLE_DIR/$EXECUTABLE.out" >> "$OUTPUT_FILE"
     echo "$EXECUTABLE Execution Completed!" >> "$OUTPUT_FILE"
     echo "===== $EXECUTABLE Execution Completed! ====="
     echo ""
     echo "" >> "$OUTPUT_FILE"
 done
 
+# ========= BENCHMARK =========
+# Repeated runs per implementation with median/percentile/stddev per phase, written as JSON and CSV.
+# Extra benchmark options go in BENCH_ARGS, e.g. BENCH_ARGS="--repeat=10 --threads=1,2,4 --k=0,64" ./run.sh bench p b 8.txt
+# or BENCH_ARGS="--scaling=16" for a strong-scaling sweep (threads 1, 2, 4, 8, 16 with speedup and efficiency)
+if [[ $BENCH -eq 1 ]]; then
+    g++ -std=c++11 -O3 src/benchmark.cpp -o "$EXECUTABLE_DIR/benchmark"
+    "$EXECUTABLE_DIR/benchmark" --bin-dir="$EXECUTABLE_DIR" --variants="$BENCH_VARIANTS" --datasets="$DATASET" \
+        --json=bench.json --csv=bench.csv $BENCH_ARGS
+    BENCH_STATUS=$?
+    echo "✅ Benchmark results saved in $(pwd)/bench.json and $(pwd)/bench.csv"
+    rm -rf "$EXECUTABLE_DIR"
+    exit $BENCH_STATUS
+fi
+
 # ========= PARSING RESULTS & DISPLAYING SUMMARY =========
 echo -e "======== Summary of Results ========"
 
@@ -135,13 +176,14 @@ ITERATIONS=""
 TIME_PHASE_2=""
 THROUGHPUT=""
 LATENCY=""
+LOAD_TIME=""
 
 while IFS= read -r line; do
     # Detect when a new implementation is being processed
     if [[ "$line" =~ ^=====.*Running.*on.*$ ]]; then
         # Print previous implementation details if available
         if [[ -n "$IMPLEMENTATION" && -n "$AVERAGE_TIME" && -n "$CLUSTER_VALUES" && -n "$ITERATIONS" && -n "$TIME_PHASE_2" && -n "$THROUGHPUT" && -n "$LATENCY" ]]; then
-            echo -e "$IMPLEMENTATION:\n  - Time Phase 2: $TIME_PHASE_2\n  - Iterations: $ITERATIONS\n  - Average Time per Iteration: $AVERAGE_TIME\n  - Throughput (Phase 2): $THROUGHPUT\n  - Latency (Phase 2): $LATENCY\n  - Final Cluster Values: $CLUSTER_VALUES\n"
+            echo -e "$IMPLEMENTATION:\n${LOAD_TIME:+  - Load Time: $LOAD_TIME\n}  - Time Phase 2: $TIME_PHASE_2\n  - Iterations: $ITERATIONS\n  - Average Time per Iteration: $AVERAGE_TIME\n  - Throughput (Phase 2): $THROUGHPUT\n  - Latency (Phase 2): $LATENCY\n  - Final Cluster Values: $CLUSTER_VALUES\n"
         fi
         
         # Reset variables for the new implementation
@@ -152,6 +194,11 @@ while IFS= read -r line; do
         TIME_PHASE_2=""
         THROUGHPUT=""
         LATENCY=""
+        LOAD_TIME=""
+
+    # Extract Load Time (serial.cpp does not report one)
+    elif [[ "$line" =~ TIME\ LOAD\ = ]]; then
+        LOAD_TIME=$(echo "$line" | awk -F' = ' '{print $2}')
     
     # Extract Time Phase 2
     elif [[ "$line" =~ TIME\ PHASE\ 2\ = ]]; then
@@ -181,11 +228,32 @@ done < "$OUTPUT_FILE"
 
 # Print last implementation results if available
 if [[ -n "$IMPLEMENTATION" && -n "$AVERAGE_TIME" && -n "$CLUSTER_VALUES" && -n "$ITERATIONS" && -n "$TIME_PHASE_2" && -n "$THROUGHPUT" && -n "$LATENCY" ]]; then
-    echo -e "$IMPLEMENTATION:\n  - Time Phase 2: $TIME_PHASE_2\n  - Iterations: $ITERATIONS\n  - Average Time per Iteration: $AVERAGE_TIME\n  - Throughput (Phase 2): $THROUGHPUT\n  - Latency (Phase 2): $LATENCY\n  - Final Cluster Values: $CLUSTER_VALUES\n"
+    echo -e "$IMPLEMENTATION:\n${LOAD_TIME:+  - Load Time: $LOAD_TIME\n}  - Time Phase 2: $TIME_PHASE_2\n  - Iterations: $ITERATIONS\n  - Average Time per Iteration: $AVERAGE_TIME\n  - Throughput (Phase 2): $THROUGHPUT\n  - Latency (Phase 2): $LATENCY\n  - Final Cluster Values: $CLUSTER_VALUES\n"
 fi
 
 echo "✅ Full results saved in $(pwd)/$OUTPUT_FILE"
 
+# ========= REGRESSION CHECK AGAINST serial.cpp =========
+# The iteration count and every centroid must match serial.cpp's output exactly
+if [[ $CHECK -eq 1 ]]; then
+    echo -e "\n======== Check against serial.cpp ========"
+    CHECK_FAILED=0
+    grep -E "^(Break in iteration|Cluster values:)" "$EXECUTABLE_DIR/serial.out" > "$EXECUTABLE_DIR/serial.check"
+    for IMPL in "${SELECTED_IMPLEMENTATIONS[@]}"; do
+        [[ "$IMPL" == "s" ]] && continue
+        read -r SOURCE_FILE EXECUTABLE <<< "${IMPLEMENTATIONS[$IMPL]}"
+        grep -E "^(Break in iteration|Cluster values:)" "$EXECUTABLE_DIR/$EXECUTABLE.out" > "$EXECUTABLE_DIR/$EXECUTABLE.check"
+        if cmp -s "$EXECUTABLE_DIR/serial.check" "$EXECUTABLE_DIR/$EXECUTABLE.check"; then
+            echo "✅ $EXECUTABLE matches serial"
+        else
+            echo "❌ $EXECUTABLE differs from serial:"
+            diff "$EXECUTABLE_DIR/serial.check" "$EXECUTABLE_DIR/$EXECUTABLE.check" | head -n 6
+            CHECK_FAILED=1
+        fi
+    done
+    exit $CHECK_FAILED
+fi
+
 # # ========= GENERATE CLUSTER CSV FILES =========
 # GEN_CLUSTER_SCRIPT="generate_csv.py"
 # CSV_OUTPUT_DIR="cluster_results"
@@ -0,0 +1,179 @@
+// Per-worker centroid accumulators for Step 2b
+//
+// SUMMARY
+// Step 2b used to build a fresh `tbb::enumerable_thread_specific<vector<double>>` every iteration: each worker paid a
+// heap allocation and a zero-fill the first time it touched its copy, the copies landed wherever the allocator put them
+// (two workers' sums could share a cache line), and the merge walked every copy once per cluster. ClusterAccumulators
+// allocates one flat K x total_values sums block and one K counts block per worker slot once per run, each starting on
+// its own cache line, so the accumulation loop never writes a line another worker is writing. zero() clears the slots
+// in parallel and reduce() folds them pairwise (slot s += slot s + stride, stride doubling) into slot 0, so the merge
+// takes log2(slots) parallel rounds instead of one serial pass per slot. reduceToMeans() also divides the sums into
+// the centroids during the last round, so the merged sums are only read once. Each slot also has one error double (the
+// squared distances of its points to their centroids, for --tol-inertia and --history), on a line of its own and
+// merged by the same tree as the counts.
+// Which points a worker slot sums depends on scheduling, so the last digits of the result can change between runs and
+// thread counts. Giving each fixed-size chunk of points its own slot instead makes the whole sum order a function of
+// total_points alone (see sumChunks() in parallel.cpp).
+// Samir's code
+
+#ifndef KMEANS_ACCUMULATORS_H
+#define KMEANS_ACCUMULATORS_H
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+#include "kahan-sum.h"
+#include "point-matrix.h"
+#include "trace.h"
+
+#define ACCUMULATOR_LINE_BYTES 64
+#define ACCUMULATOR_REDUCE_GRAIN 4096 // Sums per task when one pair is merged by several workers
+#define ACCUMULATOR_ERROR_STRIDE (ACCUMULATOR_LINE_BYTES / sizeof(double)) // Doubles between two slots' errors
+
+// ============================================================================
+// Sum is the type of the per-feature sums: ClusterAccumulators (double) for every variant, or a KahanSum (kahan-sum.h)
+// ============================================================================
+template <typename Sum>
+class BasicClusterAccumulators
+{
+private:
+    int K;
+    int total_values;
+    int slots;                  // One per worker thread of the arena, or one per fixed chunk of points
+    size_t sums_stride;         // Sums between two slots' sums, a multiple of a cache line
+    size_t counts_stride;       // Ints between two slots' counts, a multiple of a cache line
+    AlignedBuffer<Sum> sums;    // slots x sums_stride
+    AlignedBuffer<int> counts;  // slots x counts_stride
+    AlignedBuffer<double> errors; // slots x ACCUMULATOR_ERROR_STRIDE
+
+    static size_t roundToLine(size_t count, size_t bytes)
+    {
+        size_t per_line = ACCUMULATOR_LINE_BYTES / bytes;
+        return (count + per_line - 1) / per_line * per_line;
+    }
+
+    // The rounds of the tree with stride < limit
+    void reduceRounds(int limit)
+    {
+        const size_t values = (size_t)K * total_values;
+        for (int stride = 1; stride < slots && stride < limit; stride *= 2)
+        {
+            int pairs = (slots - stride + 2 * stride - 1) / (2 * stride);
+            tbb::parallel_for(0, pairs, [&](int pair)
+                              {
+                int target = pair * 2 * stride;
+                int source = target + stride;
+                Sum *target_sums = sumsOf(target);
+                const Sum *source_sums = sumsOf(source);
+                // The last rounds have few pairs, so large K x total_values blocks are split again
+                tbb::parallel_for(tbb::blocked_range<size_t>(0, values, ACCUMULATOR_REDUCE_GRAIN),
+                                  [&](const tbb::blocked_range<size_t> &range)
+                                  {
+                    TRACE_TASK("Step 2b.3 task");
+                    for (size_t v = range.begin(); v < range.end(); v++)
+                        target_sums[v] += source_sums[v]; });
+
+                int *target_counts = countsOf(target);
+                const int *source_counts = countsOf(source);
+                for (int i = 0; i < K; i++)
+                    target_counts[i] += source_counts[i];
+                *errorOf(target) += *errorOf(source); });
+        }
+    }
+
+public:
+    BasicClusterAccumulators() : K(0), total_values(0), slots(0), sums_stride(0), counts_stride(0) {}
+
+    // Once per run. slots defaults to the arena's concurrency; pass 1 for a serial Step 2b, or the number of chunks
+    // when every chunk of points sums into its own slot (the deterministic reductions of parallel.cpp).
+    void init(int K, int total_values, int slots = 0)
+    {
+        this->K = K;
+        this->total_values = total_values;
+        this->slots = slots > 0 ? slots : tbb::this_task_arena::max_concurrency();
+        sums_stride = roundToLine((size_t)K * total_values, sizeof(Sum));
+        counts_stride = roundToLine(K, sizeof(int));
+        this->sums.resize(this->slots * sums_stride);
+        this->counts.resize(this->slots * counts_stride);
+        this->errors.resize(this->slots * ACCUMULATOR_ERROR_STRIDE);
+    }
+
+    inline int getSlots() const { return slots; }
+
+    // Slot of the calling worker; the main thread outside a parallel region is slot 0 of its arena
+    inline int localSlot() const
+    {
+        int slot = tbb::this_task_arena::current_thread_index();
+        assert(slot >= 0 && slot < slots);
+        return slot;
+    }
+
+    inline Sum *sumsOf(int slot) { return sums.data() + slot * sums_stride; }
+    inline int *countsOf(int slot) { return counts.data() + slot * counts_stride; }
+    inline Sum *localSums() { return sumsOf(localSlot()); }
+    inline int *localCounts() { return countsOf(localSlot()); }
+    inline double *errorOf(int slot) { return errors.data() + slot * ACCUMULATOR_ERROR_STRIDE; }
+    inline double *localError() { return errorOf(localSlot()); }
+
+    inline void zeroSlot(int slot)
+    {
+        memset(sumsOf(slot), 0, (size_t)K * total_values * sizeof(Sum));
+        memset(countsOf(slot), 0, (size_t)K * sizeof(int));
+        *errorOf(slot) = 0;
+    }
+
+    // Clears every slot, one task per slot so each worker mostly zeroes lines it is about to write
+    void zero()
+    {
+        tbb::parallel_for(0, slots, [&](int slot)
+                          { zeroSlot(slot); });
+    }
+
+    // Pairwise tree over the slots; afterwards totalSums()/totalCounts() (slot 0) hold the sums over all slots.
+    // The pairing only depends on the slot count, never on scheduling.
+    void reduce() { reduceRounds(slots); }
+
+    // reduce() with Step 2b.4 folded into the last round: each cluster's final pair is added, stored in slot 0 and
+    // divided straight into its row of centroids (K x total_values). Clusters without points keep their centroid.
+    template <typename Centroid>
+    void reduceToMeans(Centroid *centroids)
+    {
+        int last = 1; // Stride of the last round
+        while (last * 2 < slots)
+            last *= 2;
+        reduceRounds(last);
+
+        const bool has_source = slots > last;
+        if (has_source)
+            *errorOf(0) += *errorOf(last);
+        tbb::parallel_for(0, K, [&](int i)
+                          {
+            Sum *cluster_sums = sumsOf(0) + (size_t)i * total_values;
+            int *cluster_size = countsOf(0) + i;
+            const Sum *source_sums = has_source ? sumsOf(last) + (size_t)i * total_values : nullptr;
+            if (has_source)
+                *cluster_size += countsOf(last)[i];
+            if (*cluster_size == 0)
+                return;
+
+            double inv_cluster_size = 1.0 / *cluster_size; // Precompute division
+            Centroid *central_values = centroids + (size_t)i * total_values;
+            for (int j = 0; j < total_values; j++)
+            {
+                if (has_source)
+                    cluster_sums[j] += source_sums[j];
+                central_values[j] = (Centroid)(sumValue(cluster_sums[j]) * inv_cluster_size);
+            } });
+    }
+
+    inline const Sum *totalSums() const { return sums.data(); }
+    inline const int *totalCounts() const { return counts.data(); }
+    inline double totalError() const { return errors[0]; }
+};
+
+typedef BasicClusterAccumulators<double> ClusterAccumulators;
+
+#endif
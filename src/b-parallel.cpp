@@ -3,7 +3,7 @@
 
 // SUMMARY
 // This version of the K-Means clustering algorithm further enhances **parallelization using Intel TBB by optimizing the centroid recalculation step (Step 2b)
-// It introduces thread-local storage (TLS) with tbb::enumerable_thread_specific to aggregate cluster sums safely and efficiently across threads. These improvements reduce synchronization overhead, increase parallel efficiency, and significantly accelerate centroid updates for large datasets.
+// It gives every worker its own cache-line padded accumulator block (accumulators.h), allocated once per run and merged with a tree reduction, to aggregate cluster sums safely and efficiently across threads. These improvements reduce synchronization overhead, increase parallel efficiency, and significantly accelerate centroid updates for large datasets.
 // Samir's code
 
 #include <iostream>
@@ -18,63 +18,17 @@
 #include <tbb/parallel_for.h>
 #include <atomic>
 #include <tbb/blocked_range.h>
-#include <tbb/enumerable_thread_specific.h>
-#include <immintrin.h> // AVX, AVX2
+#include <tbb/global_control.h>
+#include <memory>
+// shared point storage and SIMD kernels
+#include "point-matrix.h"
+#include "parallel-text-loader.h"
+#include "dimension-kernels.h"
+#include "accumulators.h"
+#include "bench-report.h"
 
 using namespace std;
 
-// ============================================================================
-//                              Point Class
-// ============================================================================
-// This class represents a **single data point** in the dataset.
-
-class Point
-{
-private:
-    int id_point;          // Unique identifier for the point
-    int id_cluster;        // ID of the cluster this point is assigned to
-    vector<double> values; // Stores the feature values of the point
-    int total_values;      // Number of features (dimensions) for this point
-    string name;           // Optional name of the point (default: empty)
-
-public:
-    Point(int id_point, vector<double> &values, string name = "")
-    {
-        this->id_point = id_point;    // Assigns the point ID
-        total_values = values.size(); // Stores the total number of features
-        // this->values.reserve(total_values); // DOESN'T WORK - dynamic resizing
-
-        // SAMIR - Loop unrolling
-        int i = 0;
-        for (; i + 3 < total_values; i += 4) // Copy 4 values per loop
-        {
-            this->values.push_back(values[i]);
-            this->values.push_back(values[i + 1]);
-            this->values.push_back(values[i + 2]);
-            this->values.push_back(values[i + 3]);
-        }
-
-        // Handle remaining values
-        for (; i < total_values; i++)
-            this->values.push_back(values[i]);
-
-        this->name = name; // Assigns the name (if provided)
-        id_cluster = -1;   // Initially, the point is not assigned to any cluster (-1)
-    }
-
-    // ============================================================================
-    // Getter Methods: Retrieve information about the point.
-    // ============================================================================
-
-    // SAMIR - Inline small functions
-    inline int getID() const { return id_point; }
-    inline int getCluster() const { return id_cluster; }
-    inline void setCluster(int id_cluster) { this->id_cluster = id_cluster; }
-    inline double getValue(int index) const { return values[index]; }
-    inline int getTotalValues() const { return total_values; }
-    inline string getName() const { return name; }
-};
-
 // ============================================================================
 //                              Cluster Class
 // ============================================================================
@@ -84,30 +38,28 @@ class Cluster
 {
 private:
     int id_cluster;
-    vector<double> central_values; // Centroid coordinates
+    double *central_values; // SAMIR - Row of the KMeans centroid matrix, so the kernels see all K centroids contiguously
 
 public:
-    Cluster(int id_cluster, Point point)
+    Cluster(int id_cluster, double *central_values, const double *point_values, int total_values)
     {
         this->id_cluster = id_cluster;
-
-        int total_values = point.getTotalValues();
-        central_values.reserve(total_values); // SAMIR - reserve space for feature values
+        this->central_values = central_values;
 
         int i = 0;
         // SAMIR - Unroll by copying 4 feature values at a time
         for (; i + 3 < total_values; i += 4)
         {
-            central_values.push_back(point.getValue(i));
-            central_values.push_back(point.getValue(i + 1));
-            central_values.push_back(point.getValue(i + 2));
-            central_values.push_back(point.getValue(i + 3));
+            central_values[i] = point_values[i];
+            central_values[i + 1] = point_values[i + 1];
+            central_values[i + 2] = point_values[i + 2];
+            central_values[i + 3] = point_values[i + 3];
         }
 
         // Copy remaining feature values
         for (; i < total_values; i++)
         {
-            central_values.push_back(point.getValue(i));
+            central_values[i] = point_values[i];
         }
     }
 
@@ -129,48 +81,11 @@ private:
     int total_points;         // Total number of points
     int max_iterations;       // Maximum iterations allowed
     vector<Cluster> clusters; // Stores only cluster centroids
-
-    // ======================================================================
-    // Finds the **nearest cluster** to a given point using **Euclidean distance**.
-    // ======================================================================
-    int getIDNearestCenter(Point &point)
-    {
-        double min_dist_sq = numeric_limits<double>::max(); // Store squared distance
-        int id_cluster_center = 0;
-
-        for (int i = 0; i < K; i++)
-        {
-            double sum = 0.0;
-            int j = 0;
-
-            // SAMIR - Process 4 values at a time (Loop Unrolling by 4)
-            for (; j + 3 < total_values; j += 4)
-            {
-                double diff0 = clusters[i].getCentralValue(j) - point.getValue(j);
-                double diff1 = clusters[i].getCentralValue(j + 1) - point.getValue(j + 1);
-                double diff2 = clusters[i].getCentralValue(j + 2) - point.getValue(j + 2);
-                double diff3 = clusters[i].getCentralValue(j + 3) - point.getValue(j + 3);
-
-                // SAMIR - Replace pow(x, 2.0) with Direct Multiplication
-                sum += (diff1 * diff1) + (diff2 * diff2) + (diff3 * diff3) + (diff0 * diff0);
-            }
-
-            // Process remaining elements (if any)
-            for (; j < total_values; j++)
-            {
-                double diff = clusters[i].getCentralValue(j) - point.getValue(j);
-                sum += diff * diff;
-            }
-
-            // SAMIR - No sqrt() needed - compare squared distances
-            if (sum < min_dist_sq)
-            {
-                min_dist_sq = sum;
-                id_cluster_center = i;
-            }
-        }
-        return id_cluster_center;
-    }
+    AlignedBuffer<double> centroids;     // K x total_values centroid values, viewed by the clusters
+    SimdLevel simd_level;                // Instruction set picked at startup
+    NearestCenterKernel nearest_centers; // Step 2a kernel for that instruction set and dimension count
+    ClusterAccumulators accumulators;    // Step 2b per-worker sums and counts, allocated once per run
+    BenchReport bench;                   // Phase timings for benchmark.cpp (bench-report.h)
 
 public:
     KMeans(int K, int total_points, int total_values, int max_iterations)
@@ -179,9 +94,17 @@ public:
         this->total_points = total_points;
         this->total_values = total_values;
         this->max_iterations = max_iterations;
+
+        // SAMIR - pick the widest SIMD kernel this CPU supports once, instead of compiling with -march=native
+        simd_level = detectSimdLevel();
+        nearest_centers = selectNearestCenterKernel(simd_level, total_values); // SAMIR - unrolled for this dataset's dimension count
+        centroids.resize((size_t)K * total_values);
+        accumulators.init(K, total_values);
     }
 
-    void run(vector<Point> &points)
+    inline const BenchReport &getBenchReport() const { return bench; }
+
+    void run(PointMatrix &points)
     {
         auto begin = chrono::high_resolution_clock::now();
 
@@ -199,8 +122,9 @@ public:
 
             if (chosen_indexes.insert(index_point).second) // SAMIR - O(1) lookup and insert
             {
-                points[index_point].setCluster(chosen_indexes.size() - 1);             // Assign cluster
-                clusters.emplace_back(chosen_indexes.size() - 1, points[index_point]); // SAMIR - emplace back
+                int id_cluster = chosen_indexes.size() - 1;
+                points.setCluster(index_point, id_cluster); // Assign cluster
+                clusters.emplace_back(id_cluster, centroids.data() + (size_t)id_cluster * total_values, points.row(index_point), total_values); // SAMIR - emplace back
             }
         }
 
@@ -215,80 +139,52 @@ public:
             bool done = true;
 
             // Step 2a: **Assign each point to the nearest cluster**
-            for (int i = 0; i < total_points; i++)
-            {
-                int id_old_cluster = points[i].getCluster();
-                int id_nearest_center = getIDNearestCenter(points[i]);
+            // SAMIR - the SIMD kernel compares blocks of points against one centroid at a time
+            if (nearest_centers(points, 0, total_points, centroids.data(), K, points.getAssignments()) != 0)
+                done = false;
 
-                if (id_old_cluster != id_nearest_center)
-                {
-                    points[i].setCluster(id_nearest_center);
-                    done = false;
-                }
-            }
+            auto assign_end = chrono::high_resolution_clock::now();
 
             // Step 2b: **Recalculate centroids based on new assignments**, SAMIR, parallelization
 
-            // Global accumulators for new centroids and cluster sizes
-            vector<vector<double>> new_centroids(K, vector<double>(total_values, 0.0));
-            vector<int> cluster_sizes(K, 0);
-
-            // Step 2b.1: Thread-local storage for safe accumulation without race conditions
-            // DID NOT Preallocate memory for all threads before computation to remove unnecessary dynamic allocation as there's not any consistent speedup from this
-            tbb::enumerable_thread_specific<vector<vector<double>>> local_sums;
-            tbb::enumerable_thread_specific<vector<int>> local_counts;
+            // Step 2b.1: Per-worker accumulators for safe accumulation without race conditions
+            // SAMIR - allocated once per run, one cache-line padded K x total_values block per worker, cleared in parallel
+            accumulators.zero();
 
-            // Step 2b.2: Parallel Accumulation of Centroids using Thread-Local Storage
-            tbb::parallel_for(tbb::blocked_range<size_t>(0, points.size()), [&](const tbb::blocked_range<size_t> &r)
+            // Step 2b.2: Parallel Accumulation of Centroids into the calling worker's slot
+            tbb::parallel_for(tbb::blocked_range<size_t>(0, points.getTotalPoints()), [&](const tbb::blocked_range<size_t> &r)
                               {
-			// Each thread gets a local copy of centroid accumulators and cluster sizes
-			auto &local_centroids = local_sums.local();
-			auto &local_cluster_sizes = local_counts.local();
-
-			// Allocate memory for local storage only when needed
-			if (local_centroids.empty()) {
-				local_centroids.resize(K, vector<double>(total_values, 0.0));
-				local_cluster_sizes.resize(K, 0);
-			}
+			double *local_centroids = accumulators.localSums();
+			int *local_cluster_sizes = accumulators.localCounts();
 
 			// Iterate over a subset of points assigned to this thread
 			for (size_t i = r.begin(); i < r.end(); ++i)
 			{
-				int cluster_id = points[i].getCluster(); // Get assigned cluster
-				local_cluster_sizes[cluster_id]++;       // Count points in each cluster
+				int cluster_id = points.getCluster(i); // Get assigned cluster
+				local_cluster_sizes[cluster_id]++;     // Count points in each cluster
+				const double *point_values = points.row(i); // SAMIR - one contiguous row per point
+				double *cluster_sums = local_centroids + (size_t)cluster_id * total_values;
 
 				int j = 0;
 				// Use **loop unrolling** for better cache utilization
 				for (; j + 3 < total_values; j += 4)
 				{
-					local_centroids[cluster_id][j] += points[i].getValue(j);
-					local_centroids[cluster_id][j + 1] += points[i].getValue(j + 1);
-					local_centroids[cluster_id][j + 2] += points[i].getValue(j + 2);
-					local_centroids[cluster_id][j + 3] += points[i].getValue(j + 3);
+					cluster_sums[j] += point_values[j];
+					cluster_sums[j + 1] += point_values[j + 1];
+					cluster_sums[j + 2] += point_values[j + 2];
+					cluster_sums[j + 3] += point_values[j + 3];
 				}
 
 				// Handle remaining feature values
 				for (; j < total_values; j++)
 				{
-					local_centroids[cluster_id][j] += points[i].getValue(j);
+					cluster_sums[j] += point_values[j];
 				}
 			} });
 
-            // Step 2b.3: Merge Thread-Local Results into Global Accumulators
-            tbb::parallel_for(0, K, [&](int i)
-                              {
-			for (const auto &local_centroids : local_sums)
-			{
-				for (int j = 0; j < total_values; j++)
-				{
-					new_centroids[i][j] += local_centroids[i][j];
-				}
-			}
-
-			for (const auto &local_cluster_sizes : local_counts)
-			{
-				cluster_sizes[i] += local_cluster_sizes[i];
-			} });
+            // Step 2b.3: Merge the per-worker results with a tree reduction
+            accumulators.reduce();
+            const int *cluster_sizes = accumulators.totalCounts();
 
             // Step 2b.4: Compute the New Centroid Positions (Parallelized)
             tbb::parallel_for(0, K, [&](int i)
@@ -296,26 +192,29 @@ public:
 			if (cluster_sizes[i] > 0)
 			{
 				double inv_cluster_size = 1.0 / cluster_sizes[i]; // Precompute division
+				const double *cluster_sums = accumulators.totalSums() + (size_t)i * total_values;
 
 				int j = 0;
 				// Loop unrolling for performance optimization
 				for (; j + 3 < total_values; j += 4)
 				{
-					clusters[i].setCentralValue(j, new_centroids[i][j] * inv_cluster_size);
-					clusters[i].setCentralValue(j + 1, new_centroids[i][j + 1] * inv_cluster_size);
-					clusters[i].setCentralValue(j + 2, new_centroids[i][j + 2] * inv_cluster_size);
-					clusters[i].setCentralValue(j + 3, new_centroids[i][j + 3] * inv_cluster_size);
+					clusters[i].setCentralValue(j, cluster_sums[j] * inv_cluster_size);
+					clusters[i].setCentralValue(j + 1, cluster_sums[j + 1] * inv_cluster_size);
+					clusters[i].setCentralValue(j + 2, cluster_sums[j + 2] * inv_cluster_size);
+					clusters[i].setCentralValue(j + 3, cluster_sums[j + 3] * inv_cluster_size);
 				}
 
 				// Handle remaining feature values
 				for (; j < total_values; j++)
 				{
-					clusters[i].setCentralValue(j, new_centroids[i][j] * inv_cluster_size);
+					clusters[i].setCentralValue(j, cluster_sums[j] * inv_cluster_size);
 				}
 			} });
 
             auto iteration_end = chrono::high_resolution_clock::now();
             total_iteration_time += chrono::duration_cast<chrono::microseconds>(iteration_end - iteration_start).count();
+            bench.assignment += benchMicros(assign_end - iteration_start);
+            bench.update += benchMicros(iteration_end - assign_end);
 
             // Step 2c: **Check stopping condition**
             if (done || iter >= max_iterations)
@@ -327,6 +226,10 @@ public:
         }
 
         auto end = chrono::high_resolution_clock::now();
+        bench.seeding = benchMicros(end_phase1 - begin);
+        bench.phase2 = benchMicros(end - end_phase1);
+        bench.total = benchMicros(end - begin);
+        bench.iterations = iter;
 
         // Step 3: **Display results**
         for (int i = 0; i < K; i++)
@@ -334,12 +237,12 @@ public:
             cout << "Cluster " << clusters[i].getID() + 1 << endl;
             for (int j = 0; j < total_points; j++)
             {
-                if (points[j].getCluster() == i)
+                if (points.getCluster(j) == i)
                 {
-                    // cout << "Point " << points[j].getID() + 1 << ": ";
+                    // cout << "Point " << j + 1 << ": ";
                     // for (int p = 0; p < total_values; p++)
-                    //     cout << points[j].getValue(p) << " ";
-                    // string point_name = points[j].getName();
+                    //     cout << points.getValue(j, p) << " ";
+                    // string point_name = points.hasNames() ? points.getName(j) : "";
                     // if (point_name != "")
                     //     cout << "- " << point_name;
 
@@ -356,6 +259,7 @@ public:
         cout << "TOTAL EXECUTION TIME = " << chrono::duration_cast<chrono::microseconds>(end - begin).count() << " µs\n";
         cout << "TIME PHASE 1 = " << chrono::duration_cast<chrono::microseconds>(end_phase1 - begin).count() << " µs\n";
         cout << "TIME PHASE 2 = " << chrono::duration_cast<chrono::microseconds>(end - end_phase1).count() << " µs\n";
+        cout << "SIMD KERNEL = " << simdLevelName(simd_level) << (isFixedDimension(total_values) ? " (dimension-specialized)" : " (generic)") << "\n";
 
         // Calculate and display the **average time per iteration**
         if (iter > 1) // Only compute if we have at least 1 iteration
@@ -385,59 +289,42 @@ int main(int argc, char *argv[])
     // srand(time(NULL));
     srand(10);
 
-    int total_points, total_values, K, max_iterations, has_name;
+    // SAMIR - worker count requested by benchmark.cpp (KMEANS_BENCH_THREADS), TBB's default otherwise
+    unique_ptr<tbb::global_control> thread_limit;
+    if (benchThreads() > 0)
+        thread_limit.reset(new tbb::global_control(tbb::global_control::max_allowed_parallelism, benchThreads()));
 
     // ==========================================================================
-    // Step 1: Read Input Values
+    // Step 1: Read Input Values and Points
     // ==========================================================================
-    // Read the total number of data points, the number of features per point,
+    // The header gives the total number of data points, the number of features per point,
     // the number of clusters (K), the maximum number of iterations, and whether
-    // each point has a name.
-    cin >> total_points >> total_values >> K >> max_iterations >> has_name;
-
-    // Declare a vector to store all points in the dataset
-    vector<Point> points;
-    points.reserve(total_points); // SAMIR - Preallocate memory for all points
-    string point_name;            // To store the optional name of the point
-
-    // ==========================================================================
-    // Step 2: Read Points from Input
-    // ==========================================================================
-    for (int i = 0; i < total_points; i++)
+    // each point has a name. SAMIR - every point is read straight into one contiguous matrix
+    auto begin_load = chrono::high_resolution_clock::now();
+    DatasetHeader header;
+    PointMatrix points;
+    if (!loadPointMatrixParallel(STDIN_FILENO, header, points)) // SAMIR - mmap the dataset and parse it in parallel chunks
     {
-        vector<double> values;        // Store feature values of the current point
-        values.reserve(total_values); // SAMIR - preallocate memory for feature values
-
-        // Read the feature values for the current point
-        for (int j = 0; j < total_values; j++)
-        {
-            double value;
-            cin >> value;
-            values.push_back(value);
-        }
-
-        // If the points have names, read and store the name
-        if (has_name)
-        {
-            cin >> point_name;
-            Point p(i, values, point_name); // Create a Point with a name
-            points.emplace_back(i, values); // SAMIR - emplace back
-        }
-        else
-        {
-            Point p(i, values);             // Create a Point without a name
-            points.emplace_back(i, values); // SAMIR - emplace back
-        }
+        cerr << "Error: malformed dataset on standard input" << endl;
+        return 1;
     }
+    points.buildColumns(); // SAMIR - column-major copy for the SIMD kernels
+    auto end_load = chrono::high_resolution_clock::now();
 
     // ==========================================================================
     // Step 3: Initialize K-Means Algorithm and Run Clustering
     // ==========================================================================
     // Create an instance of KMeans with the input parameters
-    KMeans kmeans(K, total_points, total_values, max_iterations);
+    KMeans kmeans(header.K, header.total_points, header.total_values, header.max_iterations);
 
     // Run the K-Means algorithm on the dataset
     kmeans.run(points);
+    cout << "TIME LOAD = " << chrono::duration_cast<chrono::microseconds>(end_load - begin_load).count() << " µs\n";
+
+    // SAMIR - phase timings as JSON for benchmark.cpp, when it asks for them
+    BenchReport report = kmeans.getBenchReport();
+    report.load = benchMicros(end_load - begin_load);
+    writeBenchReport("b-parallel", report);
 
     // ==========================================================================
     // Step 4: Exit Program
@@ -0,0 +1,66 @@
+// Machine-readable timings for the benchmark harness
+//
+// SUMMARY
+// run.sh used to regex the "TIME PHASE 2", "THROUGHPUT" and similar lines out of results.txt after one cold run.
+// benchmark.cpp instead runs each executable many times and needs the phase times of every run as numbers. When the
+// environment variable KMEANS_BENCH_REPORT names a file, an implementation writes one flat JSON object there at exit:
+// load, seeding (Phase 1), assignment (all Step 2a), update (all Step 2b), Phase 2 and total time in microseconds, plus
+// the iteration count. Without the variable nothing changes. KMEANS_BENCH_THREADS is the worker count the harness asks
+// the TBB implementations to use for this run (0 or unset: TBB's default).
+// Samir's code
+
+#ifndef KMEANS_BENCH_REPORT_H
+#define KMEANS_BENCH_REPORT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+struct BenchReport
+{
+    double load;       // Step 1 of main: reading the dataset into the point matrix
+    double seeding;    // Phase 1: picking the initial centroids
+    double assignment; // Step 2a over all iterations (usion-parallel: the fused sweep)
+    double update;     // Step 2b over all iterations (usion-parallel: the merge and divide)
+    double phase2;     // Phase 2, "TIME PHASE 2"
+    double total;      // Phase 1 + Phase 2, "TOTAL EXECUTION TIME"
+    int iterations;
+
+    BenchReport() : load(0), seeding(0), assignment(0), update(0), phase2(0), total(0), iterations(0) {}
+};
+
+// Fractional microseconds, so summing hundreds of short Step 2b phases does not round each of them down to 0
+template <typename Duration>
+inline double benchMicros(Duration duration)
+{
+    return std::chrono::duration_cast<std::chrono::duration<double, std::micro>>(duration).count();
+}
+
+// Writes report to $KMEANS_BENCH_REPORT, if set, as {"variant": ..., "load_us": ..., ...}
+inline void writeBenchReport(const char *variant, const BenchReport &report)
+{
+    const char *path = getenv("KMEANS_BENCH_REPORT");
+    if (!path || !*path)
+        return;
+
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+        perror(path);
+        return;
+    }
+    fprintf(file,
+            "{\"variant\": \"%s\", \"load_us\": %.1f, \"seeding_us\": %.1f, \"assignment_us\": %.1f, "
+            "\"update_us\": %.1f, \"phase2_us\": %.1f, \"total_us\": %.1f, \"iterations\": %d}\n",
+            variant, report.load, report.seeding, report.assignment, report.update, report.phase2, report.total,
+            report.iterations);
+    fclose(file);
+}
+
+inline int benchThreads()
+{
+    const char *threads = getenv("KMEANS_BENCH_THREADS");
+    return threads ? atoi(threads) : 0;
+}
+
+#endif
@@ -0,0 +1,576 @@
+// Benchmark driver for the K-Means implementations
+//
+// SUMMARY
+// Usage: ./benchmark [--variants=parallel,b-parallel] [--datasets=3.txt,8.bin] [--k=0,64] [--threads=0,1,4]
+//                    [--warmup=1] [--repeat=5] [--bin-dir=executables] [--dataset-dir=datasets]
+//                    [--scaling=16] [--json=bench.json] [--csv=bench.csv]
+// Runs every (variant, dataset, K, threads) combination warmup + repeat times and reports the mean, standard deviation,
+// minimum, median, 90th percentile and maximum of each phase over the measured runs. Every run is a fresh process
+// (the executables are built by run.sh, see "./run.sh bench"), with the dataset on stdin so it can be mapped, and its
+// phase times come from the JSON line it writes to KMEANS_BENCH_REPORT (bench-report.h) instead of its stdout. The
+// driver also times each process from fork to exit ("wall", which includes process startup and the output).
+// serial.cpp does not write a report, so only its wall time is measured.
+// K = 0 keeps the dataset's own K; any other K runs on a temporary copy of the dataset with only K changed in the
+// header. threads = 0 leaves the worker count to TBB; the serial implementations ignore it.
+// Whenever a variant also ran with 1 thread, every other thread count of it gets a speedup (1-thread median / median)
+// and an efficiency (speedup / threads) per phase. --scaling=N is the strong-scaling sweep: threads 1, 2, 4, ... up to
+// N (N included), followed by the speedup and efficiency curve of each variant's total time.
+// Samir's code
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "binary-dataset.h"
+
+using namespace std;
+
+// Phases of one run, in the order they are reported; wall is measured here, the others come from bench-report.h
+static const char *METRICS[] = {"wall_us", "load_us", "seeding_us", "assignment_us", "update_us", "phase2_us", "total_us"};
+static const int METRIC_COUNT = sizeof(METRICS) / sizeof(METRICS[0]);
+
+struct BenchmarkOptions
+{
+    vector<string> variants;
+    vector<string> datasets;
+    vector<int> ks;
+    vector<int> threads;
+    int warmup;
+    int repeat;
+    int scaling; // Largest thread count of the strong-scaling sweep, 0 = no sweep
+    string bin_dir;
+    string dataset_dir;
+    string json_path;
+    string csv_path;
+
+    BenchmarkOptions() : variants(1, "parallel"), datasets(1, "1.txt"), ks(1, 0), threads(1, 0), warmup(1), repeat(5),
+                         scaling(0), bin_dir("executables"), dataset_dir("datasets") {}
+};
+
+struct RunResult
+{
+    bool ok;
+    bool has_report;
+    double metrics[METRIC_COUNT];
+    int iterations;
+};
+
+struct Summary
+{
+    double mean, stddev, min, median, p90, max;
+    double speedup, efficiency; // Against the 1-thread median of the same variant, NaN without one
+};
+
+// ============================================================================
+//                              Options
+// ============================================================================
+static vector<string> splitList(const string &value)
+{
+    vector<string> items;
+    stringstream stream(value);
+    string item;
+    while (getline(stream, item, ','))
+        if (!item.empty())
+            items.push_back(item);
+    return items;
+}
+
+static bool parseInts(const string &name, const string &value, vector<int> &ints, int minimum)
+{
+    ints.clear();
+    for (const string &item : splitList(value))
+    {
+        char *end = nullptr;
+        long parsed = strtol(item.c_str(), &end, 10);
+        if (*end != '\0' || parsed < minimum)
+        {
+            cerr << "Error: " << name << " expects integers >= " << minimum << ", got '" << item << "'\n";
+            return false;
+        }
+        ints.push_back((int)parsed);
+    }
+    if (ints.empty())
+    {
+        cerr << "Error: " << name << " is empty\n";
+        return false;
+    }
+    return true;
+}
+
+static void printUsage(const char *program)
+{
+    cerr << "Usage: " << program << " [options]\n"
+         << "  --variants=a,b,...     executables to run from --bin-dir (default parallel)\n"
+         << "  --datasets=a,b,...     datasets, relative to --dataset-dir unless they contain a '/' (default 1.txt)\n"
+         << "  --k=a,b,...            cluster counts, 0 = the dataset's own K (default 0)\n"
+         << "  --threads=a,b,...      TBB worker counts, 0 = TBB's default (default 0)\n"
+         << "  --scaling=N            strong-scaling sweep over threads 1, 2, 4, ..., N (replaces --threads)\n"
+         << "  --warmup=N             unmeasured runs per combination (default 1)\n"
+         << "  --repeat=N             measured runs per combination (default 5)\n"
+         << "  --bin-dir=DIR          where the executables are (default executables)\n"
+         << "  --dataset-dir=DIR      where the datasets are (default datasets)\n"
+         << "  --json=FILE            write every run and the summaries as JSON\n"
+         << "  --csv=FILE             write the summaries as CSV, one row per combination and phase\n";
+}
+
+static bool parseBenchmarkOptions(int argc, char *argv[], BenchmarkOptions &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        size_t equals = arg.find('=');
+        string name = arg.substr(0, equals);
+        string value = equals == string::npos ? "" : arg.substr(equals + 1);
+        vector<int> ints;
+
+        if (name == "--help" || name == "-h")
+        {
+            printUsage(argv[0]);
+            return false;
+        }
+        if (equals == string::npos)
+        {
+            cerr << "Error: option " << name << " needs a value (" << name << "=...)\n";
+            return false;
+        }
+
+        if (name == "--variants")
+            options.variants = splitList(value);
+        else if (name == "--datasets")
+            options.datasets = splitList(value);
+        else if (name == "--k")
+        {
+            if (!parseInts(name, value, options.ks, 0))
+                return false;
+        }
+        else if (name == "--threads")
+        {
+            if (!parseInts(name, value, options.threads, 0))
+                return false;
+        }
+        else if (name == "--scaling")
+        {
+            if (!parseInts(name, value, ints, 1) || ints.size() != 1)
+                return false;
+            options.scaling = ints[0];
+        }
+        else if (name == "--warmup" || name == "--repeat")
+        {
+            if (!parseInts(name, value, ints, name == "--warmup" ? 0 : 1) || ints.size() != 1)
+                return false;
+            (name == "--warmup" ? options.warmup : options.repeat) = ints[0];
+        }
+        else if (name == "--bin-dir")
+            options.bin_dir = value;
+        else if (name == "--dataset-dir")
+            options.dataset_dir = value;
+        else if (name == "--json")
+            options.json_path = value;
+        else if (name == "--csv")
+            options.csv_path = value;
+        else
+        {
+            cerr << "Error: unknown option " << name << "\n";
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+
+    if (options.variants.empty() || options.datasets.empty())
+    {
+        cerr << "Error: no variants or no datasets to run\n";
+        return false;
+    }
+
+    // Doubling thread counts, and the maximum itself when it is not a power of two
+    if (options.scaling > 0)
+    {
+        options.threads.clear();
+        for (int threads = 1; threads < options.scaling; threads *= 2)
+            options.threads.push_back(threads);
+        options.threads.push_back(options.scaling);
+    }
+    return true;
+}
+
+// ============================================================================
+//                              Datasets
+// ============================================================================
+static string datasetPath(const BenchmarkOptions &options, const string &dataset)
+{
+    return dataset.find('/') != string::npos ? dataset : options.dataset_dir + "/" + dataset;
+}
+
+// Copies the dataset at path into a temporary file with K replaced in its header. Returns the temporary path, or ""
+// (after saying why) if the dataset could not be read or rewritten.
+static string datasetWithK(const string &path, int K)
+{
+    ifstream input(path.c_str(), ios::binary);
+    string contents((istreambuf_iterator<char>(input)), istreambuf_iterator<char>());
+    if (!input.good() && !input.eof())
+    {
+        cerr << "Error: could not read " << path << "\n";
+        return "";
+    }
+
+    if (isBinaryDataset(contents.data(), contents.data() + contents.size()))
+    {
+        if (contents.size() < sizeof(BinaryDatasetHeader))
+        {
+            cerr << "Error: " << path << " is shorter than its header\n";
+            return "";
+        }
+        int32_t header_k = K;
+        memcpy(&contents[offsetof(BinaryDatasetHeader, K)], &header_k, sizeof(header_k));
+    }
+    else
+    {
+        // Text header: total_points total_values K max_iterations has_name, rewritten on a line of its own
+        size_t line_end = contents.find('\n');
+        istringstream header(contents.substr(0, line_end));
+        long fields[5];
+        for (int f = 0; f < 5; f++)
+            if (!(header >> fields[f]))
+            {
+                cerr << "Error: " << path << " does not start with the five header fields on one line\n";
+                return "";
+            }
+        ostringstream replaced;
+        replaced << fields[0] << " " << fields[1] << " " << K << " " << fields[3] << " " << fields[4];
+        contents.replace(0, line_end == string::npos ? contents.size() : line_end, replaced.str());
+    }
+
+    char temporary[] = "/tmp/kmeans-bench-XXXXXX";
+    int fd = mkstemp(temporary);
+    if (fd < 0)
+    {
+        cerr << "Error: could not create a temporary dataset: " << strerror(errno) << "\n";
+        return "";
+    }
+    bool ok = write(fd, contents.data(), contents.size()) == (ssize_t)contents.size();
+    ok = close(fd) == 0 && ok;
+    if (!ok)
+    {
+        cerr << "Error: could not write " << temporary << "\n";
+        unlink(temporary);
+        return "";
+    }
+    return temporary;
+}
+
+// ============================================================================
+//                              Runs
+// ============================================================================
+// Reads "key": number out of the report's single JSON object
+static bool reportValue(const string &report, const string &key, double &value)
+{
+    size_t at = report.find("\"" + key + "\":");
+    if (at == string::npos)
+        return false;
+    value = strtod(report.c_str() + at + key.size() + 3, nullptr);
+    return true;
+}
+
+// One process: the dataset on stdin, stdout and stderr discarded, the report read back from report_path
+static RunResult runOnce(const string &executable, const string &dataset, int threads, const string &report_path)
+{
+    RunResult result;
+    result.ok = false;
+    result.has_report = false;
+    result.iterations = 0;
+    for (int m = 0; m < METRIC_COUNT; m++)
+        result.metrics[m] = NAN;
+    unlink(report_path.c_str());
+
+    auto start = chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        cerr << "Error: fork failed: " << strerror(errno) << "\n";
+        return result;
+    }
+    if (pid == 0)
+    {
+        int input = open(dataset.c_str(), O_RDONLY);
+        int null = open("/dev/null", O_WRONLY);
+        if (input < 0 || null < 0)
+            _exit(126);
+        dup2(input, STDIN_FILENO);
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+        setenv("KMEANS_BENCH_REPORT", report_path.c_str(), 1);
+        setenv("KMEANS_BENCH_THREADS", to_string(threads).c_str(), 1);
+        execl(executable.c_str(), executable.c_str(), (char *)nullptr);
+        _exit(127);
+    }
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    auto end = chrono::steady_clock::now();
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        cerr << "Error: " << executable << " < " << dataset << " failed (status " << status << ")\n";
+        return result;
+    }
+    result.ok = true;
+    result.metrics[0] = (double)chrono::duration_cast<chrono::microseconds>(end - start).count();
+
+    ifstream input(report_path.c_str());
+    string report((istreambuf_iterator<char>(input)), istreambuf_iterator<char>());
+    if (report.empty())
+        return result;
+    result.has_report = true;
+    for (int m = 1; m < METRIC_COUNT; m++)
+        reportValue(report, METRICS[m], result.metrics[m]);
+    double iterations = 0;
+    if (reportValue(report, "iterations", iterations))
+        result.iterations = (int)iterations;
+    return result;
+}
+
+// Percentiles interpolate linearly between the sorted samples
+static Summary summarize(vector<double> samples)
+{
+    Summary summary = {NAN, NAN, NAN, NAN, NAN, NAN, NAN, NAN};
+    if (samples.empty())
+        return summary;
+
+    sort(samples.begin(), samples.end());
+    const size_t n = samples.size();
+    double sum = 0.0;
+    for (double sample : samples)
+        sum += sample;
+    summary.mean = sum / n;
+
+    double squares = 0.0;
+    for (double sample : samples)
+        squares += (sample - summary.mean) * (sample - summary.mean);
+    summary.stddev = n > 1 ? sqrt(squares / (n - 1)) : 0.0;
+
+    auto percentile = [&](double p)
+    {
+        double rank = p * (n - 1);
+        size_t below = (size_t)rank;
+        size_t above = min(below + 1, n - 1);
+        return samples[below] + (rank - below) * (samples[above] - samples[below]);
+    };
+    summary.min = samples.front();
+    summary.median = percentile(0.5);
+    summary.p90 = percentile(0.9);
+    summary.max = samples.back();
+    return summary;
+}
+
+// JSON has no NaN, so phases an implementation did not report are null
+static string jsonNumber(double value)
+{
+    if (isnan(value))
+        return "null";
+    ostringstream out;
+    out.precision(15);
+    out << value;
+    return out.str();
+}
+
+static string csvNumber(double value)
+{
+    return isnan(value) ? "" : jsonNumber(value);
+}
+
+// ============================================================================
+//                              Main
+// ============================================================================
+int main(int argc, char *argv[])
+{
+    BenchmarkOptions options;
+    if (!parseBenchmarkOptions(argc, argv, options))
+        return 1;
+
+    char report_template[] = "/tmp/kmeans-report-XXXXXX";
+    int report_fd = mkstemp(report_template);
+    if (report_fd < 0)
+    {
+        cerr << "Error: could not create the report file: " << strerror(errno) << "\n";
+        return 1;
+    }
+    close(report_fd);
+    const string report_path = report_template;
+
+    ostringstream json_runs, json_results, csv;
+    csv << "variant,dataset,k,threads,metric,runs,mean,stddev,min,median,p90,max,speedup,efficiency\n";
+    bool first_run = true, first_result = true, failed = false;
+
+    for (const string &dataset : options.datasets)
+        for (int K : options.ks)
+        {
+            string path = datasetPath(options, dataset);
+            if (access(path.c_str(), R_OK) != 0)
+            {
+                cerr << "Error: dataset " << path << " not found\n";
+                failed = true;
+                continue;
+            }
+            string run_path = K > 0 ? datasetWithK(path, K) : path;
+            if (run_path.empty())
+            {
+                failed = true;
+                continue;
+            }
+
+            for (const string &variant : options.variants)
+            {
+                // 1-thread medians of this variant per phase, and the total-time curve for --scaling
+                double baseline[METRIC_COUNT];
+                for (int m = 0; m < METRIC_COUNT; m++)
+                    baseline[m] = NAN;
+                vector<pair<int, Summary>> curve;
+                int curve_metric = 0;
+
+                for (int threads : options.threads)
+                {
+                    string executable = options.bin_dir + "/" + variant;
+                    if (access(executable.c_str(), X_OK) != 0)
+                    {
+                        cerr << "Error: executable " << executable << " not found\n";
+                        failed = true;
+                        continue;
+                    }
+
+                    // Warmup runs fill the page cache and settle the CPU clocks; their timings are dropped
+                    vector<RunResult> runs;
+                    bool ok = true;
+                    for (int r = 0; ok && r < options.warmup + options.repeat; r++)
+                    {
+                        RunResult run = runOnce(executable, run_path, threads, report_path);
+                        ok = run.ok;
+                        if (ok && r >= options.warmup)
+                            runs.push_back(run);
+                    }
+                    if (!ok)
+                    {
+                        failed = true;
+                        continue;
+                    }
+
+                    // The iteration count must not change between runs, or the timings are not comparable
+                    bool stable_iterations = true;
+                    for (const RunResult &run : runs)
+                        stable_iterations = stable_iterations && run.iterations == runs[0].iterations;
+                    if (!stable_iterations)
+                        cerr << "Warning: " << variant << " on " << dataset << " converged in a different number of iterations across runs\n";
+
+                    string key = "\"variant\": \"" + variant + "\", \"dataset\": \"" + dataset + "\", \"k\": " +
+                                 to_string(K) + ", \"threads\": " + to_string(threads);
+                    for (size_t r = 0; r < runs.size(); r++)
+                    {
+                        json_runs << (first_run ? "" : ",\n") << "    {" << key << ", \"run\": " << r
+                                  << ", \"iterations\": " << runs[r].iterations;
+                        for (int m = 0; m < METRIC_COUNT; m++)
+                            json_runs << ", \"" << METRICS[m] << "\": " << jsonNumber(runs[r].metrics[m]);
+                        json_runs << "}";
+                        first_run = false;
+                    }
+
+                    json_results << (first_result ? "" : ",\n") << "    {" << key << ", \"runs\": " << runs.size()
+                                 << ", \"iterations\": " << runs[0].iterations
+                                 << ", \"stable_iterations\": " << (stable_iterations ? "true" : "false");
+                    first_result = false;
+
+                    cout << variant << " | " << dataset << " | K " << (K > 0 ? to_string(K) : "dataset") << " | threads "
+                         << (threads > 0 ? to_string(threads) : "default") << " | "
+                         << (runs[0].has_report ? to_string(runs[0].iterations) + " iterations" : "wall time only")
+                         << "\n";
+                    for (int m = 0; m < METRIC_COUNT; m++)
+                    {
+                        vector<double> samples;
+                        for (const RunResult &run : runs)
+                            if (!isnan(run.metrics[m]))
+                                samples.push_back(run.metrics[m]);
+                        Summary s = summarize(samples);
+                        if (threads == 1)
+                            baseline[m] = s.median;
+                        if (!isnan(baseline[m]) && s.median > 0)
+                        {
+                            s.speedup = baseline[m] / s.median;
+                            s.efficiency = threads > 0 ? s.speedup / threads : NAN;
+                        }
+                        // total_us, or wall_us for the implementations without a report
+                        if (m == (runs[0].has_report ? METRIC_COUNT - 1 : 0))
+                        {
+                            curve.push_back(make_pair(threads, s));
+                            curve_metric = m;
+                        }
+
+                        json_results << ", \"" << METRICS[m] << "\": {\"mean\": " << jsonNumber(s.mean)
+                                     << ", \"stddev\": " << jsonNumber(s.stddev) << ", \"min\": " << jsonNumber(s.min)
+                                     << ", \"median\": " << jsonNumber(s.median) << ", \"p90\": " << jsonNumber(s.p90)
+                                     << ", \"max\": " << jsonNumber(s.max) << ", \"speedup\": " << jsonNumber(s.speedup)
+                                     << ", \"efficiency\": " << jsonNumber(s.efficiency) << "}";
+                        csv << variant << "," << dataset << "," << K << "," << threads << "," << METRICS[m] << ","
+                            << samples.size() << "," << csvNumber(s.mean) << "," << csvNumber(s.stddev) << ","
+                            << csvNumber(s.min) << "," << csvNumber(s.median) << "," << csvNumber(s.p90) << ","
+                            << csvNumber(s.max) << "," << csvNumber(s.speedup) << "," << csvNumber(s.efficiency) << "\n";
+                        if (samples.empty())
+                            continue;
+                        printf("  %-14s median %12.0f  p90 %12.0f  stddev %10.0f µs", METRICS[m], s.median, s.p90,
+                               s.stddev);
+                        if (!isnan(s.speedup) && threads != 1)
+                            printf("  speedup %6.2fx", s.speedup);
+                        if (!isnan(s.efficiency) && threads != 1)
+                            printf("  efficiency %5.1f%%", 100.0 * s.efficiency);
+                        printf("\n");
+                    }
+                    json_results << "}";
+                }
+
+                if (options.scaling > 0 && !curve.empty())
+                {
+                    cout << variant << " | " << dataset << " | K " << (K > 0 ? to_string(K) : "dataset")
+                         << " | strong scaling of " << METRICS[curve_metric] << "\n";
+                    for (const pair<int, Summary> &point : curve)
+                        printf("  threads %4d  median %12.0f µs  speedup %6.2fx  efficiency %5.1f%%\n", point.first,
+                               point.second.median, point.second.speedup, 100.0 * point.second.efficiency);
+                }
+            }
+
+            if (run_path != path)
+                unlink(run_path.c_str());
+        }
+    unlink(report_path.c_str());
+
+    if (!options.json_path.empty())
+    {
+        ofstream json(options.json_path.c_str());
+        json << "{\n  \"warmup\": " << options.warmup << ",\n  \"repeat\": " << options.repeat
+             << ",\n  \"results\": [\n" << json_results.str() << "\n  ],\n  \"runs\": [\n" << json_runs.str()
+             << "\n  ]\n}\n";
+        if (!json.good())
+        {
+            cerr << "Error: could not write " << options.json_path << "\n";
+            failed = true;
+        }
+    }
+    if (!options.csv_path.empty())
+    {
+        ofstream out(options.csv_path.c_str());
+        out << csv.str();
+        if (!out.good())
+        {
+            cerr << "Error: could not write " << options.csv_path << "\n";
+            failed = true;
+        }
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,252 @@
+// Binary columnar dataset format
+//
+// SUMMARY
+// Even with the parallel text loader, every run re-parses the same ASCII digits. A binary dataset is the parsed matrix
+// itself, laid out the way PointMatrix keeps it in memory, so loading it is an mmap and a few pointer checks:
+//
+//   offset 0    BinaryDatasetHeader (the text header's five fields, value type, section offsets)
+//   columns     total_values column blocks of column_stride values each (float64 or float32), zero-padded to a
+//               multiple of PointMatrix::COLUMN_PADDING points, exactly like PointMatrix::buildColumns()
+//   rows        optional: the same values row-major as float64, for the kernels that walk one point at a time
+//   names       optional: total_points NUL-terminated point names
+//
+// Every section starts on a 64-byte boundary. A float64 file with a row section is attached to the PointMatrix in place
+// (no parsing, no copying: the pages come straight from the page cache). Without the row section the rows are
+// transposed from the columns, and float32 files are widened to double; both cost a copy but halve or shrink the file.
+// Names are copied into the matrix's side table. Values are stored in the machine's byte order.
+// Convert a text dataset with convert-dataset.cpp.
+// Samir's code
+
+#ifndef KMEANS_BINARY_DATASET_H
+#define KMEANS_BINARY_DATASET_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "mapped-input.h"
+#include "point-matrix.h"
+
+#define BINARY_DATASET_MAGIC "KMEANSBD"
+#define BINARY_DATASET_VERSION 1
+#define BINARY_DATASET_ALIGNMENT 64
+
+struct BinaryDatasetHeader
+{
+    char magic[8];           // BINARY_DATASET_MAGIC, not NUL-terminated
+    uint32_t version;        // BINARY_DATASET_VERSION
+    uint32_t value_bytes;    // Column values: 8 = float64, 4 = float32
+    int32_t total_points;    // The five fields of the text header
+    int32_t total_values;
+    int32_t K;
+    int32_t max_iterations;
+    int32_t has_name;
+    uint32_t reserved;       // Zero
+    uint64_t column_stride;  // Values per column block
+    uint64_t columns_offset; // Column blocks
+    uint64_t rows_offset;    // Row-major float64 values, 0 if absent
+    uint64_t names_offset;   // Names section, 0 if absent
+    uint64_t names_bytes;    // Length of the names section
+};
+
+inline bool isBinaryDataset(const char *begin, const char *end)
+{
+    return end - begin >= 8 && memcmp(begin, BINARY_DATASET_MAGIC, 8) == 0;
+}
+
+inline uint64_t alignOffset(uint64_t offset)
+{
+    return (offset + BINARY_DATASET_ALIGNMENT - 1) / BINARY_DATASET_ALIGNMENT * BINARY_DATASET_ALIGNMENT;
+}
+
+// Zeros from written up to the next section at offset
+inline bool writePadding(FILE *file, uint64_t &written, uint64_t offset)
+{
+    static const char zeros[BINARY_DATASET_ALIGNMENT] = {0};
+    while (written < offset)
+    {
+        size_t chunk = offset - written < sizeof(zeros) ? offset - written : sizeof(zeros);
+        if (fwrite(zeros, 1, chunk, file) != chunk)
+            return false;
+        written += chunk;
+    }
+    return true;
+}
+
+// ============================================================================
+// Writer: the header of the text dataset plus the loaded matrix. value_bytes is 8 or 4; with_rows adds the row section
+// (float64 only). Returns false with errno set if the file could not be written.
+// ============================================================================
+inline bool writeBinaryDataset(const char *path, const DatasetHeader &text_header, const PointMatrix &points,
+                               int value_bytes, bool with_rows)
+{
+    const int total_points = points.getTotalPoints();
+    const int total_values = points.getTotalValues();
+
+    BinaryDatasetHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BINARY_DATASET_MAGIC, 8);
+    header.version = BINARY_DATASET_VERSION;
+    header.value_bytes = value_bytes;
+    header.total_points = text_header.total_points;
+    header.total_values = text_header.total_values;
+    header.K = text_header.K;
+    header.max_iterations = text_header.max_iterations;
+    header.has_name = text_header.has_name;
+    header.column_stride = ((uint64_t)total_points + PointMatrix::COLUMN_PADDING - 1) / PointMatrix::COLUMN_PADDING *
+                           PointMatrix::COLUMN_PADDING;
+
+    // Section layout
+    std::string names;
+    if (points.hasNames())
+        for (int i = 0; i < total_points; i++)
+            names.append(points.getName(i).c_str(), points.getName(i).size() + 1);
+
+    uint64_t end = alignOffset(sizeof(header));
+    header.columns_offset = end;
+    end = alignOffset(end + header.column_stride * total_values * value_bytes);
+    if (with_rows && value_bytes == 8)
+    {
+        header.rows_offset = end;
+        end = alignOffset(end + (uint64_t)total_points * total_values * sizeof(double));
+    }
+    if (points.hasNames())
+    {
+        header.names_offset = end;
+        header.names_bytes = names.size();
+    }
+
+    FILE *file = fopen(path, "wb");
+    if (!file)
+        return false;
+
+    uint64_t written = 0;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    written += sizeof(header);
+
+    // Columns, one block per feature, zero after the last point
+    ok = ok && writePadding(file, written, header.columns_offset);
+    std::vector<double> column64(header.column_stride, 0.0);
+    std::vector<float> column32(header.column_stride, 0.0f);
+    for (int j = 0; ok && j < total_values; j++)
+    {
+        for (int i = 0; i < total_points; i++)
+        {
+            column64[i] = points.getValue(i, j);
+            column32[i] = (float)column64[i];
+        }
+        if (value_bytes == 8)
+            ok = fwrite(column64.data(), sizeof(double), column64.size(), file) == column64.size();
+        else
+            ok = fwrite(column32.data(), sizeof(float), column32.size(), file) == column32.size();
+        written += header.column_stride * value_bytes;
+    }
+
+    if (ok && header.rows_offset)
+    {
+        ok = writePadding(file, written, header.rows_offset);
+        size_t count = (size_t)total_points * total_values;
+        ok = ok && (count == 0 || fwrite(points.data(), sizeof(double), count, file) == count);
+        written += count * sizeof(double);
+    }
+
+    if (ok && header.names_offset)
+    {
+        ok = writePadding(file, written, header.names_offset);
+        ok = ok && (names.empty() || fwrite(names.data(), 1, names.size(), file) == names.size());
+    }
+
+    return fclose(file) == 0 && ok;
+}
+
+// ============================================================================
+// Reader: points the matrix at the input (see the summary for when it copies). input must start with the magic.
+// Returns false (after saying why) if the file is not one we can read.
+// ============================================================================
+inline bool attachBinaryDataset(const std::shared_ptr<MappedInput> &input, DatasetHeader &text_header,
+                                PointMatrix &points)
+{
+    char *begin = input->begin();
+    const uint64_t size = input->size();
+
+    BinaryDatasetHeader header;
+    if (size < sizeof(header))
+    {
+        std::cerr << "Error: binary dataset is shorter than its header" << std::endl;
+        return false;
+    }
+    memcpy(&header, begin, sizeof(header));
+
+    if (header.version != BINARY_DATASET_VERSION || (header.value_bytes != 8 && header.value_bytes != 4) ||
+        header.total_points < 0 || header.total_values <= 0)
+    {
+        std::cerr << "Error: unsupported binary dataset (version " << header.version << ", " << header.value_bytes
+                  << "-byte values)" << std::endl;
+        return false;
+    }
+
+    const int total_points = header.total_points;
+    const int total_values = header.total_values;
+    const uint64_t column_stride = ((uint64_t)total_points + PointMatrix::COLUMN_PADDING - 1) /
+                                   PointMatrix::COLUMN_PADDING * PointMatrix::COLUMN_PADDING;
+    const uint64_t columns_bytes = column_stride * total_values * header.value_bytes;
+    const uint64_t rows_bytes = (uint64_t)total_points * total_values * sizeof(double);
+    if (header.column_stride != column_stride || header.columns_offset + columns_bytes > size ||
+        (header.rows_offset && header.rows_offset + rows_bytes > size) ||
+        (header.names_offset && header.names_offset + header.names_bytes > size))
+    {
+        std::cerr << "Error: binary dataset is truncated or its sections do not match its header" << std::endl;
+        return false;
+    }
+
+    text_header.total_points = total_points;
+    text_header.total_values = total_values;
+    text_header.K = header.K;
+    text_header.max_iterations = header.max_iterations;
+    text_header.has_name = header.has_name;
+
+    char *columns = begin + header.columns_offset;
+    char *rows = header.rows_offset ? begin + header.rows_offset : nullptr;
+    bool in_place = header.value_bytes == 8 && (uintptr_t)columns % sizeof(double) == 0 &&
+                    (uintptr_t)rows % sizeof(double) == 0; // Only misaligned if stdin did not start at the file's start
+
+    if (in_place) // SAMIR - no parsing, no copying (rows are only transposed from the columns if the file has none)
+        points.attach(total_points, total_values, header.has_name != 0, (double *)rows, (double *)columns, input);
+    else
+    {
+        // Widen (or realign) into memory the matrix owns, then build the columns from the rows
+        points.reset(total_points, total_values, header.has_name != 0);
+        for (int j = 0; j < total_values; j++)
+            for (int i = 0; i < total_points; i++)
+            {
+                const char *value = columns + (j * column_stride + i) * header.value_bytes;
+                if (header.value_bytes == 8)
+                    memcpy(points.row(i) + j, value, sizeof(double));
+                else
+                {
+                    float narrow;
+                    memcpy(&narrow, value, sizeof(float));
+                    points.row(i)[j] = narrow;
+                }
+            }
+        points.buildColumns();
+    }
+
+    if (header.has_name && header.names_offset)
+    {
+        const char *name = begin + header.names_offset;
+        const char *names_end = name + header.names_bytes;
+        for (int i = 0; i < total_points && name < names_end; i++)
+        {
+            size_t length = strnlen(name, names_end - name);
+            points.setName(i, std::string(name, length));
+            name += length + 1;
+        }
+    }
+    return true;
+}
+
+#endif
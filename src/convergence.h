@@ -0,0 +1,233 @@
+// Inertia and centroid-shift tracking for the Lloyd loop of parallel.cpp (--tol-inertia, --tol-shift, --history)
+//
+// SUMMARY
+// Step 2c only stopped once no point changed cluster, or at max_iterations. On datasets like 8.txt most of those
+// iterations move the centroids by amounts nobody would notice, so ConvergenceMonitor measures every iteration's
+// inertia (the sum of squared distances of the points to their centroids) and its largest centroid shift, and lets
+// the loop stop once either has settled. Neither costs a pass over the points:
+//   - the inertia is summed by the Step 2b.2 accumulation kernels (accumulateClustersWithError() in
+//     dimension-kernels.h), which already read every point and its cluster: each point's squared distance to the
+//     centroid it was assigned to goes into the slot's error next to its counts, and the slots are merged by the same
+//     tree. With --reduction=deterministic or compensated the slots are the fixed chunks, so the inertia is the same
+//     for any thread count like the sums are. Each term is a distance computed directly from the point, so the sum
+//     stays accurate however small the inertia is next to the spread of the data. Delta updates skip that pass, so
+//     the inertia needs --update=full.
+//   - the shift compares the new centroids with a copy of the previous ones, K x total_values work.
+// The inertia of iteration i is that of its assignment to the centroids it was assigned against (those of iteration
+// i - 1), the value scikit-learn reports; Lloyd iterations never raise it. The last one is therefore a little above
+// computeInertia(), which measures the final assignment against the final centroids. The two stopping rules (either
+// one is enough):
+//   - --tol-inertia=X: the inertia dropped by less than X relative to the previous iteration
+//   - --tol-shift=X: no centroid moved by more than X times the RMS distance of the points to the dataset mean, so
+//     the tolerance is scale-free. That distance comes from one DataScatter pass before Step 2, only with --tol-shift.
+// Samir's code
+
+#ifndef KMEANS_CONVERGENCE_H
+#define KMEANS_CONVERGENCE_H
+
+#include <math.h>
+#include <algorithm>
+#include <ostream>
+#include <vector>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_reduce.h>
+#include "point-matrix.h"
+
+#define SCATTER_CHUNK_POINTS 8192 // Fixed chunks of the DataScatter pass, so the scatter is the same for any thread count
+
+// Count, mean and sum of squared distances to the mean of a set of points. add() is Welford's update and merge()
+// Chan et al.'s pairwise one, so no step subtracts two large sums of squares.
+struct DataScatter
+{
+    double count;
+    std::vector<double> mean;
+    double m2;
+
+    DataScatter() : count(0), m2(0) {}
+    explicit DataScatter(int total_values) : count(0), mean(total_values, 0.0), m2(0) {}
+
+    void add(const double *point)
+    {
+        count += 1;
+        for (size_t j = 0; j < mean.size(); j++)
+        {
+            double delta = point[j] - mean[j];
+            mean[j] += delta / count;
+            m2 += delta * (point[j] - mean[j]);
+        }
+    }
+
+    void merge(const DataScatter &other)
+    {
+        if (other.count == 0)
+            return;
+        if (count == 0)
+        {
+            *this = other;
+            return;
+        }
+        double total = count + other.count;
+        double distance = 0;
+        for (size_t j = 0; j < mean.size(); j++)
+        {
+            double delta = other.mean[j] - mean[j];
+            distance += delta * delta;
+            mean[j] += delta * (other.count / total);
+        }
+        m2 += other.m2 + distance * (count * other.count / total);
+        count = total;
+    }
+};
+
+// Scatter of points [first, last) of matrix: fixed chunks, each in index order, merged by a fixed tree
+inline DataScatter measureScatter(const PointMatrix &matrix, int first, int last)
+{
+    const int total_values = matrix.getTotalValues();
+    return tbb::parallel_deterministic_reduce(
+        tbb::blocked_range<int>(first, last, SCATTER_CHUNK_POINTS), DataScatter(total_values),
+        [&](const tbb::blocked_range<int> &range, DataScatter scatter)
+        {
+            for (int i = range.begin(); i < range.end(); i++)
+                scatter.add(matrix.row(i));
+            return scatter;
+        },
+        [](DataScatter left, const DataScatter &right)
+        {
+            left.merge(right);
+            return left;
+        });
+}
+
+// One iteration of the convergence history
+struct ConvergenceStep
+{
+    int iteration;
+    double inertia;  // 0 unless measuresInertia()
+    double change;   // (previous inertia - inertia) / previous inertia; 0 in iteration 1, which has no previous
+    double shift;    // Largest distance a centroid moved in this iteration
+};
+
+enum ConvergenceStop
+{
+    STOP_NONE,    // Still iterating, or stopped by Step 2c's own rules
+    STOP_INERTIA, // --tol-inertia was met
+    STOP_SHIFT    // --tol-shift was met
+};
+
+// ============================================================================
+//                              ConvergenceMonitor Class
+// ============================================================================
+class ConvergenceMonitor
+{
+private:
+    int K;
+    int total_values;
+    double tol_inertia;             // 0 = off
+    double tol_shift;               // 0 = off, in RMS distances of the points to the dataset mean
+    bool history_on;                // --history: print every iteration, not just the last
+    bool enabled;                   // Any tolerance, or --history
+    bool inertia_on;                // --tol-inertia or --history: Step 2b sums the inertia
+    bool measured;                  // scatter holds the whole dataset
+    DataScatter scatter;            // For the --tol-shift scale
+    std::vector<double> previous;   // K x total_values centroids at the start of the current iteration
+    std::vector<ConvergenceStep> history;
+    ConvergenceStop stop;
+
+public:
+    ConvergenceMonitor() : K(0), total_values(0), tol_inertia(0), tol_shift(0), history_on(false), enabled(false),
+                           inertia_on(false), measured(false), stop(STOP_NONE) {}
+
+    void init(int K, int total_values, double tol_inertia, double tol_shift, bool history_on)
+    {
+        this->K = K;
+        this->total_values = total_values;
+        this->tol_inertia = tol_inertia;
+        this->tol_shift = tol_shift;
+        this->history_on = history_on;
+        enabled = tol_inertia > 0 || tol_shift > 0 || history_on;
+        inertia_on = tol_inertia > 0 || history_on;
+        previous.resize((size_t)K * total_values);
+    }
+
+    inline bool isEnabled() const { return enabled; }
+    inline bool measuresInertia() const { return inertia_on; }
+    inline bool needsScatter() const { return tol_shift > 0 && !measured; }
+    inline ConvergenceStop getStop() const { return stop; }
+    inline const std::vector<ConvergenceStep> &getHistory() const { return history; }
+
+    void setScatter(const DataScatter &data)
+    {
+        scatter = data;
+        measured = true;
+    }
+
+    // Before iteration 1: the initial centroids
+    void start(const double *centroids)
+    {
+        std::copy(centroids, centroids + previous.size(), previous.begin());
+        history.clear();
+        stop = STOP_NONE;
+    }
+
+    // After Step 2b.4: the new centroids, and the merged error of the Step 2b accumulation when measuresInertia().
+    // Returns true once a tolerance is met, so the loop can stop.
+    bool record(int iteration, const double *centroids, double inertia)
+    {
+        double max_shift = 0;
+        for (int i = 0; i < K; i++)
+        {
+            const double *centroid = centroids + (size_t)i * total_values;
+            double *old = &previous[(size_t)i * total_values];
+            double shift = 0;
+            for (int j = 0; j < total_values; j++)
+            {
+                shift += (centroid[j] - old[j]) * (centroid[j] - old[j]);
+                old[j] = centroid[j];
+            }
+            max_shift = std::max(max_shift, shift);
+        }
+
+        ConvergenceStep step;
+        step.iteration = iteration;
+        step.inertia = inertia;
+        step.shift = sqrt(max_shift);
+        step.change = 0;
+        if (!history.empty() && history.back().inertia > 0)
+            step.change = (history.back().inertia - step.inertia) / history.back().inertia;
+        history.push_back(step);
+
+        if (tol_inertia > 0 && history.size() > 1 && fabs(step.change) < tol_inertia)
+            stop = STOP_INERTIA;
+        else if (tol_shift > 0 && scatter.count > 0 && step.shift <= tol_shift * sqrt(scatter.m2 / scatter.count))
+            stop = STOP_SHIFT;
+        return stop != STOP_NONE;
+    }
+
+    // "CONVERGENCE = ..." and, with --history, one "CONVERGENCE, ITERATION i = ..." line per iteration before it
+    void report(std::ostream &out) const
+    {
+        if (history.empty())
+            return;
+        std::streamsize old_precision = out.precision(12);
+        if (history_on)
+            for (const ConvergenceStep &step : history)
+                out << "CONVERGENCE, ITERATION " << step.iteration << " = inertia " << step.inertia << ", relative change "
+                    << step.change << ", max centroid shift " << step.shift << "\n";
+        out << "CONVERGENCE = ";
+        if (inertia_on)
+            out << "inertia " << history.back().inertia;
+        else
+            out << "max centroid shift " << history.back().shift;
+        out << " after " << history.back().iteration << " iterations, ";
+        if (stop == STOP_INERTIA)
+            out << "inertia tolerance " << tol_inertia << " met";
+        else if (stop == STOP_SHIFT)
+            out << "centroid shift tolerance " << tol_shift << " met";
+        else
+            out << "no tolerance met";
+        out << "\n";
+        out.precision(old_precision);
+    }
+};
+
+#endif
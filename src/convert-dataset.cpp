@@ -0,0 +1,68 @@
+// Converts a text dataset (datasets/*.txt layout) into the binary columnar format of binary-dataset.h
+//
+// SUMMARY
+// Usage: ./convert-dataset [--float32] [--no-rows] output.bin < datasets/8.txt
+// The text is read with the same loader every implementation uses, so the binary file holds exactly the values the
+// text run would cluster (including the zero-filled points of truncated datasets). By default the file has float64
+// columns and the float64 row section, which lets the implementations use it in place; --no-rows drops the row section
+// (the rows are then rebuilt at load time) and --float32 halves the columns at the cost of precision.
+// Any implementation reads the result on stdin like a text dataset: ./parallel < datasets/8.bin
+// Samir's code
+
+#include <errno.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+#include "point-matrix.h"
+#include "text-loader.h"
+#include "binary-dataset.h"
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+    int value_bytes = 8;
+    bool with_rows = true;
+    const char *output = nullptr;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--float32")
+            value_bytes = 4;
+        else if (arg == "--no-rows")
+            with_rows = false;
+        else if (arg.size() > 1 && arg[0] == '-')
+        {
+            cerr << "Error: unknown option " << arg << "\n";
+            output = nullptr;
+            break;
+        }
+        else
+            output = argv[i];
+    }
+    if (!output)
+    {
+        cerr << "Usage: " << argv[0] << " [--float32] [--no-rows] output.bin < dataset.txt\n";
+        return 1;
+    }
+
+    DatasetHeader header;
+    PointMatrix points;
+    if (!loadPointMatrix(STDIN_FILENO, header, points))
+    {
+        cerr << "Error: malformed dataset on standard input" << endl;
+        return 1;
+    }
+
+    if (!writeBinaryDataset(output, header, points, value_bytes, with_rows))
+    {
+        cerr << "Error: could not write " << output << ": " << strerror(errno) << endl;
+        return 1;
+    }
+
+    cout << "Wrote " << output << ": " << header.total_points << " points x " << header.total_values << " values, "
+         << (value_bytes == 8 ? "float64" : "float32") << " columns" << (with_rows && value_bytes == 8 ? " + rows" : "")
+         << (points.hasNames() ? " + names" : "") << "\n";
+    return 0;
+}
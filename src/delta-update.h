@@ -0,0 +1,140 @@
+// Incremental (delta) centroid updates for Step 2b
+//
+// SUMMARY
+// After the first few iterations only a handful of points change cluster, yet Step 2b re-adds every point's values into
+// fresh K x total_values sums each time. In delta mode the sums and counts of every cluster are kept across iterations
+// instead: Step 2a records a (point, old cluster, new cluster) move for every point it reassigns, into a list owned by
+// the worker that found it, and Step 2b subtracts each moved point from its old cluster's sums and adds it to its new
+// one. The per-iteration cost of Step 2b then follows the number of moved points instead of total_points.
+// Subtracting and re-adding rounds differently from summing from scratch, so the running sums slowly drift from the
+// exact ones; a full recompute every recompute_every iterations (and always in iteration 1) resets them.
+// Samir's code
+
+#ifndef KMEANS_DELTA_UPDATE_H
+#define KMEANS_DELTA_UPDATE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <tbb/parallel_for.h>
+#include "accumulators.h"
+#include "point-matrix.h"
+
+struct PointMove
+{
+    int32_t point;
+    int32_t from; // Cluster before this iteration's Step 2a
+    int32_t to;   // Cluster after it
+};
+
+class DeltaUpdater
+{
+private:
+    // One per worker slot; the padding keeps two workers' vector headers (written on every push_back) off a shared line
+    struct MoveList
+    {
+        std::vector<PointMove> moves;
+        std::vector<int32_t> before; // Assignments of the range being assigned, before the kernel ran
+        char padding[ACCUMULATOR_LINE_BYTES];
+    };
+
+    int K;
+    int total_values;
+    bool recording;                // Step 2a of this iteration records moves
+    std::vector<MoveList> lists;   // Indexed by ClusterAccumulators::localSlot()
+    AlignedBuffer<double> sums;    // Running K x total_values sums
+    AlignedBuffer<int> counts;     // Running K counts
+    long long moves_applied;       // Over the whole run, for the report
+
+public:
+    DeltaUpdater() : K(0), total_values(0), recording(false), moves_applied(0) {}
+
+    void init(int K, int total_values, int slots)
+    {
+        this->K = K;
+        this->total_values = total_values;
+        lists.resize(slots);
+        sums.resize((size_t)K * total_values);
+        counts.resize(K);
+    }
+
+    // Called before Step 2a; record = false on the iterations that recompute the sums from scratch
+    void startIteration(bool record)
+    {
+        recording = record;
+        for (size_t slot = 0; slot < lists.size(); slot++)
+            lists[slot].moves.clear(); // Keeps the capacity, so late iterations never allocate
+    }
+
+    // Wraps one range of Step 2a: assign() runs the engine on [begin, end) of assignments and returns how many points
+    // it moved. When recording, the moved points are appended to the slot's move list. Ranges where nothing moved
+    // (almost all of them late in a run) only cost the copy of their assignments.
+    template <typename Assign>
+    int assignRecording(int slot, int32_t *assignments, int begin, int end, Assign assign)
+    {
+        if (!recording)
+            return assign();
+
+        MoveList &list = lists[slot];
+        list.before.assign(assignments + begin, assignments + end);
+        int changed = assign();
+        for (int i = begin; changed != 0 && i < end; i++)
+        {
+            int32_t from = list.before[i - begin];
+            if (from != assignments[i])
+                list.moves.push_back(PointMove{i, from, assignments[i]});
+        }
+        return changed;
+    }
+
+    // Step 2b (full iterations): the freshly summed totals become the running sums
+    void resetSums(const double *total_sums, const int *total_counts)
+    {
+        memcpy(sums.data(), total_sums, (size_t)K * total_values * sizeof(double));
+        memcpy(counts.data(), total_counts, K * sizeof(int));
+    }
+
+    // Step 2b (delta iterations): each worker slot's moves go into the matching accumulator slot as +x for the new
+    // cluster and -x for the old one, the slots are tree-reduced, and the net change is added to the running sums
+    void applyMoves(const PointMatrix &points, ClusterAccumulators &accumulators)
+    {
+        accumulators.zero();
+        tbb::parallel_for(0, (int)lists.size(), [&](int slot)
+                          {
+            double *slot_sums = accumulators.sumsOf(slot);
+            int *slot_counts = accumulators.countsOf(slot);
+            const std::vector<PointMove> &moves = lists[slot].moves;
+            for (size_t m = 0; m < moves.size(); m++)
+            {
+                const double *point_values = points.row(moves[m].point);
+                double *from_sums = slot_sums + (size_t)moves[m].from * total_values;
+                double *to_sums = slot_sums + (size_t)moves[m].to * total_values;
+                for (int j = 0; j < total_values; j++)
+                {
+                    from_sums[j] -= point_values[j];
+                    to_sums[j] += point_values[j];
+                }
+                slot_counts[moves[m].from]--;
+                slot_counts[moves[m].to]++;
+            } });
+        accumulators.reduce();
+
+        const double *delta_sums = accumulators.totalSums();
+        const int *delta_counts = accumulators.totalCounts();
+        tbb::parallel_for(0, K, [&](int i)
+                          {
+            counts[i] += delta_counts[i];
+            double *cluster_sums = sums.data() + (size_t)i * total_values;
+            for (int j = 0; j < total_values; j++)
+                cluster_sums[j] += delta_sums[(size_t)i * total_values + j]; });
+
+        for (size_t slot = 0; slot < lists.size(); slot++)
+            moves_applied += lists[slot].moves.size();
+    }
+
+    inline const double *totalSums() const { return sums.data(); }
+    inline const int *totalCounts() const { return counts.data(); }
+    inline long long movesApplied() const { return moves_applied; }
+};
+
+#endif
@@ -0,0 +1,255 @@
+// Compile-time dimension-specialized kernels (Steps 2a and 2b)
+//
+// SUMMARY
+// Our production datasets have fixed, small dimension counts (2 for 6.txt, 4 for 7.txt, 7 for 8.txt, 16 for 3.txt),
+// yet the distance and accumulation loops ran over a runtime total_values with a remainder loop. Every kernel here is
+// instantiated for D = 1..KMEANS_MAX_FIXED_DIMENSION, where the dimension loops unroll completely and the values of a
+// point (or of a block of points in the SIMD kernels) can stay in registers while all K centroids stream past. The
+// dispatcher picks the instantiation from the header's total_values once, at load time, and falls back to the generic
+// (D = 0) kernels for anything wider. The unrolled kernels do the same arithmetic in the same order as the generic
+// ones, so the choice never changes a result.
+// Samir's code
+
+#ifndef KMEANS_DIMENSION_KERNELS_H
+#define KMEANS_DIMENSION_KERNELS_H
+
+#include "distance-kernels.h"
+#include "kahan-sum.h"
+
+#define KMEANS_MAX_FIXED_DIMENSION 32
+
+// ============================================================================
+// Step 2b accumulation: adds every point in [begin, end) to the K x total_values sums of its assigned cluster and
+// counts it. sums and counts belong to the calling thread.
+// ============================================================================
+typedef void (*AccumulateKernel)(const PointMatrix &points, int begin, int end, double *sums, int *counts);
+
+template <int D>
+inline void accumulateClusters(const PointMatrix &points, int begin, int end, double *sums, int *counts)
+{
+    const int total_values = D > 0 ? D : points.getTotalValues();
+    const int32_t *assignments = points.getAssignments();
+
+    for (int i = begin; i < end; i++)
+    {
+        int cluster_id = assignments[i];
+        counts[cluster_id]++;
+
+        const double *point_values = points.row(i);
+        double *cluster_sums = sums + (size_t)cluster_id * total_values;
+        for (int j = 0; j < total_values; j++)
+            cluster_sums[j] += point_values[j];
+    }
+}
+
+// Same sums and counts, plus the squared distance of every point to the centroid it is being added to, summed into
+// *error: the inertia of the assignment Step 2a just made, for --tol-inertia and --history. The centroids are those
+// Step 2a assigned against (K x total_values, not yet replaced by Step 2b.4), so this rides on the pass that already
+// reads every point and its assignment; the centroid row is one of K small rows that stay in cache.
+typedef void (*AccumulateErrorKernel)(const PointMatrix &points, int begin, int end, const double *centroids,
+                                      double *sums, int *counts, double *error);
+
+template <int D>
+inline void accumulateClustersWithError(const PointMatrix &points, int begin, int end, const double *centroids,
+                                        double *sums, int *counts, double *error)
+{
+    const int total_values = D > 0 ? D : points.getTotalValues();
+    const int32_t *assignments = points.getAssignments();
+    double range_error = 0.0;
+
+    for (int i = begin; i < end; i++)
+    {
+        int cluster_id = assignments[i];
+        counts[cluster_id]++;
+
+        const double *point_values = points.row(i);
+        const double *central_values = centroids + (size_t)cluster_id * total_values;
+        double *cluster_sums = sums + (size_t)cluster_id * total_values;
+        double distance = 0.0;
+        for (int j = 0; j < total_values; j++)
+        {
+            cluster_sums[j] += point_values[j];
+            double diff = point_values[j] - central_values[j];
+            distance += diff * diff;
+        }
+        range_error += distance;
+    }
+    *error += range_error;
+}
+
+// Same sums from the column-major copy: the fused engine in usion-parallel.cpp calls it right
+// after the distance kernel has streamed the same columns of the same points, so they are still in cache. Every
+// (cluster, feature) sum still adds its points in index order, so the result matches accumulateClusters() exactly.
+template <int D>
+inline void accumulateClusterColumns(const PointMatrix &points, int begin, int end, double *sums, int *counts)
+{
+    const int total_values = D > 0 ? D : points.getTotalValues();
+    const int32_t *assignments = points.getAssignments();
+    const size_t stride = points.getColumnStride();
+    const double *columns = points.column(0);
+
+    // Point by point like accumulateClusters(), so the adds into one cluster's features stay independent
+    for (int i = begin; i < end; i++)
+    {
+        int cluster_id = assignments[i];
+        counts[cluster_id]++;
+
+        const double *point_values = columns + i;
+        double *cluster_sums = sums + (size_t)cluster_id * total_values;
+        for (int j = 0; j < total_values; j++)
+            cluster_sums[j] += point_values[j * stride];
+    }
+}
+
+// Same sums, Kahan-compensated (the compensated reduction mode of parallel.cpp)
+typedef void (*CompensatedAccumulateKernel)(const PointMatrix &points, int begin, int end, KahanDouble *sums, int *counts);
+
+template <int D>
+inline void accumulateClustersCompensated(const PointMatrix &points, int begin, int end, KahanDouble *sums, int *counts)
+{
+    const int total_values = D > 0 ? D : points.getTotalValues();
+    const int32_t *assignments = points.getAssignments();
+
+    for (int i = begin; i < end; i++)
+    {
+        int cluster_id = assignments[i];
+        counts[cluster_id]++;
+
+        const double *point_values = points.row(i);
+        KahanDouble *cluster_sums = sums + (size_t)cluster_id * total_values;
+        for (int j = 0; j < total_values; j++)
+            cluster_sums[j].add(point_values[j]);
+    }
+}
+
+// accumulateClustersWithError() with Kahan-compensated sums; the error itself is a plain double
+typedef void (*CompensatedAccumulateErrorKernel)(const PointMatrix &points, int begin, int end, const double *centroids,
+                                                 KahanDouble *sums, int *counts, double *error);
+
+template <int D>
+inline void accumulateClustersCompensatedWithError(const PointMatrix &points, int begin, int end, const double *centroids,
+                                                   KahanDouble *sums, int *counts, double *error)
+{
+    const int total_values = D > 0 ? D : points.getTotalValues();
+    const int32_t *assignments = points.getAssignments();
+    double range_error = 0.0;
+
+    for (int i = begin; i < end; i++)
+    {
+        int cluster_id = assignments[i];
+        counts[cluster_id]++;
+
+        const double *point_values = points.row(i);
+        const double *central_values = centroids + (size_t)cluster_id * total_values;
+        KahanDouble *cluster_sums = sums + (size_t)cluster_id * total_values;
+        double distance = 0.0;
+        for (int j = 0; j < total_values; j++)
+        {
+            cluster_sums[j].add(point_values[j]);
+            double diff = point_values[j] - central_values[j];
+            distance += diff * diff;
+        }
+        range_error += distance;
+    }
+    *error += range_error;
+}
+
+// ============================================================================
+//                              Dimension Dispatcher
+// ============================================================================
+// Walks D down from KMEANS_MAX_FIXED_DIMENSION at compile time; at run time this is a chain of at most 32 compares,
+// done once per run.
+
+template <int D>
+struct DimensionDispatch
+{
+    static NearestCenterKernel nearest(SimdLevel level, int total_values)
+    {
+        if (total_values == D)
+            return nearestCenterKernelFor<D>(level);
+        return DimensionDispatch<D - 1>::nearest(level, total_values);
+    }
+
+    static AccumulateKernel accumulate(int total_values)
+    {
+        if (total_values == D)
+            return accumulateClusters<D>;
+        return DimensionDispatch<D - 1>::accumulate(total_values);
+    }
+
+    static AccumulateErrorKernel accumulateError(int total_values)
+    {
+        if (total_values == D)
+            return accumulateClustersWithError<D>;
+        return DimensionDispatch<D - 1>::accumulateError(total_values);
+    }
+
+    static AccumulateKernel accumulateColumns(int total_values)
+    {
+        if (total_values == D)
+            return accumulateClusterColumns<D>;
+        return DimensionDispatch<D - 1>::accumulateColumns(total_values);
+    }
+
+    static CompensatedAccumulateKernel accumulateCompensated(int total_values)
+    {
+        if (total_values == D)
+            return accumulateClustersCompensated<D>;
+        return DimensionDispatch<D - 1>::accumulateCompensated(total_values);
+    }
+
+    static CompensatedAccumulateErrorKernel accumulateCompensatedError(int total_values)
+    {
+        if (total_values == D)
+            return accumulateClustersCompensatedWithError<D>;
+        return DimensionDispatch<D - 1>::accumulateCompensatedError(total_values);
+    }
+};
+
+template <>
+struct DimensionDispatch<0>
+{
+    static NearestCenterKernel nearest(SimdLevel level, int) { return nearestCenterKernelFor<0>(level); }
+    static AccumulateKernel accumulate(int) { return accumulateClusters<0>; }
+    static AccumulateErrorKernel accumulateError(int) { return accumulateClustersWithError<0>; }
+    static AccumulateKernel accumulateColumns(int) { return accumulateClusterColumns<0>; }
+    static CompensatedAccumulateKernel accumulateCompensated(int) { return accumulateClustersCompensated<0>; }
+    static CompensatedAccumulateErrorKernel accumulateCompensatedError(int) { return accumulateClustersCompensatedWithError<0>; }
+};
+
+inline bool isFixedDimension(int total_values)
+{
+    return total_values >= 1 && total_values <= KMEANS_MAX_FIXED_DIMENSION;
+}
+
+inline NearestCenterKernel selectNearestCenterKernel(SimdLevel level, int total_values)
+{
+    return DimensionDispatch<KMEANS_MAX_FIXED_DIMENSION>::nearest(level, total_values);
+}
+
+inline AccumulateKernel selectAccumulateKernel(int total_values)
+{
+    return DimensionDispatch<KMEANS_MAX_FIXED_DIMENSION>::accumulate(total_values);
+}
+
+inline AccumulateErrorKernel selectAccumulateErrorKernel(int total_values)
+{
+    return DimensionDispatch<KMEANS_MAX_FIXED_DIMENSION>::accumulateError(total_values);
+}
+
+inline AccumulateKernel selectColumnAccumulateKernel(int total_values)
+{
+    return DimensionDispatch<KMEANS_MAX_FIXED_DIMENSION>::accumulateColumns(total_values);
+}
+
+inline CompensatedAccumulateKernel selectCompensatedAccumulateKernel(int total_values)
+{
+    return DimensionDispatch<KMEANS_MAX_FIXED_DIMENSION>::accumulateCompensated(total_values);
+}
+
+inline CompensatedAccumulateErrorKernel selectCompensatedAccumulateErrorKernel(int total_values)
+{
+    return DimensionDispatch<KMEANS_MAX_FIXED_DIMENSION>::accumulateCompensatedError(total_values);
+}
+
+#endif
@@ -0,0 +1,348 @@
+// Runtime-dispatched nearest-centroid kernels (Step 2a)
+//
+// SUMMARY
+// Our datasets only have 2-16 dimensions, so vectorizing the distance across dimensions (what the old unrolled-by-4
+// getIDNearestCenter hoped the compiler would do) wastes most of every vector lane. These kernels vectorize across
+// points instead: they read the column-major copy of the point matrix and compare 8 (AVX2) or 16 (AVX-512) points
+// against one broadcast centroid at a time, keeping the running minimum distance and its cluster ID in registers.
+// The instruction set is chosen once at startup via CPUID, so the binaries no longer need -march=native and can move
+// between our build and run hosts. Every path sums the squared differences in the same order as the scalar code, so
+// all three produce identical assignments.
+// Samir's code
+
+#ifndef KMEANS_DISTANCE_KERNELS_H
+#define KMEANS_DISTANCE_KERNELS_H
+
+#include <float.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <immintrin.h> // AVX2, AVX-512 (only used inside functions compiled for those targets)
+#include "point-matrix.h"
+
+// ============================================================================
+//                              SIMD Level Detection
+// ============================================================================
+
+enum SimdLevel
+{
+    SIMD_SCALAR = 0,
+    SIMD_AVX2 = 1,
+    SIMD_AVX512 = 2
+};
+
+inline const char *simdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+    case SIMD_AVX512:
+        return "avx512";
+    case SIMD_AVX2:
+        return "avx2";
+    default:
+        return "scalar";
+    }
+}
+
+// Highest level the CPU (and OS) supports. KMEANS_SIMD=scalar|avx2|avx512 can lower it, which is how we compare the
+// paths against each other on one machine; asking for more than the CPU has falls back to what it has.
+inline SimdLevel detectSimdLevel()
+{
+    SimdLevel level = SIMD_SCALAR;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        level = SIMD_AVX512;
+    else if (__builtin_cpu_supports("avx2"))
+        level = SIMD_AVX2;
+#endif
+
+    const char *requested = getenv("KMEANS_SIMD");
+    if (requested != nullptr)
+    {
+        SimdLevel wanted = level;
+        if (strcmp(requested, "scalar") == 0)
+            wanted = SIMD_SCALAR;
+        else if (strcmp(requested, "avx2") == 0)
+            wanted = SIMD_AVX2;
+        else if (strcmp(requested, "avx512") == 0)
+            wanted = SIMD_AVX512;
+        if (wanted < level)
+            level = wanted;
+    }
+    return level;
+}
+
+// ============================================================================
+// Every kernel assigns points [begin, end) to their nearest centroid, writes the result into the assignment array and
+// returns how many points changed cluster. centroids is a K x total_values row-major matrix.
+// Each kernel is a template on the dimension count D: D > 0 fixes total_values at compile time so the dimension loops
+// unroll completely (see dimension-kernels.h for the dispatcher), D == 0 is the generic runtime-dimension version.
+// ============================================================================
+typedef int (*NearestCenterKernel)(const PointMatrix &points, int begin, int end,
+                                   const double *centroids, int K, int32_t *assignments);
+
+// ============================================================================
+//                              Scalar Kernel
+// ============================================================================
+// Same arithmetic as the old getIDNearestCenter: squared distances (no sqrt), unrolled by 4 with the remainder last.
+
+template <int D>
+inline double squaredDistance(const double *central_values, const double *point_values, int runtime_values)
+{
+    const int total_values = D > 0 ? D : runtime_values;
+    double sum = 0.0;
+    int j = 0;
+
+    for (; j + 3 < total_values; j += 4)
+    {
+        double diff0 = central_values[j] - point_values[j];
+        double diff1 = central_values[j + 1] - point_values[j + 1];
+        double diff2 = central_values[j + 2] - point_values[j + 2];
+        double diff3 = central_values[j + 3] - point_values[j + 3];
+        sum += (diff1 * diff1) + (diff2 * diff2) + (diff3 * diff3) + (diff0 * diff0);
+    }
+
+    for (; j < total_values; j++)
+    {
+        double diff = central_values[j] - point_values[j];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// ============================================================================
+// Bound tests for the triangle-inequality modes (elkan-assign.h, hamerly-assign.h, yinyang-assign.h)
+// ============================================================================
+// Relative margin a bound must clear before it is allowed to skip a distance. Bounds pick up a few ulps of rounding
+// per iteration from sqrt and from the shift updates; this is many orders of magnitude above that and still skips
+// essentially everything a bound-exact implementation would. Anything closer is computed, so ties are always decided
+// by the exact squared distances.
+#define BOUND_SLACK 1e-10
+
+// True when an upper bound on d(x, a) proves that a distance known to be at least `lower` cannot win
+inline bool boundSkips(double upper, double lower)
+{
+    return upper * (1.0 + BOUND_SLACK) < lower;
+}
+
+template <int D>
+inline int nearestCenterScalar(const double *point_values, const double *centroids, int K, int runtime_values)
+{
+    const int total_values = D > 0 ? D : runtime_values;
+    double min_dist_sq = DBL_MAX;
+    int id_cluster_center = 0;
+
+    for (int i = 0; i < K; i++)
+    {
+        double sum = squaredDistance<D>(centroids + (size_t)i * total_values, point_values, total_values);
+        if (sum < min_dist_sq)
+        {
+            min_dist_sq = sum;
+            id_cluster_center = i;
+        }
+    }
+    return id_cluster_center;
+}
+
+template <int D>
+inline int nearestCentersScalar(const PointMatrix &points, int begin, int end,
+                                const double *centroids, int K, int32_t *assignments)
+{
+    const int total_values = D > 0 ? D : points.getTotalValues();
+    int changed = 0;
+
+    for (int i = begin; i < end; i++)
+    {
+        int id_nearest_center = nearestCenterScalar<D>(points.row(i), centroids, K, total_values);
+        if (assignments[i] != id_nearest_center)
+        {
+            assignments[i] = id_nearest_center;
+            changed++;
+        }
+    }
+    return changed;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// ============================================================================
+//                              AVX2 Kernel
+// ============================================================================
+// 8 points per step (two ymm registers of 4 doubles). Not compiled with FMA on purpose: fusing the multiply-adds
+// would round differently from the scalar path and could flip near-ties.
+
+template <int D>
+__attribute__((target("avx2"))) inline int nearestCentersAvx2(const PointMatrix &points, int begin, int end,
+                                                               const double *centroids, int K, int32_t *assignments)
+{
+    const int total_values = D > 0 ? D : points.getTotalValues();
+    const size_t stride = points.getColumnStride();
+    const double *columns = points.column(0);
+    int changed = 0;
+    int i = begin;
+
+    for (; i + 8 <= end; i += 8)
+    {
+        __m256d best_lo = _mm256_set1_pd(DBL_MAX), best_hi = _mm256_set1_pd(DBL_MAX);
+        __m256d best_id_lo = _mm256_setzero_pd(), best_id_hi = _mm256_setzero_pd();
+
+        for (int c = 0; c < K; c++)
+        {
+            const double *central_values = centroids + (size_t)c * total_values;
+            __m256d sum_lo = _mm256_setzero_pd(), sum_hi = _mm256_setzero_pd();
+            int j = 0;
+
+            for (; j + 3 < total_values; j += 4)
+            {
+                const double *col = columns + j * stride + i;
+                __m256d d0l = _mm256_sub_pd(_mm256_set1_pd(central_values[j]), _mm256_loadu_pd(col));
+                __m256d d0h = _mm256_sub_pd(_mm256_set1_pd(central_values[j]), _mm256_loadu_pd(col + 4));
+                __m256d d1l = _mm256_sub_pd(_mm256_set1_pd(central_values[j + 1]), _mm256_loadu_pd(col + stride));
+                __m256d d1h = _mm256_sub_pd(_mm256_set1_pd(central_values[j + 1]), _mm256_loadu_pd(col + stride + 4));
+                __m256d d2l = _mm256_sub_pd(_mm256_set1_pd(central_values[j + 2]), _mm256_loadu_pd(col + 2 * stride));
+                __m256d d2h = _mm256_sub_pd(_mm256_set1_pd(central_values[j + 2]), _mm256_loadu_pd(col + 2 * stride + 4));
+                __m256d d3l = _mm256_sub_pd(_mm256_set1_pd(central_values[j + 3]), _mm256_loadu_pd(col + 3 * stride));
+                __m256d d3h = _mm256_sub_pd(_mm256_set1_pd(central_values[j + 3]), _mm256_loadu_pd(col + 3 * stride + 4));
+
+                __m256d group_lo = _mm256_add_pd(_mm256_mul_pd(d1l, d1l), _mm256_mul_pd(d2l, d2l));
+                __m256d group_hi = _mm256_add_pd(_mm256_mul_pd(d1h, d1h), _mm256_mul_pd(d2h, d2h));
+                group_lo = _mm256_add_pd(_mm256_add_pd(group_lo, _mm256_mul_pd(d3l, d3l)), _mm256_mul_pd(d0l, d0l));
+                group_hi = _mm256_add_pd(_mm256_add_pd(group_hi, _mm256_mul_pd(d3h, d3h)), _mm256_mul_pd(d0h, d0h));
+                sum_lo = _mm256_add_pd(sum_lo, group_lo);
+                sum_hi = _mm256_add_pd(sum_hi, group_hi);
+            }
+
+            for (; j < total_values; j++)
+            {
+                const double *col = columns + j * stride + i;
+                __m256d dl = _mm256_sub_pd(_mm256_set1_pd(central_values[j]), _mm256_loadu_pd(col));
+                __m256d dh = _mm256_sub_pd(_mm256_set1_pd(central_values[j]), _mm256_loadu_pd(col + 4));
+                sum_lo = _mm256_add_pd(sum_lo, _mm256_mul_pd(dl, dl));
+                sum_hi = _mm256_add_pd(sum_hi, _mm256_mul_pd(dh, dh));
+            }
+
+            // Strictly-less keeps the lowest cluster ID on ties, like the scalar loop
+            __m256d closer_lo = _mm256_cmp_pd(sum_lo, best_lo, _CMP_LT_OQ);
+            __m256d closer_hi = _mm256_cmp_pd(sum_hi, best_hi, _CMP_LT_OQ);
+            __m256d id = _mm256_set1_pd((double)c);
+            best_lo = _mm256_blendv_pd(best_lo, sum_lo, closer_lo);
+            best_hi = _mm256_blendv_pd(best_hi, sum_hi, closer_hi);
+            best_id_lo = _mm256_blendv_pd(best_id_lo, id, closer_lo);
+            best_id_hi = _mm256_blendv_pd(best_id_hi, id, closer_hi);
+        }
+
+        int32_t nearest[8];
+        _mm_storeu_si128((__m128i *)nearest, _mm256_cvtpd_epi32(best_id_lo));
+        _mm_storeu_si128((__m128i *)(nearest + 4), _mm256_cvtpd_epi32(best_id_hi));
+        for (int p = 0; p < 8; p++)
+        {
+            if (assignments[i + p] != nearest[p])
+            {
+                assignments[i + p] = nearest[p];
+                changed++;
+            }
+        }
+    }
+
+    // Fewer than 8 points left in this range
+    return changed + nearestCentersScalar<D>(points, i, end, centroids, K, assignments);
+}
+
+// ============================================================================
+//                              AVX-512 Kernel
+// ============================================================================
+// 16 points per step (two zmm registers of 8 doubles), comparisons land in mask registers.
+
+template <int D>
+__attribute__((target("avx512f"))) inline int nearestCentersAvx512(const PointMatrix &points, int begin, int end,
+                                                                    const double *centroids, int K, int32_t *assignments)
+{
+    const int total_values = D > 0 ? D : points.getTotalValues();
+    const size_t stride = points.getColumnStride();
+    const double *columns = points.column(0);
+    int changed = 0;
+    int i = begin;
+
+    for (; i + 16 <= end; i += 16)
+    {
+        __m512d best_lo = _mm512_set1_pd(DBL_MAX), best_hi = _mm512_set1_pd(DBL_MAX);
+        __m512d best_id_lo = _mm512_setzero_pd(), best_id_hi = _mm512_setzero_pd();
+
+        for (int c = 0; c < K; c++)
+        {
+            const double *central_values = centroids + (size_t)c * total_values;
+            __m512d sum_lo = _mm512_setzero_pd(), sum_hi = _mm512_setzero_pd();
+            int j = 0;
+
+            for (; j + 3 < total_values; j += 4)
+            {
+                const double *col = columns + j * stride + i;
+                __m512d d0l = _mm512_sub_pd(_mm512_set1_pd(central_values[j]), _mm512_loadu_pd(col));
+                __m512d d0h = _mm512_sub_pd(_mm512_set1_pd(central_values[j]), _mm512_loadu_pd(col + 8));
+                __m512d d1l = _mm512_sub_pd(_mm512_set1_pd(central_values[j + 1]), _mm512_loadu_pd(col + stride));
+                __m512d d1h = _mm512_sub_pd(_mm512_set1_pd(central_values[j + 1]), _mm512_loadu_pd(col + stride + 8));
+                __m512d d2l = _mm512_sub_pd(_mm512_set1_pd(central_values[j + 2]), _mm512_loadu_pd(col + 2 * stride));
+                __m512d d2h = _mm512_sub_pd(_mm512_set1_pd(central_values[j + 2]), _mm512_loadu_pd(col + 2 * stride + 8));
+                __m512d d3l = _mm512_sub_pd(_mm512_set1_pd(central_values[j + 3]), _mm512_loadu_pd(col + 3 * stride));
+                __m512d d3h = _mm512_sub_pd(_mm512_set1_pd(central_values[j + 3]), _mm512_loadu_pd(col + 3 * stride + 8));
+
+                __m512d group_lo = _mm512_add_pd(_mm512_mul_pd(d1l, d1l), _mm512_mul_pd(d2l, d2l));
+                __m512d group_hi = _mm512_add_pd(_mm512_mul_pd(d1h, d1h), _mm512_mul_pd(d2h, d2h));
+                group_lo = _mm512_add_pd(_mm512_add_pd(group_lo, _mm512_mul_pd(d3l, d3l)), _mm512_mul_pd(d0l, d0l));
+                group_hi = _mm512_add_pd(_mm512_add_pd(group_hi, _mm512_mul_pd(d3h, d3h)), _mm512_mul_pd(d0h, d0h));
+                sum_lo = _mm512_add_pd(sum_lo, group_lo);
+                sum_hi = _mm512_add_pd(sum_hi, group_hi);
+            }
+
+            for (; j < total_values; j++)
+            {
+                const double *col = columns + j * stride + i;
+                __m512d dl = _mm512_sub_pd(_mm512_set1_pd(central_values[j]), _mm512_loadu_pd(col));
+                __m512d dh = _mm512_sub_pd(_mm512_set1_pd(central_values[j]), _mm512_loadu_pd(col + 8));
+                sum_lo = _mm512_add_pd(sum_lo, _mm512_mul_pd(dl, dl));
+                sum_hi = _mm512_add_pd(sum_hi, _mm512_mul_pd(dh, dh));
+            }
+
+            __mmask8 closer_lo = _mm512_cmp_pd_mask(sum_lo, best_lo, _CMP_LT_OQ);
+            __mmask8 closer_hi = _mm512_cmp_pd_mask(sum_hi, best_hi, _CMP_LT_OQ);
+            __m512d id = _mm512_set1_pd((double)c);
+            best_lo = _mm512_mask_blend_pd(closer_lo, best_lo, sum_lo);
+            best_hi = _mm512_mask_blend_pd(closer_hi, best_hi, sum_hi);
+            best_id_lo = _mm512_mask_blend_pd(closer_lo, best_id_lo, id);
+            best_id_hi = _mm512_mask_blend_pd(closer_hi, best_id_hi, id);
+        }
+
+        int32_t nearest[16];
+        _mm256_storeu_si256((__m256i *)nearest, _mm512_cvtpd_epi32(best_id_lo));
+        _mm256_storeu_si256((__m256i *)(nearest + 8), _mm512_cvtpd_epi32(best_id_hi));
+        for (int p = 0; p < 16; p++)
+        {
+            if (assignments[i + p] != nearest[p])
+            {
+                assignments[i + p] = nearest[p];
+                changed++;
+            }
+        }
+    }
+
+    // Fewer than 16 points left in this range
+    return changed + nearestCentersScalar<D>(points, i, end, centroids, K, assignments);
+}
+
+#endif
+
+// Kernel for one dimension count; selectNearestCenterKernel() in dimension-kernels.h picks D from the dataset header
+template <int D>
+inline NearestCenterKernel nearestCenterKernelFor(SimdLevel level)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (level == SIMD_AVX512)
+        return nearestCentersAvx512<D>;
+    if (level == SIMD_AVX2)
+        return nearestCentersAvx2<D>;
+#endif
+    return nearestCentersScalar<D>;
+}
+
+#endif
@@ -0,0 +1,220 @@
+// Elkan triangle-inequality accelerated assignment (Step 2a)
+//
+// SUMMARY
+// Late iterations are dominated by points that never move, yet every iteration computed all K distances for every
+// point. Elkan's algorithm keeps, per point, an upper bound u on the distance to its own centroid and a lower bound
+// l[c] on the distance to every other centroid, plus the K x K inter-centroid distances. A centroid c can be skipped
+// for a point whenever u < l[c] or u < d(a, c) / 2 (a = the point's current centroid), and the whole point can be
+// skipped when u < min over c of d(a, c) / 2. After the centroids move, the bounds are loosened by how far each
+// centroid moved instead of being recomputed. Loosening the K lower bounds is itself a pass over K doubles per point,
+// so it is done lazily: we keep the cumulative drift of every centroid per iteration and only bring a point's lower
+// bounds up to date when the cheap whole-point test fails and they are actually needed.
+// Every distance that is still computed uses the same squared-distance arithmetic as the direct kernels, ties go to
+// the lower cluster ID, and a bound only skips a centroid when it is clear of the rounding in the bounds
+// themselves (BOUND_SLACK), so the assignments are exactly the ones the direct kernels would produce.
+// Memory: K + 1 doubles and one int per point on top of the point matrix, plus K doubles per iteration of drift.
+// Samir's code
+
+#ifndef KMEANS_ELKAN_ASSIGN_H
+#define KMEANS_ELKAN_ASSIGN_H
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include "distance-kernels.h"
+
+// ============================================================================
+//                              ElkanAssigner Class
+// ============================================================================
+// setCentroids() runs once per iteration before Step 2a (it computes the centroid shifts and the inter-centroid
+// distances with a TBB parallel_for over the K rows); assign() is then safe to call from any number of threads on
+// disjoint point ranges, since each point only touches its own bounds.
+
+class ElkanAssigner
+{
+private:
+    int K;                                   // Number of clusters
+    int total_values;                        // Number of features per point
+    bool bounds_ready;                       // False until the first full pass has set every bound
+    int epoch;                               // Iterations since the first full pass
+    const double *centroids;                 // Current K x total_values centroid matrix (owned by KMeans)
+    AlignedBuffer<double> upper;             // Per point: upper bound on the distance to its centroid
+    AlignedBuffer<double> lower;             // Per point: K lower bounds, one per centroid
+    AlignedBuffer<int32_t> lower_epoch;      // Per point: epoch its lower bounds were last brought up to date
+    AlignedBuffer<double> previous;          // Centroids of the previous iteration, for the shifts
+    AlignedBuffer<double> shifts;            // How far each centroid moved since the previous iteration
+    AlignedBuffer<double> center_distances;  // K x K distances between centroids
+    AlignedBuffer<double> half_min_distance; // Per centroid: half the distance to its closest other centroid
+    std::vector<double> drift;               // Per epoch: K cumulative distances moved since the first full pass
+
+    // First iteration: every distance is computed, in cluster order, exactly like nearestCenterScalar
+    int assignAll(const PointMatrix &points, int begin, int end, int32_t *assignments, long long &computed)
+    {
+        int changed = 0;
+        for (int i = begin; i < end; i++)
+        {
+            const double *point_values = points.row(i);
+            double *point_lower = lower.data() + (size_t)i * K;
+            double min_dist_sq = DBL_MAX;
+            int id_nearest_center = 0;
+
+            for (int c = 0; c < K; c++)
+            {
+                double dist_sq = squaredDistance<0>(centroids + (size_t)c * total_values, point_values, total_values);
+                point_lower[c] = sqrt(dist_sq);
+                if (dist_sq < min_dist_sq)
+                {
+                    min_dist_sq = dist_sq;
+                    id_nearest_center = c;
+                }
+            }
+            computed += K;
+            upper[i] = sqrt(min_dist_sq);
+            lower_epoch[i] = 0;
+
+            if (assignments[i] != id_nearest_center)
+            {
+                assignments[i] = id_nearest_center;
+                changed++;
+            }
+        }
+        return changed;
+    }
+
+public:
+    ElkanAssigner() : K(0), total_values(0), bounds_ready(false), epoch(0), centroids(nullptr) {}
+
+    void init(int K, int total_points, int total_values)
+    {
+        this->K = K;
+        this->total_values = total_values;
+        bounds_ready = false;
+        epoch = 0;
+        centroids = nullptr;
+
+        upper.resize(total_points);
+        lower.resize((size_t)total_points * K);
+        lower_epoch.resize(total_points);
+        previous.resize((size_t)K * total_values);
+        shifts.resize(K);
+        center_distances.resize((size_t)K * K);
+        half_min_distance.resize(K);
+    }
+
+    // centroids is the K x total_values row-major centroid matrix; it must stay put until the next call
+    void setCentroids(const double *centroids)
+    {
+        bool first_call = this->centroids == nullptr;
+        bounds_ready = !first_call;
+        this->centroids = centroids;
+        epoch = first_call ? 0 : epoch + 1;
+        drift.resize((size_t)(epoch + 1) * K);
+
+        tbb::parallel_for(tbb::blocked_range<int>(0, K), [&](const tbb::blocked_range<int> &range)
+                          {
+            for (int c = range.begin(); c < range.end(); c++)
+            {
+                const double *central_values = centroids + (size_t)c * total_values;
+                double *previous_values = previous.data() + (size_t)c * total_values;
+
+                shifts[c] = first_call ? 0.0 : sqrt(squaredDistance<0>(central_values, previous_values, total_values));
+                drift[(size_t)epoch * K + c] = first_call ? 0.0 : drift[(size_t)(epoch - 1) * K + c] + shifts[c];
+                memcpy(previous_values, central_values, total_values * sizeof(double));
+
+                double min_distance = HUGE_VAL;
+                for (int other = 0; other < K; other++)
+                {
+                    double distance = sqrt(squaredDistance<0>(central_values, centroids + (size_t)other * total_values, total_values));
+                    center_distances[(size_t)c * K + other] = distance;
+                    if (other != c && distance < min_distance)
+                        min_distance = distance;
+                }
+                half_min_distance[c] = 0.5 * min_distance;
+            } });
+    }
+
+    // Same contract as a NearestCenterKernel: assigns [begin, end) and returns how many points changed cluster.
+    // computed is increased by the number of point-centroid distances actually evaluated.
+    int assign(const PointMatrix &points, int begin, int end, int32_t *assignments, long long &computed)
+    {
+        if (!bounds_ready)
+            return assignAll(points, begin, end, assignments, computed);
+
+        const double *drift_now = drift.data() + (size_t)epoch * K;
+        int changed = 0;
+        for (int i = begin; i < end; i++)
+        {
+            const double *point_values = points.row(i);
+            double *point_lower = lower.data() + (size_t)i * K;
+            int a = assignments[i];
+
+            // Loosen the upper bound by how far the point's centroid moved
+            double u = upper[i] + shifts[a];
+
+            // No other centroid is closer than half the distance to a's nearest neighbour
+            if (boundSkips(u, half_min_distance[a]))
+            {
+                upper[i] = u;
+                continue;
+            }
+
+            // Loosen the lower bounds by everything the centroids moved since they were last touched
+            const double *drift_then = drift.data() + (size_t)lower_epoch[i] * K;
+            for (int c = 0; c < K; c++)
+            {
+                double l = point_lower[c] - (drift_now[c] - drift_then[c]);
+                point_lower[c] = l > 0.0 ? l : 0.0;
+            }
+            lower_epoch[i] = epoch;
+
+            bool stale = true; // u is still a bound, not the exact distance
+            double dist_sq_a = 0.0;
+            for (int c = 0; c < K; c++)
+            {
+                if (c == a)
+                    continue;
+
+                double bound = 0.5 * center_distances[(size_t)a * K + c];
+                if (point_lower[c] > bound)
+                    bound = point_lower[c];
+                if (boundSkips(u, bound))
+                    continue;
+
+                if (stale)
+                {
+                    dist_sq_a = squaredDistance<0>(centroids + (size_t)a * total_values, point_values, total_values);
+                    u = sqrt(dist_sq_a);
+                    point_lower[a] = u;
+                    stale = false;
+                    computed++;
+                    if (boundSkips(u, bound))
+                        continue;
+                }
+
+                double dist_sq_c = squaredDistance<0>(centroids + (size_t)c * total_values, point_values, total_values);
+                point_lower[c] = sqrt(dist_sq_c);
+                computed++;
+
+                // Ties go to the lower cluster ID, like the strictly-less scan of the direct kernels
+                if (dist_sq_c < dist_sq_a || (dist_sq_c == dist_sq_a && c < a))
+                {
+                    a = c;
+                    dist_sq_a = dist_sq_c;
+                    u = point_lower[c];
+                }
+            }
+            upper[i] = u;
+
+            if (assignments[i] != a)
+            {
+                assignments[i] = a;
+                changed++;
+            }
+        }
+        return changed;
+    }
+};
+
+#endif
@@ -14,110 +14,52 @@
 #include <algorithm>	 // For utility functions like find()
 #include <chrono>		 // For measuring execution time
 #include <unordered_set> // For faster duplicate checking
+// shared point storage
+#include "point-matrix.h"
+#include "text-loader.h"
+#include "bench-report.h"
 
 using namespace std; // Allows using standard C++ functions without the "std::" prefix
 
-// ============================================================================
-//                              Point Class
-// ============================================================================
-// This class represents a **single data point** in the dataset.
-// Each point contains:
-//   - A unique **ID** (`id_point`) for identification
-//   - A **vector of values** (`values`), which represents feature values
-//   - The **total number of feature values** (`total_values`)
-//   - A **cluster assignment** (`id_cluster`) to track which cluster it belongs to
-//   - An **optional name** (`name`) for identification (e.g., labeling points)
-
-class Point
-{
-private:
-	int id_point;		   // Unique identifier for the point
-	int id_cluster;		   // ID of the cluster this point is assigned to
-	vector<double> values; // Stores the feature values of the point
-	int total_values;	   // Number of features (dimensions) for this point
-	string name;		   // Optional name of the point (default: empty)
-
-public:
-	// ============================================================================
-	// Constructor: Initializes a point with an ID, feature values, and an optional name.
-	// ============================================================================
-	Point(int id_point, vector<double> &values, string name = "")
-	{
-		this->id_point = id_point;	  // Assigns the point ID
-		total_values = values.size(); // Stores the total number of features
-		// this->values.reserve(total_values); // DOESN'T WORK - dynamic resizing
-
-		// SAMIR - Loop unrolling
-		int i = 0;
-		for (; i + 3 < total_values; i += 4) // Copy 4 values per loop
-		{
-			this->values.push_back(values[i]);
-			this->values.push_back(values[i + 1]);
-			this->values.push_back(values[i + 2]);
-			this->values.push_back(values[i + 3]);
-		}
-
-		// Handle remaining values
-		for (; i < total_values; i++)
-			this->values.push_back(values[i]);
-
-		this->name = name; // Assigns the name (if provided)
-		id_cluster = -1;   // Initially, the point is not assigned to any cluster (-1)
-	}
-
-	// ============================================================================
-	// Getter Methods: Retrieve information about the point.
-	// ============================================================================
-
-	// SAMIR - Inline small functions
-	inline int getID() const { return id_point; }
-	inline int getCluster() const { return id_cluster; }
-	inline void setCluster(int id_cluster) { this->id_cluster = id_cluster; }
-	inline double getValue(int index) const { return values[index]; }
-	inline int getTotalValues() const { return total_values; }
-	inline string getName() const { return name; }
-};
-
 class Cluster
 {
 private:
 	int id_cluster;
 	vector<double> central_values;
-	vector<Point> points;
+	vector<int> points; // SAMIR - row indexes into the shared point matrix instead of copies of every point
 
 public:
-	Cluster(int id_cluster, Point point)
+	Cluster(int id_cluster, int id_point, const double *point_values, int total_values)
 	{
 		this->id_cluster = id_cluster;
 
-		int total_values = point.getTotalValues();
 		central_values.reserve(total_values); // SAMIR - reserve space for feature values
 
 		int i = 0;
 		// SAMIR - Unroll by copying 4 feature values at a time
 		for (; i + 3 < total_values; i += 4)
 		{
-			central_values.push_back(point.getValue(i));
-			central_values.push_back(point.getValue(i + 1));
-			central_values.push_back(point.getValue(i + 2));
-			central_values.push_back(point.getValue(i + 3));
+			central_values.push_back(point_values[i]);
+			central_values.push_back(point_values[i + 1]);
+			central_values.push_back(point_values[i + 2]);
+			central_values.push_back(point_values[i + 3]);
 		}
 
 		// Copy remaining feature values
 		for (; i < total_values; i++)
 		{
-			central_values.push_back(point.getValue(i));
+			central_values.push_back(point_values[i]);
 		}
 
-		points.push_back(point);
+		points.push_back(id_point);
 	}
 
-	void addPoint(Point point)
+	void addPoint(int id_point)
 	{
 		if (points.capacity() == 0) // SAMIR - Only reserve once
 			points.reserve(50);		// dependent based on dataset I am using
 									// total points/K is the amount of points in each cluster and we should reserve that amount
-		points.push_back(point);	// Efficiently add point
+		points.push_back(id_point); // Efficiently add point
 	}
 
 	bool removePoint(int id_point)
@@ -126,7 +68,7 @@ public:
 
 		for (int i = 0; i < total_points; i++)
 		{
-			if (points[i].getID() == id_point)
+			if (points[i] == id_point)
 			{
 				points.erase(points.begin() + i);
 				return true;
@@ -144,7 +86,7 @@ public:
 
 	inline double getCentralValue(int index) const { return central_values[index]; }
 	inline void setCentralValue(int index, double value) { central_values[index] = value; }
-	inline Point getPoint(int index) const { return points[index]; }
+	inline int getPoint(int index) const { return points[index]; }
 	inline int getTotalPoints() const { return points.size(); }
 	inline int getID() const { return id_cluster; }
 	inline void shrinkPoints() { points.shrink_to_fit(); }
@@ -185,7 +127,7 @@ private:
 	// It calculates the distance between the given point and each cluster centroid,
 	// then selects the closest one.
 	// ======================================================================
-	int getIDNearestCenter(Point point)
+	int getIDNearestCenter(const double *point_values)
 	{
 		double sum = 0.0, min_dist;
 		int id_cluster_center = 0;
@@ -195,10 +137,10 @@ private:
 		int j = 0;
 		for (; j + 3 < total_values; j += 4) // Process 4 values per iteration
 		{
-			double diff1 = clusters[0].getCentralValue(j) - point.getValue(j);
-			double diff2 = clusters[0].getCentralValue(j + 1) - point.getValue(j + 1);
-			double diff3 = clusters[0].getCentralValue(j + 2) - point.getValue(j + 2);
-			double diff4 = clusters[0].getCentralValue(j + 3) - point.getValue(j + 3);
+			double diff1 = clusters[0].getCentralValue(j) - point_values[j];
+			double diff2 = clusters[0].getCentralValue(j + 1) - point_values[j + 1];
+			double diff3 = clusters[0].getCentralValue(j + 2) - point_values[j + 2];
+			double diff4 = clusters[0].getCentralValue(j + 3) - point_values[j + 3];
 			// SAMIR - Replace pow(x, 2.0) with Direct Multiplication
 			sum += (diff1 * diff1) + (diff2 * diff2) + (diff3 * diff3) + (diff4 * diff4);
 		}
@@ -206,7 +148,7 @@ private:
 		// Handle remaining values (if total_values % 4 != 0)
 		for (; j < total_values; j++)
 		{
-			double diff = clusters[0].getCentralValue(j) - point.getValue(j);
+			double diff = clusters[0].getCentralValue(j) - point_values[j];
 			sum += diff * diff;
 		}
 
@@ -220,7 +162,7 @@ private:
 			// Compute the squared Euclidean distance for each cluster
 			for (int j = 0; j < total_values; j++)
 			{
-				double diff = clusters[i].getCentralValue(j) - point.getValue(j);
+				double diff = clusters[i].getCentralValue(j) - point_values[j];
 				sum += diff * diff; // use squared difference
 			}
 
@@ -234,6 +176,7 @@ private:
 
 		return id_cluster_center; // Return the nearest cluster index
 	}
+	BenchReport bench; // Phase timings for benchmark.cpp (bench-report.h)
 
 public:
 	// ======================================================================
@@ -254,7 +197,9 @@ public:
 	// It initializes the clusters, assigns points, recalculates centroids,
 	// and stops when convergence is reached or the max iterations are exceeded.
 	// ======================================================================
-	void run(vector<Point> &points)
+	inline const BenchReport &getBenchReport() const { return bench; }
+
+	void run(PointMatrix &points)
 	{
 		auto begin = chrono::high_resolution_clock::now(); // Start total time measurement
 
@@ -272,8 +217,8 @@ public:
 
 			if (chosen_indexes.insert(index_point).second) // SAMIR - O(1) lookup and insert
 			{
-				points[index_point].setCluster(chosen_indexes.size() - 1);			   // Assign cluster
-				clusters.emplace_back(chosen_indexes.size() - 1, points[index_point]); // SAMIR - emplace back
+				points.setCluster(index_point, chosen_indexes.size() - 1);			   // Assign cluster
+				clusters.emplace_back(chosen_indexes.size() - 1, index_point, points.row(index_point), total_values); // SAMIR - emplace back
 			}
 		}
 
@@ -292,20 +237,22 @@ public:
 			// Step 2a: **Assign each point to the nearest cluster**
 			for (int i = 0; i < total_points; i++)
 			{
-				int id_old_cluster = points[i].getCluster();
-				int id_nearest_center = getIDNearestCenter(points[i]);
+				int id_old_cluster = points.getCluster(i);
+				int id_nearest_center = getIDNearestCenter(points.row(i));
 
 				if (id_old_cluster != id_nearest_center)
 				{
 					if (id_old_cluster != -1)
-						clusters[id_old_cluster].removePoint(points[i].getID());
+						clusters[id_old_cluster].removePoint(i);
 
-					points[i].setCluster(id_nearest_center);
-					clusters[id_nearest_center].addPoint(points[i]);
+					points.setCluster(i, id_nearest_center);
+					clusters[id_nearest_center].addPoint(i);
 					done = false;
 				}
 			}
 
+			auto assign_end = chrono::high_resolution_clock::now();
+
 			// Step 2b: **Recalculate the centroids based on new assignments**
 			for (int i = 0; i < K; i++)
 			{ // SAMIR - Loop unrolling
@@ -319,16 +266,16 @@ public:
 						int p = 0;
 						for (; p + 3 < total_points_cluster; p += 4) // Unroll loop for every 4 points
 						{
-							sum += clusters[i].getPoint(p).getValue(j) +
-								   clusters[i].getPoint(p + 1).getValue(j) +
-								   clusters[i].getPoint(p + 2).getValue(j) +
-								   clusters[i].getPoint(p + 3).getValue(j);
+							sum += points.getValue(clusters[i].getPoint(p), j) +
+								   points.getValue(clusters[i].getPoint(p + 1), j) +
+								   points.getValue(clusters[i].getPoint(p + 2), j) +
+								   points.getValue(clusters[i].getPoint(p + 3), j);
 						}
 
 						// Handle remaining points
 						for (; p < total_points_cluster; p++)
 						{
-							sum += clusters[i].getPoint(p).getValue(j);
+							sum += points.getValue(clusters[i].getPoint(p), j);
 						}
 
 						clusters[i].setCentralValue(j, sum / total_points_cluster);
@@ -338,6 +285,8 @@ public:
 
 			auto iteration_end = chrono::high_resolution_clock::now();													  // End iteration time
 			total_iteration_time += chrono::duration_cast<chrono::microseconds>(iteration_end - iteration_start).count(); // Accumulate iteration time
+			bench.assignment += benchMicros(assign_end - iteration_start);
+			bench.update += benchMicros(iteration_end - assign_end);
 
 			// Step 2c: **Check stopping conditions**
 			if (done == true || iter >= max_iterations)
@@ -350,6 +299,10 @@ public:
 		}
 
 		auto end = chrono::high_resolution_clock::now(); // End total execution time
+		bench.seeding = benchMicros(end_phase1 - begin);
+		bench.phase2 = benchMicros(end - end_phase1);
+		bench.total = benchMicros(end - begin);
+		bench.iterations = iter;
 
 		for (int i = 0; i < K; i++)
 		{
@@ -364,11 +317,11 @@ public:
 			cout << "Cluster " << clusters[i].getID() + 1 << endl;
 			for (int j = 0; j < total_points_cluster; j++)
 			{
-				// cout << "Point " << clusters[i].getPoint(j).getID() + 1 << ": ";
+				// cout << "Point " << clusters[i].getPoint(j) + 1 << ": ";
 				// for (int p = 0; p < total_values; p++)
-				// 	cout << clusters[i].getPoint(j).getValue(p) << " ";
+				// 	cout << points.getValue(clusters[i].getPoint(j), p) << " ";
 
-				// string point_name = clusters[i].getPoint(j).getName();
+				// string point_name = points.hasNames() ? points.getName(clusters[i].getPoint(j)) : "";
 				// if (point_name != "")
 				// 	cout << "- " << point_name;
 
@@ -444,59 +397,36 @@ int main(int argc, char *argv[])
 	// Seed the random number generator (for selecting initial centroids randomly)
 	srand(10);
 
-	int total_points, total_values, K, max_iterations, has_name;
-
 	// ==========================================================================
-	// Step 1: Read Input Values
+	// Step 1: Read Input Values and Points
 	// ==========================================================================
-	// Read the total number of data points, the number of features per point,
+	// The header gives the total number of data points, the number of features per point,
 	// the number of clusters (K), the maximum number of iterations, and whether
-	// each point has a name.
-	cin >> total_points >> total_values >> K >> max_iterations >> has_name;
-
-	// Declare a vector to store all points in the dataset
-	vector<Point> points;
-	points.reserve(total_points); // SAMIR - Preallocate memory for all points
-	string point_name;			  // To store the optional name of the point
-
-	// ==========================================================================
-	// Step 2: Read Points from Input
-	// ==========================================================================
-	for (int i = 0; i < total_points; i++)
+	// each point has a name. SAMIR - every point is read straight into one contiguous matrix
+	auto begin_load = chrono::high_resolution_clock::now();
+	DatasetHeader header;
+	PointMatrix points;
+	if (!loadPointMatrix(STDIN_FILENO, header, points)) // SAMIR - mmap the dataset and parse it without iostreams
 	{
-		vector<double> values;		  // Store feature values of the current point
-		values.reserve(total_values); // SAMIR - preallocate memory for feature values
-
-		// Read the feature values for the current point
-		for (int j = 0; j < total_values; j++)
-		{
-			double value;
-			cin >> value;
-			values.push_back(value);
-		}
-
-		// If the points have names, read and store the name
-		if (has_name)
-		{
-			cin >> point_name;
-			Point p(i, values, point_name); // Create a Point with a name
-			points.emplace_back(i, values); // SAMIR - emplace back
-		}
-		else
-		{
-			Point p(i, values);				// Create a Point without a name
-			points.emplace_back(i, values); // SAMIR - emplace back
-		}
+		cerr << "Error: malformed dataset on standard input" << endl;
+		return 1;
 	}
+	auto end_load = chrono::high_resolution_clock::now();
 
 	// ==========================================================================
 	// Step 3: Initialize K-Means Algorithm and Run Clustering
 	// ==========================================================================
 	// Create an instance of KMeans with the input parameters
-	KMeans kmeans(K, total_points, total_values, max_iterations);
+	KMeans kmeans(header.K, header.total_points, header.total_values, header.max_iterations);
 
 	// Run the K-Means algorithm on the dataset
 	kmeans.run(points);
+	cout << "TIME LOAD = " << chrono::duration_cast<chrono::microseconds>(end_load - begin_load).count() << " µs\n";
+
+	// SAMIR - phase timings as JSON for benchmark.cpp, when it asks for them
+	BenchReport report = kmeans.getBenchReport();
+	report.load = benchMicros(end_load - begin_load);
+	writeBenchReport("fast-serial", report);
 
 	// ==========================================================================
 	// Step 4: Exit Program
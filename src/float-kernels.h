@@ -0,0 +1,265 @@
+// Single-precision (float32) kernels for Steps 2a and 2b
+//
+// SUMMARY
+// The float32 mode of parallel.cpp (--precision=float32) keeps the points and centroids as floats: half the bytes per
+// point to stream through Step 2a, and twice the points per SIMD register (16 per AVX2 step, 32 per AVX-512 step).
+// Distances are computed in float, so near-ties can resolve differently from the double kernels. The Step 2b sums are
+// kept in double, or in Kahan-compensated floats (accumulators.h), because adding hundreds of thousands of floats into
+// one float would lose several digits of the centroid. Like dimension-kernels.h, every kernel is instantiated for
+// D = 1..KMEANS_MAX_FIXED_DIMENSION, with the generic (D = 0) kernels for wider datasets.
+// Samir's code
+
+#ifndef KMEANS_FLOAT_KERNELS_H
+#define KMEANS_FLOAT_KERNELS_H
+
+#include <float.h>
+#include <stdint.h>
+#include "dimension-kernels.h"
+#include "accumulators.h"
+#include "point-matrix.h"
+
+// ============================================================================
+// Step 2a: same contract as NearestCenterKernel, on float points and centroids
+// ============================================================================
+typedef int (*NearestCenterKernelF32)(const PointMatrixF32 &points, int begin, int end,
+                                      const float *centroids, int K, int32_t *assignments);
+
+template <int D>
+inline int nearestCentersScalarF32(const PointMatrixF32 &points, int begin, int end,
+                                   const float *centroids, int K, int32_t *assignments)
+{
+    const int total_values = D > 0 ? D : points.getTotalValues();
+    int changed = 0;
+
+    for (int i = begin; i < end; i++)
+    {
+        const float *point_values = points.row(i);
+        float min_dist_sq = FLT_MAX;
+        int id_nearest_center = 0;
+
+        for (int c = 0; c < K; c++)
+        {
+            const float *central_values = centroids + (size_t)c * total_values;
+            float sum = 0.0f;
+            for (int j = 0; j < total_values; j++)
+            {
+                float diff = central_values[j] - point_values[j];
+                sum += diff * diff;
+            }
+            if (sum < min_dist_sq)
+            {
+                min_dist_sq = sum;
+                id_nearest_center = c;
+            }
+        }
+
+        if (assignments[i] != id_nearest_center)
+        {
+            assignments[i] = id_nearest_center;
+            changed++;
+        }
+    }
+    return changed;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// 16 points per step (two ymm registers of 8 floats), no FMA for the same reason as the double kernels
+template <int D>
+__attribute__((target("avx2"))) inline int nearestCentersAvx2F32(const PointMatrixF32 &points, int begin, int end,
+                                                                  const float *centroids, int K, int32_t *assignments)
+{
+    const int total_values = D > 0 ? D : points.getTotalValues();
+    const size_t stride = points.getColumnStride();
+    const float *columns = points.column(0);
+    int changed = 0;
+    int i = begin;
+
+    for (; i + 16 <= end; i += 16)
+    {
+        __m256 best_lo = _mm256_set1_ps(FLT_MAX), best_hi = _mm256_set1_ps(FLT_MAX);
+        __m256 best_id_lo = _mm256_setzero_ps(), best_id_hi = _mm256_setzero_ps();
+
+        for (int c = 0; c < K; c++)
+        {
+            const float *central_values = centroids + (size_t)c * total_values;
+            __m256 sum_lo = _mm256_setzero_ps(), sum_hi = _mm256_setzero_ps();
+
+            for (int j = 0; j < total_values; j++)
+            {
+                const float *col = columns + j * stride + i;
+                __m256 center = _mm256_set1_ps(central_values[j]);
+                __m256 dl = _mm256_sub_ps(center, _mm256_loadu_ps(col));
+                __m256 dh = _mm256_sub_ps(center, _mm256_loadu_ps(col + 8));
+                sum_lo = _mm256_add_ps(sum_lo, _mm256_mul_ps(dl, dl));
+                sum_hi = _mm256_add_ps(sum_hi, _mm256_mul_ps(dh, dh));
+            }
+
+            // Strictly-less keeps the lowest cluster ID on ties, like the scalar loop
+            __m256 closer_lo = _mm256_cmp_ps(sum_lo, best_lo, _CMP_LT_OQ);
+            __m256 closer_hi = _mm256_cmp_ps(sum_hi, best_hi, _CMP_LT_OQ);
+            __m256 id = _mm256_set1_ps((float)c);
+            best_lo = _mm256_blendv_ps(best_lo, sum_lo, closer_lo);
+            best_hi = _mm256_blendv_ps(best_hi, sum_hi, closer_hi);
+            best_id_lo = _mm256_blendv_ps(best_id_lo, id, closer_lo);
+            best_id_hi = _mm256_blendv_ps(best_id_hi, id, closer_hi);
+        }
+
+        int32_t nearest[16];
+        _mm256_storeu_si256((__m256i *)nearest, _mm256_cvtps_epi32(best_id_lo));
+        _mm256_storeu_si256((__m256i *)(nearest + 8), _mm256_cvtps_epi32(best_id_hi));
+        for (int p = 0; p < 16; p++)
+        {
+            if (assignments[i + p] != nearest[p])
+            {
+                assignments[i + p] = nearest[p];
+                changed++;
+            }
+        }
+    }
+
+    // Fewer than 16 points left in this range
+    return changed + nearestCentersScalarF32<D>(points, i, end, centroids, K, assignments);
+}
+
+// 32 points per step (two zmm registers of 16 floats)
+template <int D>
+__attribute__((target("avx512f"))) inline int nearestCentersAvx512F32(const PointMatrixF32 &points, int begin, int end,
+                                                                       const float *centroids, int K, int32_t *assignments)
+{
+    const int total_values = D > 0 ? D : points.getTotalValues();
+    const size_t stride = points.getColumnStride();
+    const float *columns = points.column(0);
+    int changed = 0;
+    int i = begin;
+
+    for (; i + 32 <= end; i += 32)
+    {
+        __m512 best_lo = _mm512_set1_ps(FLT_MAX), best_hi = _mm512_set1_ps(FLT_MAX);
+        __m512 best_id_lo = _mm512_setzero_ps(), best_id_hi = _mm512_setzero_ps();
+
+        for (int c = 0; c < K; c++)
+        {
+            const float *central_values = centroids + (size_t)c * total_values;
+            __m512 sum_lo = _mm512_setzero_ps(), sum_hi = _mm512_setzero_ps();
+
+            for (int j = 0; j < total_values; j++)
+            {
+                const float *col = columns + j * stride + i;
+                __m512 center = _mm512_set1_ps(central_values[j]);
+                __m512 dl = _mm512_sub_ps(center, _mm512_loadu_ps(col));
+                __m512 dh = _mm512_sub_ps(center, _mm512_loadu_ps(col + 16));
+                sum_lo = _mm512_add_ps(sum_lo, _mm512_mul_ps(dl, dl));
+                sum_hi = _mm512_add_ps(sum_hi, _mm512_mul_ps(dh, dh));
+            }
+
+            __mmask16 closer_lo = _mm512_cmp_ps_mask(sum_lo, best_lo, _CMP_LT_OQ);
+            __mmask16 closer_hi = _mm512_cmp_ps_mask(sum_hi, best_hi, _CMP_LT_OQ);
+            __m512 id = _mm512_set1_ps((float)c);
+            best_lo = _mm512_mask_blend_ps(closer_lo, best_lo, sum_lo);
+            best_hi = _mm512_mask_blend_ps(closer_hi, best_hi, sum_hi);
+            best_id_lo = _mm512_mask_blend_ps(closer_lo, best_id_lo, id);
+            best_id_hi = _mm512_mask_blend_ps(closer_hi, best_id_hi, id);
+        }
+
+        int32_t nearest[32];
+        _mm512_storeu_si512((void *)nearest, _mm512_cvtps_epi32(best_id_lo));
+        _mm512_storeu_si512((void *)(nearest + 16), _mm512_cvtps_epi32(best_id_hi));
+        for (int p = 0; p < 32; p++)
+        {
+            if (assignments[i + p] != nearest[p])
+            {
+                assignments[i + p] = nearest[p];
+                changed++;
+            }
+        }
+    }
+
+    // Fewer than 32 points left in this range
+    return changed + nearestCentersScalarF32<D>(points, i, end, centroids, K, assignments);
+}
+
+#endif
+
+template <int D>
+inline NearestCenterKernelF32 nearestCenterKernelF32For(SimdLevel level)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (level == SIMD_AVX512)
+        return nearestCentersAvx512F32<D>;
+    if (level == SIMD_AVX2)
+        return nearestCentersAvx2F32<D>;
+#endif
+    return nearestCentersScalarF32<D>;
+}
+
+// ============================================================================
+// Step 2b: adds every point in [begin, end) to the sums of its cluster; Sum is double or KahanFloat
+// ============================================================================
+template <typename Sum>
+struct AccumulateKernelF32
+{
+    typedef void (*Kernel)(const PointMatrixF32 &points, int begin, int end, Sum *sums, int *counts);
+};
+
+template <int D, typename Sum>
+inline void accumulateClustersF32(const PointMatrixF32 &points, int begin, int end, Sum *sums, int *counts)
+{
+    const int total_values = D > 0 ? D : points.getTotalValues();
+    const int32_t *assignments = points.getAssignments();
+
+    for (int i = begin; i < end; i++)
+    {
+        int cluster_id = assignments[i];
+        counts[cluster_id]++;
+
+        const float *point_values = points.row(i);
+        Sum *cluster_sums = sums + (size_t)cluster_id * total_values;
+        for (int j = 0; j < total_values; j++)
+            cluster_sums[j] += point_values[j];
+    }
+}
+
+// ============================================================================
+//                              Dimension Dispatcher
+// ============================================================================
+template <int D>
+struct FloatDimensionDispatch
+{
+    static NearestCenterKernelF32 nearest(SimdLevel level, int total_values)
+    {
+        if (total_values == D)
+            return nearestCenterKernelF32For<D>(level);
+        return FloatDimensionDispatch<D - 1>::nearest(level, total_values);
+    }
+
+    template <typename Sum>
+    static typename AccumulateKernelF32<Sum>::Kernel accumulate(int total_values)
+    {
+        if (total_values == D)
+            return accumulateClustersF32<D, Sum>;
+        return FloatDimensionDispatch<D - 1>::template accumulate<Sum>(total_values);
+    }
+};
+
+template <>
+struct FloatDimensionDispatch<0>
+{
+    static NearestCenterKernelF32 nearest(SimdLevel level, int) { return nearestCenterKernelF32For<0>(level); }
+
+    template <typename Sum>
+    static typename AccumulateKernelF32<Sum>::Kernel accumulate(int) { return accumulateClustersF32<0, Sum>; }
+};
+
+inline NearestCenterKernelF32 selectNearestCenterKernelF32(SimdLevel level, int total_values)
+{
+    return FloatDimensionDispatch<KMEANS_MAX_FIXED_DIMENSION>::nearest(level, total_values);
+}
+
+template <typename Sum>
+inline typename AccumulateKernelF32<Sum>::Kernel selectAccumulateKernelF32(int total_values)
+{
+    return FloatDimensionDispatch<KMEANS_MAX_FIXED_DIMENSION>::template accumulate<Sum>(total_values);
+}
+
+#endif
@@ -0,0 +1,356 @@
+// GEMM-style blocked nearest-centroid assignment for large K (Step 2a)
+//
+// SUMMARY
+// With K in the hundreds or thousands the direct kernels in distance-kernels.h spend three instructions per dimension
+// (subtract, multiply, add) on every point/centroid pair and stream the whole centroid matrix through the cache once
+// per block of points. Here the squared distance is expanded as ||x||^2 - 2 x.c + ||c||^2: ||x||^2 is the same for
+// every centroid so it drops out of the argmin, ||c||^2 is computed once per iteration, and what is left is the matrix
+// product X * C^T, which we block the way a GEMM does:
+//   - once per iteration the centroids are packed as -2c into panels of GEMM_CENTROIDS centroids, stored dimension by
+//     dimension, with ||c||^2 alongside, so each distance is one fused multiply-add per dimension on top of ||c||^2
+//   - points are walked in tiles of GEMM_POINT_TILE that stay in L1 (read from the column-major copy of the matrix),
+//     centroid panels in tiles of GEMM_CENTROID_TILE_BYTES that stay in L2
+//   - the micro-kernel holds a block of (two SIMD registers of points) x GEMM_CENTROIDS distances in registers and
+//     folds them into the running minimum of each point as soon as a panel is done, so no K-wide distance row is ever
+//     written out and the minimum only goes back to memory once per centroid tile
+// The expansion rounds differently from summing (c - x)^2, so a point sitting almost exactly between two centroids
+// can land on the other one compared to the direct kernels. That is why it is only picked automatically once
+// K * total_values is large enough for it to pay off (see chooseAssignMode()).
+// Samir's code
+
+#ifndef KMEANS_GEMM_ASSIGN_H
+#define KMEANS_GEMM_ASSIGN_H
+
+#include <math.h>
+#include "distance-kernels.h"
+#include "options.h"
+
+#define GEMM_CENTROIDS 4                // Centroids per panel (register block width)
+#define GEMM_POINT_TILE 256             // Points per L1 tile, a multiple of every kernel's point block
+#define GEMM_CENTROID_TILE_BYTES 131072 // Packed centroid bytes per L2 tile
+#define GEMM_CROSSOVER_KD 512           // ASSIGN_AUTO switches to gemm at K * total_values >= this
+
+// ============================================================================
+// A block kernel runs total_blocks blocks of consecutive points, starting at first_point, against total_panels packed
+// panels and folds the distances into best / best_id (one running minimum and its centroid ID per point of the tile).
+// ============================================================================
+typedef void (*GemmBlockKernel)(const double *columns, size_t stride, int first_point, int total_blocks,
+                                const double *panels, const double *norms, int first_centroid, int total_panels,
+                                int total_values, double *best, double *best_id);
+
+// ============================================================================
+//                              Scalar Block Kernel
+// ============================================================================
+// 4 points x 4 centroids per step
+
+inline void gemmBlocksScalar(const double *columns, size_t stride, int first_point, int total_blocks,
+                             const double *panels, const double *norms, int first_centroid, int total_panels,
+                             int total_values, double *best, double *best_id)
+{
+    const int B = 4;
+
+    for (int block = 0; block < total_blocks; block++)
+    {
+        const double *x = columns + first_point + block * B;
+        double *block_best = best + block * B;
+        double *block_id = best_id + block * B;
+
+        for (int panel = 0; panel < total_panels; panel++)
+        {
+            const double *c = panels + (size_t)panel * total_values * GEMM_CENTROIDS;
+            double dist[GEMM_CENTROIDS][B];
+            for (int n = 0; n < GEMM_CENTROIDS; n++)
+                for (int p = 0; p < B; p++)
+                    dist[n][p] = norms[panel * GEMM_CENTROIDS + n];
+
+            for (int d = 0; d < total_values; d++)
+                for (int n = 0; n < GEMM_CENTROIDS; n++)
+                    for (int p = 0; p < B; p++)
+                        dist[n][p] += c[d * GEMM_CENTROIDS + n] * x[d * stride + p];
+
+            for (int n = 0; n < GEMM_CENTROIDS; n++)
+            {
+                for (int p = 0; p < B; p++)
+                {
+                    if (dist[n][p] < block_best[p])
+                    {
+                        block_best[p] = dist[n][p];
+                        block_id[p] = first_centroid + panel * GEMM_CENTROIDS + n;
+                    }
+                }
+            }
+        }
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// ============================================================================
+//                              AVX2 Block Kernel
+// ============================================================================
+// 8 points (two ymm registers) x 4 centroids: 8 independent FMA chains, enough to keep both FMA ports busy.
+
+__attribute__((target("avx2,fma"))) inline void gemmBlocksAvx2(const double *columns, size_t stride, int first_point,
+                                                                int total_blocks, const double *panels,
+                                                                const double *norms, int first_centroid,
+                                                                int total_panels, int total_values, double *best,
+                                                                double *best_id)
+{
+    const int B = 8;
+
+    for (int block = 0; block < total_blocks; block++)
+    {
+        const double *x = columns + first_point + block * B;
+        __m256d best_lo = _mm256_load_pd(best + block * B), best_hi = _mm256_load_pd(best + block * B + 4);
+        __m256d id_lo = _mm256_load_pd(best_id + block * B), id_hi = _mm256_load_pd(best_id + block * B + 4);
+
+        for (int panel = 0; panel < total_panels; panel++)
+        {
+            const double *c = panels + (size_t)panel * total_values * GEMM_CENTROIDS;
+            const double *c_norms = norms + panel * GEMM_CENTROIDS;
+            __m256d dist_lo[GEMM_CENTROIDS], dist_hi[GEMM_CENTROIDS];
+            for (int n = 0; n < GEMM_CENTROIDS; n++)
+                dist_lo[n] = dist_hi[n] = _mm256_broadcast_sd(c_norms + n);
+
+            for (int d = 0; d < total_values; d++)
+            {
+                __m256d x_lo = _mm256_loadu_pd(x + d * stride);
+                __m256d x_hi = _mm256_loadu_pd(x + d * stride + 4);
+                for (int n = 0; n < GEMM_CENTROIDS; n++)
+                {
+                    __m256d c_value = _mm256_broadcast_sd(c + d * GEMM_CENTROIDS + n);
+                    dist_lo[n] = _mm256_fmadd_pd(c_value, x_lo, dist_lo[n]);
+                    dist_hi[n] = _mm256_fmadd_pd(c_value, x_hi, dist_hi[n]);
+                }
+            }
+
+            // Fused argmin, strictly-less keeps the lowest cluster ID on ties
+            for (int n = 0; n < GEMM_CENTROIDS; n++)
+            {
+                __m256d id = _mm256_set1_pd((double)(first_centroid + panel * GEMM_CENTROIDS + n));
+                __m256d closer_lo = _mm256_cmp_pd(dist_lo[n], best_lo, _CMP_LT_OQ);
+                __m256d closer_hi = _mm256_cmp_pd(dist_hi[n], best_hi, _CMP_LT_OQ);
+                best_lo = _mm256_blendv_pd(best_lo, dist_lo[n], closer_lo);
+                best_hi = _mm256_blendv_pd(best_hi, dist_hi[n], closer_hi);
+                id_lo = _mm256_blendv_pd(id_lo, id, closer_lo);
+                id_hi = _mm256_blendv_pd(id_hi, id, closer_hi);
+            }
+        }
+
+        _mm256_store_pd(best + block * B, best_lo);
+        _mm256_store_pd(best + block * B + 4, best_hi);
+        _mm256_store_pd(best_id + block * B, id_lo);
+        _mm256_store_pd(best_id + block * B + 4, id_hi);
+    }
+}
+
+// ============================================================================
+//                              AVX-512 Block Kernel
+// ============================================================================
+// 16 points (two zmm registers) x 4 centroids, comparisons land in mask registers.
+
+__attribute__((target("avx512f"))) inline void gemmBlocksAvx512(const double *columns, size_t stride, int first_point,
+                                                                 int total_blocks, const double *panels,
+                                                                 const double *norms, int first_centroid,
+                                                                 int total_panels, int total_values, double *best,
+                                                                 double *best_id)
+{
+    const int B = 16;
+
+    for (int block = 0; block < total_blocks; block++)
+    {
+        const double *x = columns + first_point + block * B;
+        __m512d best_lo = _mm512_load_pd(best + block * B), best_hi = _mm512_load_pd(best + block * B + 8);
+        __m512d id_lo = _mm512_load_pd(best_id + block * B), id_hi = _mm512_load_pd(best_id + block * B + 8);
+
+        for (int panel = 0; panel < total_panels; panel++)
+        {
+            const double *c = panels + (size_t)panel * total_values * GEMM_CENTROIDS;
+            const double *c_norms = norms + panel * GEMM_CENTROIDS;
+            __m512d dist_lo[GEMM_CENTROIDS], dist_hi[GEMM_CENTROIDS];
+            for (int n = 0; n < GEMM_CENTROIDS; n++)
+                dist_lo[n] = dist_hi[n] = _mm512_set1_pd(c_norms[n]);
+
+            for (int d = 0; d < total_values; d++)
+            {
+                __m512d x_lo = _mm512_loadu_pd(x + d * stride);
+                __m512d x_hi = _mm512_loadu_pd(x + d * stride + 8);
+                for (int n = 0; n < GEMM_CENTROIDS; n++)
+                {
+                    __m512d c_value = _mm512_set1_pd(c[d * GEMM_CENTROIDS + n]);
+                    dist_lo[n] = _mm512_fmadd_pd(c_value, x_lo, dist_lo[n]);
+                    dist_hi[n] = _mm512_fmadd_pd(c_value, x_hi, dist_hi[n]);
+                }
+            }
+
+            for (int n = 0; n < GEMM_CENTROIDS; n++)
+            {
+                __m512d id = _mm512_set1_pd((double)(first_centroid + panel * GEMM_CENTROIDS + n));
+                __mmask8 closer_lo = _mm512_cmp_pd_mask(dist_lo[n], best_lo, _CMP_LT_OQ);
+                __mmask8 closer_hi = _mm512_cmp_pd_mask(dist_hi[n], best_hi, _CMP_LT_OQ);
+                best_lo = _mm512_mask_blend_pd(closer_lo, best_lo, dist_lo[n]);
+                best_hi = _mm512_mask_blend_pd(closer_hi, best_hi, dist_hi[n]);
+                id_lo = _mm512_mask_blend_pd(closer_lo, id_lo, id);
+                id_hi = _mm512_mask_blend_pd(closer_hi, id_hi, id);
+            }
+        }
+
+        _mm512_store_pd(best + block * B, best_lo);
+        _mm512_store_pd(best + block * B + 8, best_hi);
+        _mm512_store_pd(best_id + block * B, id_lo);
+        _mm512_store_pd(best_id + block * B + 8, id_hi);
+    }
+}
+
+#endif
+
+// ============================================================================
+//                              GemmAssigner Class
+// ============================================================================
+// setCentroids() packs the centroids once per iteration (serially, it is O(K * total_values)); assign() is then safe to
+// call from any number of threads on disjoint point ranges. Needs the column-major copy of the point matrix.
+
+class GemmAssigner
+{
+private:
+    int K;                        // Number of clusters
+    int total_values;             // Number of features per point
+    int total_panels;             // ceil(K / GEMM_CENTROIDS)
+    int panels_per_tile;          // Panels per L2 tile
+    int block_size;               // Points per micro-kernel block (16 AVX-512, 8 AVX2, 4 scalar)
+    GemmBlockKernel blocks;       // Micro-kernel for the instruction set picked at startup
+    AlignedBuffer<double> packed; // total_panels x total_values x GEMM_CENTROIDS values of -2c, zero beyond K
+    AlignedBuffer<double> norms;  // ||c||^2 per centroid, +inf beyond K so padding never wins
+
+    // Points of a tile that do not fill a whole block; same expansion, one point at a time
+    int nearestCenter(const double *point_values) const
+    {
+        double min_dist = HUGE_VAL;
+        int id_nearest_center = 0;
+        for (int id_cluster = 0; id_cluster < K; id_cluster++)
+        {
+            const double *c = packed.data() + (size_t)(id_cluster / GEMM_CENTROIDS) * total_values * GEMM_CENTROIDS;
+            int n = id_cluster % GEMM_CENTROIDS;
+            double dist = norms[id_cluster];
+            for (int d = 0; d < total_values; d++)
+                dist += c[d * GEMM_CENTROIDS + n] * point_values[d];
+            if (dist < min_dist)
+            {
+                min_dist = dist;
+                id_nearest_center = id_cluster;
+            }
+        }
+        return id_nearest_center;
+    }
+
+public:
+    GemmAssigner() : K(0), total_values(0), total_panels(0), panels_per_tile(0), block_size(0), blocks(nullptr) {}
+
+    void init(SimdLevel level, int K, int total_values)
+    {
+        this->K = K;
+        this->total_values = total_values;
+
+        block_size = 4;
+        blocks = gemmBlocksScalar;
+#if defined(__x86_64__) || defined(__i386__)
+        if (level == SIMD_AVX512)
+        {
+            block_size = 16;
+            blocks = gemmBlocksAvx512;
+        }
+        else if (level == SIMD_AVX2)
+        {
+            block_size = 8;
+            blocks = gemmBlocksAvx2;
+        }
+#endif
+
+        total_panels = (K + GEMM_CENTROIDS - 1) / GEMM_CENTROIDS;
+        size_t panel_bytes = (size_t)total_values * GEMM_CENTROIDS * sizeof(double);
+        panels_per_tile = (int)(GEMM_CENTROID_TILE_BYTES / panel_bytes);
+        if (panels_per_tile < 1)
+            panels_per_tile = 1;
+
+        packed.resize((size_t)total_panels * total_values * GEMM_CENTROIDS);
+        norms.resize((size_t)total_panels * GEMM_CENTROIDS);
+    }
+
+    // centroids is the K x total_values row-major centroid matrix
+    void setCentroids(const double *centroids)
+    {
+        for (int id_cluster = 0; id_cluster < total_panels * GEMM_CENTROIDS; id_cluster++)
+        {
+            if (id_cluster >= K)
+            {
+                norms[id_cluster] = HUGE_VAL; // Packed values stay zero
+                continue;
+            }
+
+            double *c = packed.data() + (size_t)(id_cluster / GEMM_CENTROIDS) * total_values * GEMM_CENTROIDS;
+            int n = id_cluster % GEMM_CENTROIDS;
+            const double *central_values = centroids + (size_t)id_cluster * total_values;
+            double norm = 0.0;
+            for (int d = 0; d < total_values; d++)
+            {
+                c[d * GEMM_CENTROIDS + n] = -2.0 * central_values[d];
+                norm += central_values[d] * central_values[d];
+            }
+            norms[id_cluster] = norm;
+        }
+    }
+
+    // Same contract as a NearestCenterKernel: assigns [begin, end) and returns how many points changed cluster
+    int assign(const PointMatrix &points, int begin, int end, int32_t *assignments) const
+    {
+        alignas(64) double best[GEMM_POINT_TILE];
+        alignas(64) double best_id[GEMM_POINT_TILE];
+        const double *columns = points.column(0);
+        const size_t stride = points.getColumnStride();
+        int changed = 0;
+
+        for (int tile_begin = begin; tile_begin < end; tile_begin += GEMM_POINT_TILE)
+        {
+            int tile_size = end - tile_begin < GEMM_POINT_TILE ? end - tile_begin : GEMM_POINT_TILE;
+            int total_blocks = tile_size / block_size;
+            int blocked = total_blocks * block_size;
+            for (int p = 0; p < blocked; p++)
+            {
+                best[p] = HUGE_VAL;
+                best_id[p] = 0.0;
+            }
+
+            // L2 tiles of centroid panels, each one swept by every block of the L1 tile
+            for (int first_panel = 0; first_panel < total_panels; first_panel += panels_per_tile)
+            {
+                int tile_panels = total_panels - first_panel < panels_per_tile ? total_panels - first_panel : panels_per_tile;
+                blocks(columns, stride, tile_begin, total_blocks,
+                       packed.data() + (size_t)first_panel * total_values * GEMM_CENTROIDS,
+                       norms.data() + (size_t)first_panel * GEMM_CENTROIDS, first_panel * GEMM_CENTROIDS,
+                       tile_panels, total_values, best, best_id);
+            }
+
+            for (int p = 0; p < tile_size; p++)
+            {
+                int id_nearest_center = p < blocked ? (int)best_id[p] : nearestCenter(points.row(tile_begin + p));
+                if (assignments[tile_begin + p] != id_nearest_center)
+                {
+                    assignments[tile_begin + p] = id_nearest_center;
+                    changed++;
+                }
+            }
+        }
+        return changed;
+    }
+};
+
+// Resolves ASSIGN_AUTO: the blocked product only pays for its packing and its extra rounding once there are enough
+// centroid values per point to amortize them
+inline AssignMode chooseAssignMode(AssignMode requested, int K, int total_values)
+{
+    if (requested != ASSIGN_AUTO)
+        return requested;
+    return (long long)K * total_values >= GEMM_CROSSOVER_KD ? ASSIGN_GEMM : ASSIGN_DIRECT;
+}
+
+#endif
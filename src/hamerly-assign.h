@@ -0,0 +1,194 @@
+// Hamerly bound-based assignment (Step 2a)
+//
+// SUMMARY
+// Elkan's K lower bounds per point are too much memory for our 400k-point runs at large K. Hamerly's algorithm keeps
+// only two bounds per point: an upper bound u on the distance to its own centroid a, and one lower bound l on the
+// distance to every other centroid (i.e. to the second-closest one). A point is skipped when u < max(l, s(a)), where
+// s(a) is half the distance from a to its closest other centroid; otherwise u is tightened to the exact distance and,
+// if that is not enough either, all K distances are computed and both bounds are reset. After the centroids move,
+// u grows by how far a moved and l shrinks by the largest move of any other centroid.
+// Fewer distances are skipped than with Elkan (there is no per-centroid test), but every skipped point costs a
+// handful of loads instead of a pass over K bounds. As in elkan-assign.h, every distance that is computed uses the
+// direct kernels' arithmetic, ties go to the lower cluster ID and bounds only skip past BOUND_SLACK, so the
+// assignments are exactly the direct kernels' ones.
+// Memory: 2 doubles per point.
+// Samir's code
+
+#ifndef KMEANS_HAMERLY_ASSIGN_H
+#define KMEANS_HAMERLY_ASSIGN_H
+
+#include <math.h>
+#include <string.h>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include "distance-kernels.h"
+
+// ============================================================================
+//                              HamerlyAssigner Class
+// ============================================================================
+// Same interface as ElkanAssigner: setCentroids() once per iteration, then assign() from any number of threads on
+// disjoint point ranges.
+
+class HamerlyAssigner
+{
+private:
+    int K;                                   // Number of clusters
+    int total_values;                        // Number of features per point
+    bool bounds_ready;                       // False until the first full pass has set every bound
+    const double *centroids;                 // Current K x total_values centroid matrix (owned by KMeans)
+    int max_shift_id;                        // Centroid that moved the most since the previous iteration
+    double max_shift;                        // How far it moved
+    double second_max_shift;                 // Largest move of any other centroid
+    AlignedBuffer<double> upper;             // Per point: upper bound on the distance to its centroid
+    AlignedBuffer<double> lower;             // Per point: lower bound on the distance to any other centroid
+    AlignedBuffer<double> previous;          // Centroids of the previous iteration, for the shifts
+    AlignedBuffer<double> shifts;            // How far each centroid moved since the previous iteration
+    AlignedBuffer<double> half_min_distance; // Per centroid: half the distance to its closest other centroid
+
+    // All K distances, scanned in cluster order like nearestCenterScalar; also returns the second smallest.
+    // The distance to `known` is already in known_dist_sq and is not recomputed.
+    int nearestTwo(const double *point_values, int known, double known_dist_sq, double &min_dist_sq,
+                   double &second_dist_sq) const
+    {
+        int id_nearest_center = 0;
+        min_dist_sq = DBL_MAX;
+        second_dist_sq = HUGE_VAL;
+
+        for (int c = 0; c < K; c++)
+        {
+            double dist_sq = c == known ? known_dist_sq
+                                        : squaredDistance<0>(centroids + (size_t)c * total_values, point_values, total_values);
+            if (dist_sq < min_dist_sq)
+            {
+                second_dist_sq = min_dist_sq;
+                min_dist_sq = dist_sq;
+                id_nearest_center = c;
+            }
+            else if (dist_sq < second_dist_sq)
+                second_dist_sq = dist_sq;
+        }
+        return id_nearest_center;
+    }
+
+public:
+    HamerlyAssigner() : K(0), total_values(0), bounds_ready(false), centroids(nullptr), max_shift_id(0),
+                        max_shift(0.0), second_max_shift(0.0) {}
+
+    void init(int K, int total_points, int total_values)
+    {
+        this->K = K;
+        this->total_values = total_values;
+        bounds_ready = false;
+        centroids = nullptr;
+
+        upper.resize(total_points);
+        lower.resize(total_points);
+        previous.resize((size_t)K * total_values);
+        shifts.resize(K);
+        half_min_distance.resize(K);
+    }
+
+    // centroids is the K x total_values row-major centroid matrix; it must stay put until the next call
+    void setCentroids(const double *centroids)
+    {
+        bool first_call = this->centroids == nullptr;
+        bounds_ready = !first_call;
+        this->centroids = centroids;
+
+        tbb::parallel_for(tbb::blocked_range<int>(0, K), [&](const tbb::blocked_range<int> &range)
+                          {
+            for (int c = range.begin(); c < range.end(); c++)
+            {
+                const double *central_values = centroids + (size_t)c * total_values;
+                double *previous_values = previous.data() + (size_t)c * total_values;
+
+                shifts[c] = first_call ? 0.0 : sqrt(squaredDistance<0>(central_values, previous_values, total_values));
+                memcpy(previous_values, central_values, total_values * sizeof(double));
+
+                double min_dist_sq = HUGE_VAL;
+                for (int other = 0; other < K; other++)
+                {
+                    if (other == c)
+                        continue;
+                    double dist_sq = squaredDistance<0>(central_values, centroids + (size_t)other * total_values, total_values);
+                    if (dist_sq < min_dist_sq)
+                        min_dist_sq = dist_sq;
+                }
+                half_min_distance[c] = 0.5 * sqrt(min_dist_sq);
+            } });
+
+        // The lower bound of a point shrinks by the largest move among the centroids it is not assigned to
+        max_shift_id = 0;
+        max_shift = second_max_shift = 0.0;
+        for (int c = 0; c < K; c++)
+        {
+            if (shifts[c] > max_shift)
+            {
+                second_max_shift = max_shift;
+                max_shift = shifts[c];
+                max_shift_id = c;
+            }
+            else if (shifts[c] > second_max_shift)
+                second_max_shift = shifts[c];
+        }
+    }
+
+    // Same contract as ElkanAssigner::assign()
+    int assign(const PointMatrix &points, int begin, int end, int32_t *assignments, long long &computed)
+    {
+        int changed = 0;
+        for (int i = begin; i < end; i++)
+        {
+            const double *point_values = points.row(i);
+            int a = assignments[i];
+            double min_dist_sq, second_dist_sq;
+
+            if (bounds_ready)
+            {
+                double u = upper[i] + shifts[a];
+                double l = lower[i] - (a == max_shift_id ? second_max_shift : max_shift);
+                if (l < 0.0)
+                    l = 0.0;
+
+                double bound = l > half_min_distance[a] ? l : half_min_distance[a];
+                if (boundSkips(u, bound))
+                {
+                    upper[i] = u;
+                    lower[i] = l;
+                    continue;
+                }
+
+                // Tighten u to the exact distance before giving up on the point
+                double dist_sq_a = squaredDistance<0>(centroids + (size_t)a * total_values, point_values, total_values);
+                u = sqrt(dist_sq_a);
+                computed++;
+                if (boundSkips(u, bound))
+                {
+                    upper[i] = u;
+                    lower[i] = l;
+                    continue;
+                }
+
+                a = nearestTwo(point_values, a, dist_sq_a, min_dist_sq, second_dist_sq);
+                computed += K - 1;
+            }
+            else
+            {
+                a = nearestTwo(point_values, -1, 0.0, min_dist_sq, second_dist_sq);
+                computed += K;
+            }
+
+            upper[i] = sqrt(min_dist_sq);
+            lower[i] = sqrt(second_dist_sq);
+
+            if (assignments[i] != a)
+            {
+                assignments[i] = a;
+                changed++;
+            }
+        }
+        return changed;
+    }
+};
+
+#endif
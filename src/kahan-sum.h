@@ -0,0 +1,57 @@
+// Kahan-compensated sums
+//
+// SUMMARY
+// A running sum that carries the low-order part lost by each addition and feeds it back into the next one, so adding
+// n values loses about as much as one rounding instead of up to n. Used for the centroid sums where plain sums are not
+// good enough: KahanFloat in the float32 mode of parallel.cpp (float memory footprint, close to double accuracy), and
+// KahanDouble in its compensated reduction mode (close to the exactly rounded sum, whatever the summation order).
+// Needs IEEE arithmetic: do not build with -ffast-math, which would optimize the compensation away.
+// Samir's code
+
+#ifndef KMEANS_KAHAN_SUM_H
+#define KMEANS_KAHAN_SUM_H
+
+template <typename T>
+struct KahanSum
+{
+    T sum;
+    T compensation; // Low-order part lost by the last additions, subtracted from the next value
+
+    inline void add(T value)
+    {
+        T corrected = value - compensation;
+        T next = sum + corrected;
+        compensation = (next - sum) - corrected;
+        sum = next;
+    }
+
+    inline KahanSum &operator+=(T value)
+    {
+        add(value);
+        return *this;
+    }
+
+    inline KahanSum &operator-=(T value)
+    {
+        add(-value);
+        return *this;
+    }
+
+    // Merging two partial sums (the tree reductions)
+    inline KahanSum &operator+=(const KahanSum &other)
+    {
+        add(other.sum);
+        add(-other.compensation);
+        return *this;
+    }
+};
+
+typedef KahanSum<float> KahanFloat;
+typedef KahanSum<double> KahanDouble;
+
+inline double sumValue(double sum) { return sum; }
+
+template <typename T>
+inline double sumValue(const KahanSum<T> &sum) { return (double)sum.sum - (double)sum.compensation; }
+
+#endif
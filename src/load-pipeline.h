@@ -0,0 +1,138 @@
+// Text dataset loading overlapped with the first iteration, for parallel.cpp (--pipeline=on)
+//
+// SUMMARY
+// The normal load parses every chunk of the dataset before Step 1 can pick a seed, and iteration 1 then reads all of
+// the points back from memory. For one-shot jobs the parse is a large part of the run (about 100 ms on 7.txt on one
+// core), so LoadPipeline turns pass 2 of text-loader.h into a tbb::parallel_pipeline whose stages are:
+//   1. (serial, in order)  hand out the next chunk of the mapped file
+//   2. (parallel)          parse it straight into the point matrix
+//   3. (serial, in order)  every chunk up to this one is parsed now, so release the points completed since the last
+//                          chunk (a point can span two chunks), stopping for good at the first bad or missing value
+//   4. (parallel)          copy the released points into the column-major buffer and hand them to the caller, which
+//                          assigns them to the initial seeds and adds them to the first-iteration sums
+// The token counts (pass 1) are still taken first, in parallel: they are much cheaper than parsing, and they give the
+// global index of every chunk's first token, which is what lets Step 1 parse its K seed points on their own before
+// the pipeline starts. With max_tokens chunks in flight, a chunk is clustered while the next ones are being parsed.
+// Points the dataset is missing (the zeroed tail of 8.txt) are released after the pipeline, once they are zeroed.
+// Binary datasets have nothing to parse; they are attached as usual and isText() is false.
+// Samir's code
+
+#ifndef KMEANS_LOAD_PIPELINE_H
+#define KMEANS_LOAD_PIPELINE_H
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <tbb/parallel_pipeline.h>
+#include "parallel-text-loader.h"
+#include "trace.h"
+
+#define PIPELINE_CHUNKS_PER_THREAD 2 // Chunks in flight per arena thread: one being parsed, one being clustered
+
+// ============================================================================
+//                              LoadPipeline Class
+// ============================================================================
+class LoadPipeline
+{
+private:
+    std::shared_ptr<MappedInput> input;
+    TextDatasetParser parser;
+    bool text;      // false: a binary dataset, loaded whole by open()
+    int released;   // Points handed to the caller so far
+    int max_tokens; // Chunks in flight in the last run()
+
+public:
+    LoadPipeline() : text(false), released(0), max_tokens(0) {}
+
+    // Maps fd and reads the header. A text dataset is only counted (pass 1, in parallel) and the matrix shaped, with
+    // the values and the column-major buffer left zero for run(); a binary dataset is attached whole. Returns false
+    // when the input cannot be read or the header is malformed.
+    bool open(int fd, DatasetHeader &header, PointMatrix &points)
+    {
+        input.reset(new MappedInput());
+        if (!input->open(fd))
+            return false;
+        text = !isBinaryDataset(input->begin(), input->end());
+        if (!text)
+            return attachBinaryDataset(input, header, points);
+
+        if (!parser.readHeader(input->begin(), input->end(), header))
+            return false;
+        points.reset(header.total_points, header.total_values, header.has_name != 0);
+        points.allocateColumns();
+        TbbChunkLoop()(parser.getTotalChunks(), [&](int chunk)
+                       { parser.countChunk(chunk); });
+        parser.sumCounts();
+        return true;
+    }
+
+    inline bool isText() const { return text; }
+    inline int getTotalChunks() const { return parser.getTotalChunks(); }
+    inline int getMaxTokens() const { return max_tokens; }
+
+    // Step 1: the values of one point, parsed on their own before run(). false if the point is incomplete or not a
+    // number; it is zero in the loaded matrix then. A point after the first bad value somewhere earlier in the file is
+    // also zero once loaded, although it parses here: run() returns where the complete points end so the caller can
+    // tell.
+    bool readPoint(int point, double *values) const
+    {
+        return parser.parsePoint(point, values);
+    }
+
+    // Parses every chunk into points and calls body(first, last) for every run of points whose values and columns are
+    // final, each point exactly once, from several threads at a time. Returns the number of complete points (the
+    // rest are zero, see TextDatasetParser::finish()).
+    template <typename Body>
+    int run(PointMatrix &points, const Body &body)
+    {
+        const int total_points = points.getTotalPoints();
+        const int total_chunks = parser.getTotalChunks();
+        const int per_point = parser.getPerPoint();
+        max_tokens = std::max(1, PIPELINE_CHUNKS_PER_THREAD * tbb::this_task_arena::max_concurrency());
+        int next_chunk = 0;
+        long long good_tokens = 0; // Tokens of chunks [0, chunk) before the first bad or missing one
+        released = 0;
+
+        tbb::parallel_pipeline(
+            max_tokens,
+            tbb::make_filter<void, int>(tbb::filter_mode::serial_in_order, [&](tbb::flow_control &control) -> int
+                                        {
+                if (next_chunk == total_chunks)
+                {
+                    control.stop();
+                    return 0;
+                }
+                return next_chunk++; }) &
+                tbb::make_filter<int, int>(tbb::filter_mode::parallel, [&](int chunk) -> int
+                                           {
+                TRACE_TASK("Load parse task");
+                parser.parseChunk(chunk, points);
+                return chunk; }) &
+                tbb::make_filter<int, std::pair<int, int>>(tbb::filter_mode::serial_in_order, [&](int chunk) -> std::pair<int, int>
+                                                          {
+                // Once a value is bad or missing, nothing after it is released until finish() has zeroed it
+                if (good_tokens == parser.getFirstToken(chunk))
+                    good_tokens = std::min(parser.getFirstToken(chunk + 1), parser.getFirstBad(chunk));
+                int first = released;
+                released = std::min<long long>(total_points, good_tokens / per_point);
+                return std::make_pair(first, released); }) &
+                tbb::make_filter<std::pair<int, int>, void>(tbb::filter_mode::parallel, [&](std::pair<int, int> range)
+                                                           {
+                if (range.first < range.second)
+                {
+                    points.buildColumns(range.first, range.second);
+                    body(range.first, range.second);
+                } }));
+
+        int complete = parser.finish(points);
+        if (released < total_points)
+        {
+            points.buildColumns(released, total_points);
+            body(released, total_points);
+            released = total_points;
+        }
+        return complete;
+    }
+};
+
+#endif
@@ -0,0 +1,90 @@
+// Memory-mapped standard input for the dataset loaders
+//
+// SUMMARY
+// Both dataset formats come in on stdin. Rather than pulling the bytes through an istream, the loaders take the whole
+// input at once from here: text-loader.h parses it in chunks, binary-dataset.h points the PointMatrix straight at it.
+// Samir's code
+
+#ifndef KMEANS_MAPPED_INPUT_H
+#define KMEANS_MAPPED_INPUT_H
+
+#include <errno.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// ============================================================================
+//                              MappedInput Class
+// ============================================================================
+// The bytes of an open file descriptor from its current offset on: mmap'ed when it is a regular file (`< dataset.txt`),
+// otherwise read into a buffer (`cat dataset.txt |`). The mapping is private and writable, so a PointMatrix viewing a
+// binary dataset in place can still be written to; pages are only copied if that actually happens.
+
+class MappedInput
+{
+private:
+    void *mapping;       // Start of the mapping, nullptr when buffered
+    size_t mapping_size; // Length of the mapping
+    std::vector<char> buffer;
+    char *begin_;
+    char *end_;
+
+    MappedInput(const MappedInput &);
+    MappedInput &operator=(const MappedInput &);
+
+public:
+    MappedInput() : mapping(nullptr), mapping_size(0), begin_(nullptr), end_(nullptr) {}
+    ~MappedInput()
+    {
+        if (mapping)
+            munmap(mapping, mapping_size);
+    }
+
+    bool open(int fd)
+    {
+        struct stat info;
+        off_t offset = lseek(fd, 0, SEEK_CUR);
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && offset >= 0 && info.st_size > offset)
+        {
+            // Offset 0 keeps the mapping page-aligned; the bytes before the current offset are skipped below
+            void *address = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            if (address != MAP_FAILED)
+            {
+                madvise(address, info.st_size, MADV_WILLNEED); // The chunks are parsed all at once, not front to back
+                mapping = address;
+                mapping_size = info.st_size;
+                begin_ = (char *)address + offset;
+                end_ = (char *)address + info.st_size;
+                return true;
+            }
+        }
+
+        // Pipe, terminal or mmap failure: read everything
+        const size_t block = 1 << 20;
+        size_t used = 0;
+        for (;;)
+        {
+            buffer.resize(used + block);
+            ssize_t got = read(fd, buffer.data() + used, block);
+            if (got < 0 && errno == EINTR)
+                continue;
+            if (got < 0)
+                return false;
+            if (got == 0)
+                break;
+            used += got;
+        }
+        buffer.resize(used);
+        begin_ = buffer.data();
+        end_ = buffer.data() + used;
+        return true;
+    }
+
+    inline char *begin() const { return begin_; }
+    inline char *end() const { return end_; }
+    inline size_t size() const { return end_ - begin_; }
+};
+
+#endif
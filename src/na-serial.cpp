@@ -12,41 +12,13 @@
 #include <time.h>
 #include <algorithm>
 #include <chrono>
+// shared point storage
+#include "point-matrix.h"
+#include "text-loader.h"
+#include "bench-report.h"
 
 using namespace std;
 
-// ============================================================================
-//                              Point Class
-// ============================================================================
-// This class represents a **single data point** in the dataset.
-
-class Point
-{
-private:
-    int id_point;          // Unique identifier for the point
-    int id_cluster;        // ID of the cluster this point is assigned to
-    vector<double> values; // Stores the feature values of the point
-    int total_values;      // Number of features (dimensions) for this point
-    string name;           // Optional name of the point (default: empty)
-
-public:
-    Point(int id_point, vector<double> &values, string name = "")
-    {
-        this->id_point = id_point;
-        total_values = values.size();
-        this->values = values;
-        this->name = name;
-        id_cluster = -1; // Initially unassigned
-    }
-
-    int getID() { return id_point; }
-    void setCluster(int id_cluster) { this->id_cluster = id_cluster; }
-    int getCluster() { return id_cluster; }
-    double getValue(int index) { return values[index]; }
-    int getTotalValues() { return total_values; }
-    string getName() { return name; }
-};
-
 // ============================================================================
 //                              Cluster Class
 // ============================================================================
@@ -59,13 +31,12 @@ private:
     vector<double> central_values; // Centroid coordinates
 
 public:
-    Cluster(int id_cluster, Point point)
+    Cluster(int id_cluster, const double *point_values, int total_values)
     {
         this->id_cluster = id_cluster;
-        int total_values = point.getTotalValues();
 
         for (int i = 0; i < total_values; i++)
-            central_values.push_back(point.getValue(i));
+            central_values.push_back(point_values[i]);
     }
 
     int getID() { return id_cluster; }
@@ -90,7 +61,7 @@ private:
     // ======================================================================
     // Finds the **nearest cluster** to a given point using **Euclidean distance**.
     // ======================================================================
-    int getIDNearestCenter(Point &point)
+    int getIDNearestCenter(const double *point_values)
     {
         double min_dist = numeric_limits<double>::max();
         int id_cluster_center = 0;
@@ -100,7 +71,7 @@ private:
             double sum = 0.0;
             for (int j = 0; j < total_values; j++)
             {
-                sum += pow(clusters[i].getCentralValue(j) - point.getValue(j), 2.0);
+                sum += pow(clusters[i].getCentralValue(j) - point_values[j], 2.0);
             }
 
             double dist = sqrt(sum);
@@ -112,6 +83,7 @@ private:
         }
         return id_cluster_center;
     }
+    BenchReport bench; // Phase timings for benchmark.cpp (bench-report.h)
 
 public:
     KMeans(int K, int total_points, int total_values, int max_iterations)
@@ -122,7 +94,9 @@ public:
         this->max_iterations = max_iterations;
     }
 
-    void run(vector<Point> &points)
+    inline const BenchReport &getBenchReport() const { return bench; }
+
+    void run(PointMatrix &points)
     {
         auto begin = chrono::high_resolution_clock::now();
 
@@ -140,8 +114,8 @@ public:
                 if (find(prohibited_indexes.begin(), prohibited_indexes.end(), index_point) == prohibited_indexes.end())
                 {
                     prohibited_indexes.push_back(index_point);
-                    points[index_point].setCluster(i);
-                    clusters.push_back(Cluster(i, points[index_point]));
+                    points.setCluster(index_point, i);
+                    clusters.push_back(Cluster(i, points.row(index_point), total_values));
                     break;
                 }
             }
@@ -160,16 +134,18 @@ public:
             // Step 2a: **Assign each point to the nearest cluster**
             for (int i = 0; i < total_points; i++)
             {
-                int id_old_cluster = points[i].getCluster();
-                int id_nearest_center = getIDNearestCenter(points[i]);
+                int id_old_cluster = points.getCluster(i);
+                int id_nearest_center = getIDNearestCenter(points.row(i));
 
                 if (id_old_cluster != id_nearest_center)
                 {
-                    points[i].setCluster(id_nearest_center);
+                    points.setCluster(i, id_nearest_center);
                     done = false;
                 }
             }
 
+            auto assign_end = chrono::high_resolution_clock::now();
+
             // Step 2b: **Recalculate centroids based on new assignments**
             vector<vector<double>> new_centroids(K, vector<double>(total_values, 0.0));
             vector<int> cluster_sizes(K, 0);
@@ -177,10 +153,11 @@ public:
             // Sum all point values for each cluster
             for (int i = 0; i < total_points; i++)
             {
-                int cluster_id = points[i].getCluster();
+                int cluster_id = points.getCluster(i);
                 cluster_sizes[cluster_id]++;
+                const double *point_values = points.row(i); // SAMIR - one contiguous row per point
                 for (int j = 0; j < total_values; j++)
-                    new_centroids[cluster_id][j] += points[i].getValue(j);
+                    new_centroids[cluster_id][j] += point_values[j];
             }
 
             // Compute the new centroid values
@@ -195,6 +172,8 @@ public:
 
             auto iteration_end = chrono::high_resolution_clock::now();
             total_iteration_time += chrono::duration_cast<chrono::microseconds>(iteration_end - iteration_start).count();
+            bench.assignment += benchMicros(assign_end - iteration_start);
+            bench.update += benchMicros(iteration_end - assign_end);
 
             // Step 2c: **Check stopping condition**
             if (done || iter >= max_iterations)
@@ -206,6 +185,10 @@ public:
         }
 
         auto end = chrono::high_resolution_clock::now();
+        bench.seeding = benchMicros(end_phase1 - begin);
+        bench.phase2 = benchMicros(end - end_phase1);
+        bench.total = benchMicros(end - begin);
+        bench.iterations = iter;
 
         // Step 3: **Display results**
         for (int i = 0; i < K; i++)
@@ -213,12 +196,12 @@ public:
             cout << "Cluster " << clusters[i].getID() + 1 << endl;
             for (int j = 0; j < total_points; j++)
             {
-                if (points[j].getCluster() == i)
+                if (points.getCluster(j) == i)
                 {
-                    // cout << "Point " << points[j].getID() + 1 << ": ";
+                    // cout << "Point " << j + 1 << ": ";
                     // for (int p = 0; p < total_values; p++)
-                    //     cout << points[j].getValue(p) << " ";
-                    // string point_name = points[j].getName();
+                    //     cout << points.getValue(j, p) << " ";
+                    // string point_name = points.hasNames() ? points.getName(j) : "";
                     // if (point_name != "")
                     //     cout << "- " << point_name;
 
@@ -264,57 +247,36 @@ int main(int argc, char *argv[])
     // srand(time(NULL));
     srand(10);
 
-    int total_points, total_values, K, max_iterations, has_name;
-
     // ==========================================================================
-    // Step 1: Read Input Values
+    // Step 1: Read Input Values and Points
     // ==========================================================================
-    // Read the total number of data points, the number of features per point,
+    // The header gives the total number of data points, the number of features per point,
     // the number of clusters (K), the maximum number of iterations, and whether
-    // each point has a name.
-    cin >> total_points >> total_values >> K >> max_iterations >> has_name;
-
-    // Declare a vector to store all points in the dataset
-    vector<Point> points;
-    string point_name; // To store the optional name of the point
-
-    // ==========================================================================
-    // Step 2: Read Points from Input
-    // ==========================================================================
-    for (int i = 0; i < total_points; i++)
+    // each point has a name. SAMIR - every point is read straight into one contiguous matrix
+    auto begin_load = chrono::high_resolution_clock::now();
+    DatasetHeader header;
+    PointMatrix points;
+    if (!loadPointMatrix(STDIN_FILENO, header, points)) // SAMIR - mmap the dataset and parse it without iostreams
     {
-        vector<double> values; // Store feature values of the current point
-
-        // Read the feature values for the current point
-        for (int j = 0; j < total_values; j++)
-        {
-            double value;
-            cin >> value;
-            values.push_back(value);
-        }
-
-        // If the points have names, read and store the name
-        if (has_name)
-        {
-            cin >> point_name;
-            Point p(i, values, point_name); // Create a Point with a name
-            points.push_back(p);            // Store the point in the dataset
-        }
-        else
-        {
-            Point p(i, values);  // Create a Point without a name
-            points.push_back(p); // Store the point in the dataset
-        }
+        cerr << "Error: malformed dataset on standard input" << endl;
+        return 1;
     }
+    auto end_load = chrono::high_resolution_clock::now();
 
     // ==========================================================================
     // Step 3: Initialize K-Means Algorithm and Run Clustering
     // ==========================================================================
     // Create an instance of KMeans with the input parameters
-    KMeans kmeans(K, total_points, total_values, max_iterations);
+    KMeans kmeans(header.K, header.total_points, header.total_values, header.max_iterations);
 
     // Run the K-Means algorithm on the dataset
     kmeans.run(points);
+    cout << "TIME LOAD = " << chrono::duration_cast<chrono::microseconds>(end_load - begin_load).count() << " µs\n";
+
+    // SAMIR - phase timings as JSON for benchmark.cpp, when it asks for them
+    BenchReport report = kmeans.getBenchReport();
+    report.load = benchMicros(end_load - begin_load);
+    writeBenchReport("na-serial", report);
 
     // ==========================================================================
     // Step 4: Exit Program
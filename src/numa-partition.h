@@ -0,0 +1,307 @@
+// NUMA-aware placement of the point matrix and one TBB arena per NUMA node
+//
+// SUMMARY
+// On a dual-socket host, whichever thread first writes a page decides which node's memory it lives on. The loaders
+// fill the point matrix from wherever TBB runs their tasks (and AlignedBuffer zero-fills it from the main thread
+// first), so the points end up mostly on one node and every parallel_for of Phase 2 reads the other half across the
+// socket interconnect. With --numa (parallel.cpp), NumaPartition instead:
+//   - splits the points into one contiguous block per node, sized by the node's share of the CPUs we may use and
+//     aligned to NUMA_BLOCK_POINTS so no page of the rows, columns or assignments is shared by two nodes
+//   - gives every node its own tbb::task_arena whose threads are bound to that node's CPUs (task_scheduler_observer)
+//   - re-homes the matrix (placePoints): fresh, untouched buffers are filled block by block from each node's arena,
+//     so each block's pages are first touched, and therefore allocated, on the node that will read them
+//   - runs Step 2a and the Step 2b.2 sums of each block in its node's arena (forEachNode); each node merges its own
+//     worker slots, and only the K x total_values node totals cross the interconnect
+// Nodes come from /sys/devices/system/node, restricted to the CPUs in our affinity mask. A machine (or container)
+// without that directory, or with one node, gets a single node holding every point, which runs the same code path.
+// KMEANS_NUMA_NODES=N splits the allowed CPUs into N emulated nodes (sharing CPUs if there are fewer than N), so the
+// multi-node path can be exercised on any machine.
+// Samir's code
+
+#ifndef KMEANS_NUMA_PARTITION_H
+#define KMEANS_NUMA_PARTITION_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <ostream>
+#include <vector>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+#include <tbb/task_group.h>
+#include <tbb/task_scheduler_observer.h>
+#include "point-matrix.h"
+
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#define NUMA_BLOCK_POINTS 1024 // Node blocks start at multiples of this: 4 KB of assignments, 8 KB per column
+#define NUMA_PAGE_BYTES 4096   // Alignment of the re-homed buffers
+
+struct NumaNode
+{
+    int id;            // Node number in /sys/devices/system/node (or the emulated node's index)
+    std::vector<int> cpus;
+};
+
+// "0-3,8,10-11" -> 0 1 2 3 8 10 11
+inline std::vector<int> parseCpuList(const char *text)
+{
+    std::vector<int> cpus;
+    while (*text)
+    {
+        char *end = nullptr;
+        long first = strtol(text, &end, 10);
+        if (end == text)
+            break;
+        long last = first;
+        text = end;
+        if (*text == '-')
+        {
+            last = strtol(text + 1, &end, 10);
+            text = end;
+        }
+        for (long cpu = first; cpu <= last; cpu++)
+            cpus.push_back((int)cpu);
+        while (*text == ',' || *text == '\n' || *text == ' ')
+            text++;
+    }
+    return cpus;
+}
+
+// The nodes that have CPUs in our affinity mask, each with only those CPUs
+inline std::vector<NumaNode> detectNumaNodes()
+{
+    std::vector<NumaNode> nodes;
+    std::vector<int> allowed;
+#ifdef __linux__
+    cpu_set_t mask;
+    if (sched_getaffinity(0, sizeof(mask), &mask) == 0)
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+            if (CPU_ISSET(cpu, &mask))
+                allowed.push_back(cpu);
+
+    DIR *directory = opendir("/sys/devices/system/node");
+    if (directory)
+    {
+        struct dirent *entry;
+        while ((entry = readdir(directory)) != nullptr)
+        {
+            int id;
+            char extra;
+            if (sscanf(entry->d_name, "node%d%c", &id, &extra) != 1)
+                continue;
+            char path[128], list[4096];
+            snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", id);
+            FILE *file = fopen(path, "r");
+            if (!file)
+                continue;
+            size_t length = fread(list, 1, sizeof(list) - 1, file);
+            fclose(file);
+            list[length] = '\0';
+
+            NumaNode node;
+            node.id = id;
+            for (int cpu : parseCpuList(list))
+                if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end())
+                    node.cpus.push_back(cpu);
+            if (!node.cpus.empty())
+                nodes.push_back(node);
+        }
+        closedir(directory);
+    }
+    std::sort(nodes.begin(), nodes.end(), [](const NumaNode &a, const NumaNode &b)
+              { return a.id < b.id; });
+#endif
+
+    // No NUMA information: one node with everything we may run on
+    if (nodes.empty())
+    {
+        NumaNode node;
+        node.id = 0;
+        node.cpus = allowed;
+        nodes.push_back(node);
+    }
+
+    // Emulated nodes: the allowed CPUs dealt out in contiguous runs
+    const char *emulated = getenv("KMEANS_NUMA_NODES");
+    int count = emulated ? atoi(emulated) : 0;
+    if (count > 0)
+    {
+        for (size_t n = 1; n < nodes.size(); n++)
+            nodes[0].cpus.insert(nodes[0].cpus.end(), nodes[n].cpus.begin(), nodes[n].cpus.end());
+        std::vector<int> cpus = nodes[0].cpus;
+        nodes.assign(count, NumaNode());
+        for (int n = 0; n < count; n++)
+        {
+            nodes[n].id = n;
+            if (cpus.empty())
+                continue;
+            size_t first = cpus.size() * n / count, last = cpus.size() * (n + 1) / count;
+            if (first == last)
+                nodes[n].cpus.push_back(cpus[n % cpus.size()]);
+            else
+                nodes[n].cpus.assign(cpus.begin() + first, cpus.begin() + last);
+        }
+    }
+    return nodes;
+}
+
+// Binds every thread that enters a node's arena to that node's CPUs, and gives it back the process mask when it
+// leaves, since TBB workers move between arenas
+class NodeBindingObserver : public tbb::task_scheduler_observer
+{
+private:
+#ifdef __linux__
+    cpu_set_t node_mask;
+    cpu_set_t process_mask;
+#endif
+
+public:
+    NodeBindingObserver(tbb::task_arena &arena, const std::vector<int> &cpus) : tbb::task_scheduler_observer(arena)
+    {
+#ifdef __linux__
+        CPU_ZERO(&node_mask);
+        for (int cpu : cpus)
+            CPU_SET(cpu, &node_mask);
+        if (sched_getaffinity(0, sizeof(process_mask), &process_mask) == 0 && !cpus.empty())
+            observe(true);
+#endif
+    }
+
+    ~NodeBindingObserver() { observe(false); }
+
+    void on_scheduler_entry(bool) override
+    {
+#ifdef __linux__
+        pthread_setaffinity_np(pthread_self(), sizeof(node_mask), &node_mask);
+#endif
+    }
+
+    void on_scheduler_exit(bool) override
+    {
+#ifdef __linux__
+        pthread_setaffinity_np(pthread_self(), sizeof(process_mask), &process_mask);
+#endif
+    }
+};
+
+// ============================================================================
+//                              NumaPartition
+// ============================================================================
+class NumaPartition
+{
+private:
+    std::vector<NumaNode> nodes;
+    std::vector<int> bounds;        // Node n owns points [bounds[n], bounds[n + 1])
+    std::vector<int> concurrency;   // Threads of node n's arena
+    std::vector<std::unique_ptr<tbb::task_arena>> arenas;
+    std::vector<std::unique_ptr<NodeBindingObserver>> observers;
+
+public:
+    // threads = 0 gives every node one thread per CPU; otherwise threads are shared out by CPU count, at least one each
+    void init(int total_points, int threads)
+    {
+        nodes = detectNumaNodes();
+        const int count = (int)nodes.size();
+        size_t total_cpus = 0;
+        for (const NumaNode &node : nodes)
+            total_cpus += std::max<size_t>(1, node.cpus.size());
+
+        bounds.assign(count + 1, 0);
+        concurrency.assign(count, 1);
+        size_t cpus_before = 0;
+        for (int n = 0; n < count; n++)
+        {
+            size_t cpus = std::max<size_t>(1, nodes[n].cpus.size());
+            concurrency[n] = threads > 0 ? std::max(1, (int)((size_t)threads * (cpus_before + cpus) / total_cpus) -
+                                                           (int)((size_t)threads * cpus_before / total_cpus))
+                                         : (int)cpus;
+            cpus_before += cpus;
+            size_t end = (size_t)total_points * cpus_before / total_cpus;
+            bounds[n + 1] = n + 1 == count ? total_points
+                                           : (int)std::min<size_t>(total_points, (end + NUMA_BLOCK_POINTS / 2) / NUMA_BLOCK_POINTS * NUMA_BLOCK_POINTS);
+            bounds[n + 1] = std::max(bounds[n + 1], bounds[n]);
+        }
+
+        arenas.clear();
+        observers.clear();
+        for (int n = 0; n < count; n++)
+        {
+            arenas.emplace_back(new tbb::task_arena(concurrency[n]));
+            arenas[n]->initialize();
+            observers.emplace_back(new NodeBindingObserver(*arenas[n], nodes[n].cpus));
+        }
+    }
+
+    inline int getNodes() const { return (int)nodes.size(); }
+    inline int begin(int node) const { return bounds[node]; }
+    inline int end(int node) const { return bounds[node + 1]; }
+    inline int getConcurrency(int node) const { return concurrency[node]; }
+
+    // Runs function(n) in node n's arena for every node at once and returns when all of them are done. Inside,
+    // parallel_for and this_task_arena::current_thread_index() refer to the node's arena.
+    template <typename Function>
+    void forEachNode(const Function &function)
+    {
+        const int count = (int)nodes.size();
+        std::vector<tbb::task_group> groups(count);
+        for (int n = 0; n < count; n++)
+            arenas[n]->execute([&, n]()
+                               { groups[n].run([&, n]()
+                                               { function(n); }); });
+        for (int n = 0; n < count; n++)
+            arenas[n]->execute([&, n]()
+                               { groups[n].wait(); });
+    }
+
+    // Moves the rows, the column-major copy and the assignments of points into buffers whose pages were first
+    // touched by the node that owns each block. Needs the column-major copy (buildColumns()) to exist.
+    template <typename Scalar>
+    void placePoints(BasicPointMatrix<Scalar> &points)
+    {
+        const int total_points = points.getTotalPoints();
+        const int total_values = points.getTotalValues();
+        const size_t stride = points.getColumnStride();
+        AlignedBuffer<Scalar> rows, columns;
+        AlignedBuffer<int32_t> assignments;
+        rows.allocate((size_t)total_points * total_values, NUMA_PAGE_BYTES);
+        columns.allocate(stride * total_values, NUMA_PAGE_BYTES);
+        assignments.allocate(total_points, NUMA_PAGE_BYTES);
+
+        const int last = (int)nodes.size() - 1;
+        forEachNode([&](int n)
+                    {
+            tbb::parallel_for(tbb::blocked_range<int>(begin(n), end(n), NUMA_BLOCK_POINTS), [&](const tbb::blocked_range<int> &range)
+                              {
+                size_t first = range.begin(), count = range.size();
+                memcpy(rows.data() + first * total_values, points.row(range.begin()), count * total_values * sizeof(Scalar));
+                for (int j = 0; j < total_values; j++)
+                    memcpy(columns.data() + j * stride + first, points.column(j) + first, count * sizeof(Scalar));
+                memcpy(assignments.data() + first, points.getAssignments() + first, count * sizeof(int32_t)); });
+
+            // The column padding belongs to the last block
+            if (n == last)
+                for (int j = 0; j < total_values; j++)
+                    memset(columns.data() + j * stride + total_points, 0, (stride - total_points) * sizeof(Scalar)); });
+
+        points.adopt(std::move(rows), std::move(columns), std::move(assignments));
+    }
+
+    // "2 nodes: node 0 points [0, 204800) on 8 CPUs with 8 threads, ..."
+    void describe(std::ostream &out) const
+    {
+        out << nodes.size() << (nodes.size() == 1 ? " node" : " nodes");
+        for (size_t n = 0; n < nodes.size(); n++)
+            out << (n == 0 ? ": " : ", ") << "node " << nodes[n].id << " points [" << bounds[n] << ", " << bounds[n + 1]
+                << ") on " << nodes[n].cpus.size() << " CPUs with " << concurrency[n] << " threads";
+    }
+};
+
+#endif
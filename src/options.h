@@ -0,0 +1,662 @@
+// Command-line options for the K-Means implementations
+//
+// SUMMARY
+// The dataset (and its header: total_points total_values K max_iterations has_name) still comes in on stdin, exactly
+// like before, so `cat dataset | ./parallel` keeps working with no arguments. Everything else about how a run is
+// carried out is chosen here, with the defaults reproducing the original behaviour.
+// Samir's code
+
+#ifndef KMEANS_OPTIONS_H
+#define KMEANS_OPTIONS_H
+
+#include <errno.h>
+#include <float.h>
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+
+// ============================================================================
+// How Step 2a assigns points to centroids
+// ============================================================================
+enum AssignMode
+{
+    ASSIGN_AUTO,    // Pick between direct and gemm from K * total_values
+    ASSIGN_DIRECT,  // One SIMD distance kernel call per block of points (distance-kernels.h)
+    ASSIGN_GEMM,    // ||x||^2 - 2 x.c + ||c||^2 blocked like a matrix multiply (gemm-assign.h)
+    ASSIGN_ELKAN,   // Triangle-inequality bounds skip most distances in late iterations (elkan-assign.h)
+    ASSIGN_HAMERLY, // Elkan with 2 bounds per point instead of K + 1 (hamerly-assign.h)
+    ASSIGN_YINYANG  // Elkan with one bound per group of ~10 centroids (yinyang-assign.h)
+};
+
+inline const char *assignModeName(AssignMode mode)
+{
+    switch (mode)
+    {
+    case ASSIGN_DIRECT:
+        return "direct";
+    case ASSIGN_GEMM:
+        return "gemm";
+    case ASSIGN_ELKAN:
+        return "elkan";
+    case ASSIGN_HAMERLY:
+        return "hamerly";
+    case ASSIGN_YINYANG:
+        return "yinyang";
+    default:
+        return "auto";
+    }
+}
+
+// ============================================================================
+// How Step 1 picks the initial centroids
+// ============================================================================
+enum InitMode
+{
+    INIT_RANDOM,          // K distinct points from rand(), the original behaviour
+    INIT_KMEANS_PLUSPLUS, // k-means++: one D(x)^2-weighted pick per centroid (seeding.h)
+    INIT_KMEANS_PARALLEL  // k-means||: oversampling rounds, then weighted reclustering (seeding.h)
+};
+
+inline const char *initModeName(InitMode mode)
+{
+    switch (mode)
+    {
+    case INIT_KMEANS_PLUSPLUS:
+        return "kmeans++";
+    case INIT_KMEANS_PARALLEL:
+        return "kmeans||";
+    default:
+        return "random";
+    }
+}
+
+// ============================================================================
+// How Step 2b recomputes the centroid sums
+// ============================================================================
+enum UpdateMode
+{
+    UPDATE_FULL, // Sum every point each iteration, the original behaviour
+    UPDATE_DELTA // Keep running sums and only move the points Step 2a reassigned (delta-update.h)
+};
+
+inline const char *updateModeName(UpdateMode mode)
+{
+    return mode == UPDATE_DELTA ? "delta" : "full";
+}
+
+// ============================================================================
+// Scalar type of Step 2, and of the centroid sums in float32 mode
+// ============================================================================
+enum ScalarPrecision
+{
+    PRECISION_DOUBLE, // Points, centroids and sums in double, the original behaviour
+    PRECISION_FLOAT32 // Points and centroids in float (float-kernels.h)
+};
+
+enum SumMode
+{
+    SUM_DOUBLE, // Float32 mode: sums in double
+    SUM_KAHAN   // Float32 mode: sums in Kahan-compensated float (accumulators.h)
+};
+
+inline const char *precisionName(ScalarPrecision precision)
+{
+    return precision == PRECISION_FLOAT32 ? "float32" : "float64";
+}
+
+inline const char *sumModeName(SumMode mode)
+{
+    return mode == SUM_KAHAN ? "Kahan float" : "double";
+}
+
+// ============================================================================
+// How Step 2b merges the partial centroid sums
+// ============================================================================
+enum ReductionMode
+{
+    REDUCTION_WORKERS,       // One slot per worker, whatever points it got: fastest, last digits depend on the schedule
+    REDUCTION_DETERMINISTIC, // One slot per fixed chunk of points and a fixed tree: same sums for any thread count
+    REDUCTION_COMPENSATED    // REDUCTION_DETERMINISTIC with Kahan sums, close to the exactly rounded sum
+};
+
+inline const char *reductionModeName(ReductionMode mode)
+{
+    switch (mode)
+    {
+    case REDUCTION_DETERMINISTIC:
+        return "deterministic";
+    case REDUCTION_COMPENSATED:
+        return "compensated";
+    default:
+        return "workers";
+    }
+}
+
+// ============================================================================
+// Which logical CPU each thread of the arena runs on (thread-arena.h)
+// ============================================================================
+enum PinPolicy
+{
+    PIN_NONE,    // Left to the OS scheduler
+    PIN_COMPACT, // Fill one core, then one socket, before the next: shared caches
+    PIN_SCATTER  // Spread over sockets and physical cores first: most cache and bandwidth per thread
+};
+
+inline const char *pinPolicyName(PinPolicy policy)
+{
+    switch (policy)
+    {
+    case PIN_COMPACT:
+        return "compact";
+    case PIN_SCATTER:
+        return "scatter";
+    default:
+        return "none";
+    }
+}
+
+// ============================================================================
+// Whether the points are split over NUMA nodes (numa-partition.h)
+// ============================================================================
+enum NumaMode
+{
+    NUMA_AUTO, // On when the machine has more than one node and the run supports it
+    NUMA_ON,   // Always, with a single node where there is only one (same code path, for testing)
+    NUMA_OFF
+};
+
+inline const char *numaModeName(NumaMode mode)
+{
+    switch (mode)
+    {
+    case NUMA_ON:
+        return "on";
+    case NUMA_OFF:
+        return "off";
+    default:
+        return "auto";
+    }
+}
+
+struct KMeansOptions
+{
+    AssignMode assign_mode;
+    InitMode init_mode;
+    UpdateMode update_mode;
+    ScalarPrecision precision;
+    SumMode sum_mode;
+    ReductionMode reduction_mode;
+    int batch_size;          // Mini-batch size, 0 = full Lloyd passes
+    bool final_assign;       // Mini-batch: assign every point to its final centroid at the end
+    int init_rounds;         // k-means||: oversampling rounds
+    int recompute_every;     // Delta updates: full recompute every N iterations, 0 = only in iteration 1
+    unsigned long long seed; // Seed of the counter-based generator (random.h)
+    bool perf_counters;      // Hardware counters per phase (perf-counters.h)
+    int threads;             // Arena size, 0 = TBB's default (all allowed CPUs)
+    PinPolicy pin_policy;
+    NumaMode numa_mode;
+    int stream_mb;           // Out-of-core chunk budget in MB, 0 = load the whole dataset
+    std::string labels_path; // Streaming: where the labels go, empty = a temporary file
+    bool pipeline_load;      // Parse the text dataset and run iteration 1 as one pipeline (load-pipeline.h)
+    int restarts;            // n_init: concurrent runs from different seeds, the lowest inertia is kept
+    int sweep_first;         // K sweep: first and last K, 0 = cluster with the K of the header only
+    int sweep_last;
+    double tol_inertia;      // Stop once the inertia drops by less than this fraction in an iteration, 0 = off
+    double tol_shift;        // Stop once no centroid moves more than this many RMS radii of the dataset, 0 = off
+    bool history;            // Print the inertia and centroid shift of every iteration
+
+    KMeansOptions() : assign_mode(ASSIGN_AUTO), init_mode(INIT_RANDOM), update_mode(UPDATE_FULL), precision(PRECISION_DOUBLE),
+                      sum_mode(SUM_DOUBLE), reduction_mode(REDUCTION_WORKERS), batch_size(0),
+                      final_assign(false), init_rounds(2), recompute_every(10), seed(10), perf_counters(false),
+                      threads(0), pin_policy(PIN_NONE), numa_mode(NUMA_AUTO), stream_mb(0),
+                      pipeline_load(false), restarts(1), sweep_first(0), sweep_last(0),
+                      tol_inertia(0), tol_shift(0), history(false) {}
+};
+
+// Whether the per-node Step 2 of parallel.cpp covers this run
+inline bool supportsNuma(const KMeansOptions &options)
+{
+    return (options.assign_mode == ASSIGN_AUTO || options.assign_mode == ASSIGN_DIRECT || options.assign_mode == ASSIGN_GEMM) &&
+           options.update_mode == UPDATE_FULL && options.precision == PRECISION_DOUBLE &&
+           options.reduction_mode == REDUCTION_WORKERS && options.batch_size == 0 && options.stream_mb == 0 &&
+           !options.pipeline_load && options.restarts == 1 &&
+           options.sweep_first == 0;
+}
+
+inline void printUsage(const char *program)
+{
+    std::cerr << "Usage: " << program << " [options] < dataset.txt\n"
+              << "  --assign=auto|direct|gemm|elkan|hamerly|yinyang   Step 2a engine (default auto: gemm once K * total_values is large)\n"
+              << "  --init=random|kmeans++|kmeans||   Step 1 seeding (default random)\n"
+              << "  --init-rounds=N        k-means||: oversampling rounds of 2K candidates each (default 2)\n"
+              << "  --update=full|delta    Step 2b: sum every point, or only move the reassigned points (default full)\n"
+              << "  --recompute-every=N    Delta updates: full recompute every N iterations to bound drift, 0 = never (default 10)\n"
+              << "  --precision=double|float32   Step 2 scalar type; float32 also reports its distance from a double run (default double)\n"
+              << "  --sums=double|kahan    Float32: centroid sums in double or Kahan-compensated float (default double)\n"
+              << "  --reduction=workers|deterministic|compensated   Step 2b merge: per worker, or fixed chunks and tree\n"
+              << "                         (same result for any thread count), optionally with Kahan sums (default workers)\n"
+              << "  --minibatch=N          Mini-batch K-Means with batches of N sampled points; max_iterations batches\n"
+              << "  --final-assign=on|off  Mini-batch: label every point with its final centroid (default off)\n"
+              << "  --seed=N               Seed for batch sampling and seeding (default 10)\n"
+              << "  --perf=on|off          Cycles, IPC, LLC misses and FLOP/s of Phase 1, Step 2a and Step 2b (default off)\n"
+              << "  --threads=N            Run in a TBB arena of N threads, 0 = one per allowed CPU (default 0)\n"
+              << "  --pin=none|compact|scatter   Pin each arena thread to a CPU: packed onto shared caches, or spread\n"
+              << "                         over sockets and cores first (default none)\n"
+              << "  --numa=auto|on|off     One block of points, arena and partial sum per NUMA node (default auto: on with\n"
+              << "                         more than one node)\n"
+              << "  --stream=MB            Out of core: read the dataset from disk once per iteration in chunks that fit in\n"
+              << "                         MB megabytes, instead of loading it (default 0: load it)\n"
+              << "  --labels=FILE          Streaming: keep the cluster of every point in FILE, as int32 (default: a temporary file)\n"
+              << "  --pipeline=on|off      Text datasets: cluster each chunk into iteration 1 as soon as it is parsed (default off)\n"
+              << "  --restarts=R           n_init: R concurrent runs from different seeds over the same points; the run\n"
+              << "                         with the lowest inertia is reported (default 1)\n"
+              << "  --sweep-k=A..B         Elbow sweep: one run per K from A to B instead of the header's K, each warm-started\n"
+              << "                         from K - 1 with its worst cluster split; prints inertia, iterations and time per K\n"
+              << "  --tol-inertia=X        Also stop once an iteration lowers the inertia by less than X relative (default 0: off)\n"
+              << "  --tol-shift=X          Also stop once no centroid moves more than X times the RMS distance of the points\n"
+              << "                         to their mean (default 0: off)\n"
+              << "  --history=on|off       Print the inertia and largest centroid shift of every iteration (default off)\n";
+}
+
+// Whole non-negative number that fits in an int
+inline bool parseCount(const std::string &name, const std::string &value, int &count)
+{
+    errno = 0;
+    char *end = nullptr;
+    long parsed = strtol(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0' || errno != 0 || parsed < 0 || parsed > 0x7fffffff)
+    {
+        std::cerr << "Error: " << name << " needs a non-negative whole number, got '" << value << "'\n";
+        return false;
+    }
+    count = (int)parsed;
+    return true;
+}
+
+// Finite non-negative number
+inline bool parseTolerance(const std::string &name, const std::string &value, double &tolerance)
+{
+    errno = 0;
+    char *end = nullptr;
+    double parsed = strtod(value.c_str(), &end);
+    if (value.empty() || *end != '\0' || errno != 0 || !(parsed >= 0) || parsed > DBL_MAX)
+    {
+        std::cerr << "Error: " << name << " needs a non-negative number, got '" << value << "'\n";
+        return false;
+    }
+    tolerance = parsed;
+    return true;
+}
+
+inline bool parseSwitch(const std::string &name, const std::string &value, bool &on)
+{
+    if (value == "on")
+        on = true;
+    else if (value == "off")
+        on = false;
+    else
+    {
+        std::cerr << "Error: " << name << " takes on or off, got '" << value << "'\n";
+        return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// Accepts both --name=value and --name value. Returns false (after printing why) on anything it does not understand.
+// ============================================================================
+inline bool parseOptions(int argc, char *argv[], KMeansOptions &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        std::string name = arg, value;
+        bool has_value = false;
+
+        size_t equals = arg.find('=');
+        if (equals != std::string::npos)
+        {
+            name = arg.substr(0, equals);
+            value = arg.substr(equals + 1);
+            has_value = true;
+        }
+
+        if (name == "--help" || name == "-h")
+        {
+            printUsage(argv[0]);
+            return false;
+        }
+
+        if (name != "--assign" && name != "--init" && name != "--init-rounds" && name != "--minibatch" &&
+            name != "--final-assign" && name != "--seed" && name != "--update" && name != "--recompute-every" &&
+            name != "--precision" && name != "--sums" && name != "--reduction" && name != "--perf" &&
+            name != "--threads" && name != "--pin" && name != "--numa" &&
+            name != "--stream" && name != "--labels" && name != "--pipeline" &&
+            name != "--restarts" && name != "--sweep-k" && name != "--tol-inertia" && name != "--tol-shift" &&
+            name != "--history")
+        {
+            std::cerr << "Error: unknown option " << name << "\n";
+            printUsage(argv[0]);
+            return false;
+        }
+
+        if (!has_value)
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Error: missing value for " << name << "\n";
+                printUsage(argv[0]);
+                return false;
+            }
+            value = argv[++i];
+        }
+
+        if (name == "--assign")
+        {
+            if (value == "auto")
+                options.assign_mode = ASSIGN_AUTO;
+            else if (value == "direct")
+                options.assign_mode = ASSIGN_DIRECT;
+            else if (value == "gemm")
+                options.assign_mode = ASSIGN_GEMM;
+            else if (value == "elkan")
+                options.assign_mode = ASSIGN_ELKAN;
+            else if (value == "hamerly")
+                options.assign_mode = ASSIGN_HAMERLY;
+            else if (value == "yinyang")
+                options.assign_mode = ASSIGN_YINYANG;
+            else
+            {
+                std::cerr << "Error: unknown assignment engine '" << value << "'\n";
+                return false;
+            }
+        }
+        else if (name == "--init")
+        {
+            if (value == "random")
+                options.init_mode = INIT_RANDOM;
+            else if (value == "kmeans++")
+                options.init_mode = INIT_KMEANS_PLUSPLUS;
+            else if (value == "kmeans||")
+                options.init_mode = INIT_KMEANS_PARALLEL;
+            else
+            {
+                std::cerr << "Error: unknown seeding '" << value << "'\n";
+                return false;
+            }
+        }
+        else if (name == "--init-rounds")
+        {
+            if (!parseCount(name, value, options.init_rounds))
+                return false;
+        }
+        else if (name == "--update")
+        {
+            if (value == "full")
+                options.update_mode = UPDATE_FULL;
+            else if (value == "delta")
+                options.update_mode = UPDATE_DELTA;
+            else
+            {
+                std::cerr << "Error: unknown centroid update '" << value << "'\n";
+                return false;
+            }
+        }
+        else if (name == "--recompute-every")
+        {
+            if (!parseCount(name, value, options.recompute_every))
+                return false;
+        }
+        else if (name == "--precision")
+        {
+            if (value == "double")
+                options.precision = PRECISION_DOUBLE;
+            else if (value == "float32")
+                options.precision = PRECISION_FLOAT32;
+            else
+            {
+                std::cerr << "Error: unknown precision '" << value << "'\n";
+                return false;
+            }
+        }
+        else if (name == "--sums")
+        {
+            if (value == "double")
+                options.sum_mode = SUM_DOUBLE;
+            else if (value == "kahan")
+                options.sum_mode = SUM_KAHAN;
+            else
+            {
+                std::cerr << "Error: unknown sum type '" << value << "'\n";
+                return false;
+            }
+        }
+        else if (name == "--reduction")
+        {
+            if (value == "workers")
+                options.reduction_mode = REDUCTION_WORKERS;
+            else if (value == "deterministic")
+                options.reduction_mode = REDUCTION_DETERMINISTIC;
+            else if (value == "compensated")
+                options.reduction_mode = REDUCTION_COMPENSATED;
+            else
+            {
+                std::cerr << "Error: unknown reduction '" << value << "'\n";
+                return false;
+            }
+        }
+        else if (name == "--minibatch")
+        {
+            if (!parseCount(name, value, options.batch_size))
+                return false;
+        }
+        else if (name == "--final-assign")
+        {
+            if (!parseSwitch(name, value, options.final_assign))
+                return false;
+        }
+        else if (name == "--perf")
+        {
+            if (!parseSwitch(name, value, options.perf_counters))
+                return false;
+        }
+        else if (name == "--threads")
+        {
+            if (!parseCount(name, value, options.threads))
+                return false;
+        }
+        else if (name == "--pin")
+        {
+            if (value == "none")
+                options.pin_policy = PIN_NONE;
+            else if (value == "compact")
+                options.pin_policy = PIN_COMPACT;
+            else if (value == "scatter")
+                options.pin_policy = PIN_SCATTER;
+            else
+            {
+                std::cerr << "Error: unknown pinning '" << value << "'\n";
+                return false;
+            }
+        }
+        else if (name == "--numa")
+        {
+            if (value == "auto")
+                options.numa_mode = NUMA_AUTO;
+            else if (value == "on")
+                options.numa_mode = NUMA_ON;
+            else if (value == "off")
+                options.numa_mode = NUMA_OFF;
+            else
+            {
+                std::cerr << "Error: unknown NUMA mode '" << value << "'\n";
+                return false;
+            }
+        }
+        else if (name == "--stream")
+        {
+            if (!parseCount(name, value, options.stream_mb))
+                return false;
+        }
+        else if (name == "--labels")
+            options.labels_path = value;
+        else if (name == "--pipeline")
+        {
+            if (!parseSwitch(name, value, options.pipeline_load))
+                return false;
+        }
+        else if (name == "--sweep-k")
+        {
+            size_t dots = value.find("..");
+            if (dots == std::string::npos)
+            {
+                std::cerr << "Error: --sweep-k needs a range A..B, got '" << value << "'\n";
+                return false;
+            }
+            if (!parseCount(name, value.substr(0, dots), options.sweep_first) ||
+                !parseCount(name, value.substr(dots + 2), options.sweep_last))
+                return false;
+            if (options.sweep_first < 1 || options.sweep_last < options.sweep_first)
+            {
+                std::cerr << "Error: --sweep-k needs 1 <= A <= B\n";
+                return false;
+            }
+        }
+        else if (name == "--restarts")
+        {
+            if (!parseCount(name, value, options.restarts))
+                return false;
+            if (options.restarts < 1)
+            {
+                std::cerr << "Error: --restarts needs at least one run\n";
+                return false;
+            }
+        }
+        else if (name == "--tol-inertia")
+        {
+            if (!parseTolerance(name, value, options.tol_inertia))
+                return false;
+        }
+        else if (name == "--tol-shift")
+        {
+            if (!parseTolerance(name, value, options.tol_shift))
+                return false;
+        }
+        else if (name == "--history")
+        {
+            if (!parseSwitch(name, value, options.history))
+                return false;
+        }
+        else if (name == "--seed")
+        {
+            errno = 0;
+            char *end = nullptr;
+            options.seed = strtoull(value.c_str(), &end, 10);
+            if (value.empty() || *end != '\0' || errno != 0)
+            {
+                std::cerr << "Error: --seed needs a whole number, got '" << value << "'\n";
+                return false;
+            }
+        }
+    }
+
+    // The bound modes keep per-point state between full passes, which mini-batches never make
+    if (options.batch_size > 0 && (options.assign_mode == ASSIGN_ELKAN || options.assign_mode == ASSIGN_HAMERLY ||
+                                   options.assign_mode == ASSIGN_YINYANG))
+    {
+        std::cerr << "Error: --minibatch only works with --assign=auto|direct|gemm\n";
+        return false;
+    }
+
+    // Every batch is a new sample, so there are no running sums to move points between
+    if (options.batch_size > 0 && options.update_mode == UPDATE_DELTA)
+    {
+        std::cerr << "Error: --minibatch only works with --update=full\n";
+        return false;
+    }
+
+    // The chunked reductions replace the full-pass sums of the double Lloyd loop
+    if (options.reduction_mode != REDUCTION_WORKERS &&
+        (options.batch_size > 0 || options.update_mode == UPDATE_DELTA || options.precision == PRECISION_FLOAT32))
+    {
+        std::cerr << "Error: --reduction=deterministic|compensated only works with --update=full, --precision=double and no --minibatch\n";
+        return false;
+    }
+
+    // The float32 mode is plain Lloyd with the direct kernels
+    if (options.precision == PRECISION_FLOAT32 &&
+        (options.batch_size > 0 || options.update_mode == UPDATE_DELTA ||
+         (options.assign_mode != ASSIGN_AUTO && options.assign_mode != ASSIGN_DIRECT)))
+    {
+        std::cerr << "Error: --precision=float32 only works with --assign=auto|direct, --update=full and no --minibatch\n";
+        return false;
+    }
+
+    // The node blocks are only split for the plain Lloyd loop with the direct or GEMM engine
+    if (options.numa_mode == NUMA_ON && !supportsNuma(options))
+    {
+        std::cerr << "Error: --numa=on only works with --assign=auto|direct|gemm, --update=full, --precision=double,\n"
+                  << "       --reduction=workers, no --minibatch, no --stream, no --pipeline, no --restarts\n"
+                  << "       and no --sweep-k\n";
+        return false;
+    }
+
+    // Streaming keeps no per-point state but the labels, and every pass over the file is a full Lloyd pass
+    if (options.stream_mb > 0 &&
+        ((options.assign_mode != ASSIGN_AUTO && options.assign_mode != ASSIGN_DIRECT && options.assign_mode != ASSIGN_GEMM) ||
+         options.init_mode != INIT_RANDOM || options.update_mode != UPDATE_FULL || options.precision != PRECISION_DOUBLE ||
+         options.reduction_mode != REDUCTION_WORKERS || options.batch_size > 0))
+    {
+        std::cerr << "Error: --stream only works with --assign=auto|direct|gemm, --init=random, --update=full, --precision=double,\n"
+                  << "       --reduction=workers and no --minibatch\n";
+        return false;
+    }
+    if (!options.labels_path.empty() && options.stream_mb == 0)
+    {
+        std::cerr << "Error: --labels needs --stream\n";
+        return false;
+    }
+
+    // The pipeline's last stage is Step 2a and the Step 2b.2 sums of a plain Lloyd iteration 1 from random seeds
+    if (options.pipeline_load &&
+        ((options.assign_mode != ASSIGN_AUTO && options.assign_mode != ASSIGN_DIRECT && options.assign_mode != ASSIGN_GEMM) ||
+         options.init_mode != INIT_RANDOM || options.precision != PRECISION_DOUBLE ||
+         options.reduction_mode != REDUCTION_WORKERS || options.batch_size > 0 || options.stream_mb > 0 ||
+         options.numa_mode == NUMA_ON))
+    {
+        std::cerr << "Error: --pipeline only works with --assign=auto|direct|gemm, --init=random, --precision=double,\n"
+                  << "       --reduction=workers, no --minibatch, no --stream and no --numa=on\n";
+        return false;
+    }
+
+    // Restarts and sweeps are full Lloyd runs in double over the loaded matrix; the counters would mix every run together
+    if ((options.restarts > 1 || options.sweep_first > 0) &&
+        (options.precision != PRECISION_DOUBLE || options.batch_size > 0 || options.stream_mb > 0 || options.pipeline_load ||
+         options.numa_mode == NUMA_ON || options.perf_counters))
+    {
+        std::cerr << "Error: --restarts and --sweep-k only work with --precision=double, no --minibatch, no --stream,\n"
+                  << "       no --pipeline, no --numa=on and no --perf=on\n";
+        return false;
+    }
+    // The tolerances live in the double Lloyd loop; batches and float32 have their own loops
+    if ((options.tol_inertia > 0 || options.tol_shift > 0 || options.history) &&
+        (options.batch_size > 0 || options.precision != PRECISION_DOUBLE))
+    {
+        std::cerr << "Error: --tol-inertia, --tol-shift and --history only work with --precision=double and no --minibatch\n";
+        return false;
+    }
+    // The inertia is summed by the full Step 2b pass, which delta updates replace with the moved points only
+    if ((options.tol_inertia > 0 || options.history) && options.update_mode == UPDATE_DELTA)
+    {
+        std::cerr << "Error: --tol-inertia and --history need --update=full\n";
+        return false;
+    }
+    if (options.restarts > 1 && options.sweep_first > 0)
+    {
+        std::cerr << "Error: --restarts and --sweep-k do not combine\n";
+        return false;
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,33 @@
+// TBB chunk loop for the text loader
+//
+// SUMMARY
+// text-loader.h does not depend on TBB so the serial variants can use it too; the parallel variants include this
+// header instead and parse the chunks of the dataset concurrently.
+// Samir's code
+
+#ifndef KMEANS_PARALLEL_TEXT_LOADER_H
+#define KMEANS_PARALLEL_TEXT_LOADER_H
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include "text-loader.h"
+
+// Chunks are already LOADER_CHUNK_BYTES of work each, so one chunk per task
+struct TbbChunkLoop
+{
+    template <typename Body>
+    void operator()(int total_chunks, const Body &body) const
+    {
+        tbb::parallel_for(tbb::blocked_range<int>(0, total_chunks, 1), [&](const tbb::blocked_range<int> &range)
+                          {
+            for (int chunk = range.begin(); chunk < range.end(); chunk++)
+                body(chunk); });
+    }
+};
+
+inline bool loadPointMatrixParallel(int fd, DatasetHeader &header, PointMatrix &points)
+{
+    return loadPointMatrix(fd, header, points, TbbChunkLoop());
+}
+
+#endif
@@ -3,7 +3,7 @@
 
 // SUMMARY
 // This version of the K-Means clustering algorithm **fully parallelizes both cluster assignment and centroid recomputation using Intel TBB.  Combines Steps 2a and 2b
-// It leverages thread-local storage (TLS) with `tbb::enumerable_thread_specific` to efficiently aggregate cluster updates across threads, minimizing synchronization overhead.
+// It aggregates cluster updates in per-worker, cache-line padded accumulators (accumulators.h) that are allocated once per run and merged with a tree reduction, minimizing synchronization overhead.
 // Samir's code
 
 #include <iostream>
@@ -13,68 +13,39 @@
 #include <time.h>
 #include <algorithm>
 #include <chrono>
+#include <memory>
 #include <unordered_set>
 // parallel
 #include <tbb/parallel_for.h>
 #include <atomic>
 #include <tbb/blocked_range.h>
-#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_reduce.h>
 #include <tbb/concurrent_unordered_set.h>
+// shared point storage and SIMD kernels
+#include "point-matrix.h"
+#include "parallel-text-loader.h"
+#include "dimension-kernels.h"
+#include "accumulators.h"
+#include "delta-update.h"
+#include "float-kernels.h"
+#include "gemm-assign.h"
+#include "elkan-assign.h"
+#include "hamerly-assign.h"
+#include "yinyang-assign.h"
+#include "options.h"
+#include "random.h"
+#include "seeding.h"
+#include "bench-report.h"
+#include "trace.h"
+#include "perf-counters.h"
+#include "convergence.h"
+#include "thread-arena.h"
+#include "numa-partition.h"
+#include "stream-dataset.h"
+#include "load-pipeline.h"
 
 using namespace std;
 
-// ============================================================================
-//                              Point Class
-// ============================================================================
-// This class represents a **single data point** in the dataset.
-
-class Point
-{
-private:
-    int id_point;          // Unique identifier for the point
-    int id_cluster;        // ID of the cluster this point is assigned to
-    vector<double> values; // Stores the feature values of the point
-    int total_values;      // Number of features (dimensions) for this point
-    string name;           // Optional name of the point (default: empty)
-
-public:
-    Point(int id_point, vector<double> &values, string name = "")
-    {
-        this->id_point = id_point;    // Assigns the point ID
-        total_values = values.size(); // Stores the total number of features
-        // this->values.reserve(total_values); // DOESN'T WORK - dynamic resizing
-
-        // SAMIR - Loop unrolling
-        int i = 0;
-        for (; i + 3 < total_values; i += 4) // Copy 4 values per loop
-        {
-            this->values.push_back(values[i]);
-            this->values.push_back(values[i + 1]);
-            this->values.push_back(values[i + 2]);
-            this->values.push_back(values[i + 3]);
-        }
-
-        // Handle remaining values
-        for (; i < total_values; i++)
-            this->values.push_back(values[i]);
-
-        this->name = name; // Assigns the name (if provided)
-        id_cluster = -1;   // Initially, the point is not assigned to any cluster (-1)
-    }
-
-    // ============================================================================
-    // Getter Methods: Retrieve information about the point.
-    // ============================================================================
-
-    // SAMIR - inline small functions
-    inline int getID() const { return id_point; }
-    inline int getCluster() const { return id_cluster; }
-    inline void setCluster(int id_cluster) { this->id_cluster = id_cluster; }
-    inline double getValue(int index) const { return values[index]; }
-    inline int getTotalValues() const { return total_values; }
-    inline string getName() const { return name; }
-};
-
 // ============================================================================
 //                              Cluster Class
 // ============================================================================
@@ -84,30 +55,28 @@ class Cluster
 {
 private:
     int id_cluster;
-    vector<double> central_values; // Centroid coordinates
+    double *central_values; // SAMIR - Row of the KMeans centroid matrix, so the kernels see all K centroids contiguously
 
 public:
-    Cluster(int id_cluster, Point point)
+    Cluster(int id_cluster, double *central_values, const double *point_values, int total_values)
     {
         this->id_cluster = id_cluster;
-
-        int total_values = point.getTotalValues();
-        central_values.reserve(total_values); // SAMIR - reserve space for feature values
+        this->central_values = central_values;
 
         int i = 0;
         // SAMIR - Unroll by copying 4 feature values at a time
         for (; i + 3 < total_values; i += 4)
         {
-            central_values.push_back(point.getValue(i));
-            central_values.push_back(point.getValue(i + 1));
-            central_values.push_back(point.getValue(i + 2));
-            central_values.push_back(point.getValue(i + 3));
+            central_values[i] = point_values[i];
+            central_values[i + 1] = point_values[i + 1];
+            central_values[i + 2] = point_values[i + 2];
+            central_values[i + 3] = point_values[i + 3];
         }
 
         // Copy remaining feature values
         for (; i < total_values; i++)
         {
-            central_values.push_back(point.getValue(i));
+            central_values[i] = point_values[i];
         }
     }
 
@@ -116,212 +85,609 @@ public:
     inline int getID() const { return id_cluster; }
 };
 
+// Step 1 (random): K distinct point indexes from rand(), in cluster order
+vector<int> drawRandomSeeds(int K, int total_points)
+{
+    vector<int> seeds;
+    unordered_set<int> chosen_indexes; // SAMIR - unordered_set for O(1) lookups
+
+    while (chosen_indexes.size() < K)
+    {
+        int index_point = rand() % total_points;
+
+        if (chosen_indexes.insert(index_point).second) // SAMIR - O(1) lookup and insert
+            seeds.push_back(index_point);
+    }
+    //^^^ Don't want to parallelize this because Time Phase 1 is very small regardless of dataset and it can mess with rand(). Gets too confusing
+    return seeds;
+}
+
 // ============================================================================
 //                              KMeans Class
 // ============================================================================
 // Implements the K-Means algorithm.
 
+#define REDUCTION_CHUNK_POINTS 8192 // Smallest chunk of the deterministic reductions
+#define REDUCTION_MAX_CHUNKS 256    // Larger datasets get larger chunks, so the chunk sums stay a few MB even for large K
+
 class KMeans
 {
 private:
-    int K;                    // Number of clusters
-    int total_values;         // Number of features per point
-    int total_points;         // Total number of points
-    int max_iterations;       // Maximum iterations allowed
-    vector<Cluster> clusters; // Stores only cluster centroids
-
-    // ======================================================================
-    // Finds the **nearest cluster** to a given point using **Euclidean distance**.
-    // ======================================================================
-    int getIDNearestCenter(Point &point)
+    int K;                                // Number of clusters
+    int total_values;                     // Number of features per point
+    int total_points;                     // Total number of points
+    int max_iterations;                   // Maximum iterations allowed
+    vector<Cluster> clusters;             // Stores only cluster centroids
+    AlignedBuffer<double> centroids;      // K x total_values centroid values, viewed by the clusters
+    SimdLevel simd_level;                 // Instruction set picked at startup
+    NearestCenterKernel nearest_centers;  // Step 2a kernel for that instruction set and dimension count
+    AccumulateKernel accumulate_clusters; // Step 2b.2 kernel for that dimension count
+    AccumulateErrorKernel accumulate_errors; // The same, also summing the inertia (--tol-inertia, --history)
+    ClusterAccumulators accumulators;     // Step 2b per-worker sums and counts, allocated once per run
+    UpdateMode update_mode;               // Step 2b: full sums or delta updates from the moved points
+    int recompute_every;                  // Delta updates: full recompute every N iterations
+    DeltaUpdater delta;                   // Running sums and per-worker move lists for UPDATE_DELTA
+    ScalarPrecision precision;            // Step 2 in double, or in float32 on points32
+    SumMode sum_mode;                     // Float32 mode: double or Kahan float sums
+    PointMatrixF32 points32;              // Float copy of the points for PRECISION_FLOAT32
+    ReductionMode reduction_mode;         // Step 2b merge: per-worker slots, or fixed chunks (plain or compensated)
+    int chunk_points;                     // Deterministic reductions: points per chunk, from total_points only
+    ClusterAccumulators chunk_sums;       // REDUCTION_DETERMINISTIC: one slot per chunk
+    BasicClusterAccumulators<KahanDouble> compensated_sums; // REDUCTION_COMPENSATED: one slot per chunk
+    CompensatedAccumulateKernel accumulate_compensated;     // Step 2b.2 kernel for REDUCTION_COMPENSATED
+    CompensatedAccumulateErrorKernel accumulate_compensated_errors; // The same, also summing the inertia
+    AlignedBuffer<double> compensated_totals;               // REDUCTION_COMPENSATED: the merged sums, rounded to double
+    long long iteration_time;             // Sum of the Lloyd iteration bodies, "TIME ITERATIONS"
+    PerfCounters *perf;                   // Hardware counters per phase with --perf=on, nullptr otherwise
+    NumaPartition *numa;                  // One block of points and arena per NUMA node with --numa, nullptr otherwise
+    vector<ClusterAccumulators> node_sums; // NUMA: per-worker slots of each node's arena
+    ClusterAccumulators node_totals;      // NUMA: one slot per node, merged across the nodes
+    BenchReport bench;                    // Phase timings for benchmark.cpp; bench.update is also "TIME STEP 2B"
+    AssignMode assign_mode;               // Step 2a engine: direct SIMD kernel, blocked GEMM or one of the bound modes
+    GemmAssigner gemm;                    // Packed centroids for ASSIGN_GEMM
+    ElkanAssigner elkan;                  // K + 1 bounds per point for ASSIGN_ELKAN
+    HamerlyAssigner hamerly;              // 2 bounds per point for ASSIGN_HAMERLY
+    YinyangAssigner yinyang;              // 1 + K / 10 bounds per point for ASSIGN_YINYANG
+    vector<long long> skipped_distances;  // Distance computations the bounds saved, per iteration
+    int batch_size;                       // Mini-batch size, 0 = full Lloyd passes
+    bool final_assign;                    // Mini-batch: label every point at the end
+    InitMode init_mode;                   // Step 1: random, k-means++ or k-means||
+    int init_rounds;                      // k-means||: oversampling rounds
+    unsigned long long seed;              // Seed for batch sampling and seeding
+    bool first_pass_loaded;               // --pipeline: Step 2a and 2b.1-2b.2 of iteration 1 ran while loading
+    bool first_pass_moved;                // --pipeline: whether that Step 2a moved any point
+    bool first_centroids_known;           // Iteration 1 of runLloyd() has finished, at first_centroids
+    chrono::high_resolution_clock::time_point first_centroids;
+    bool silent;                          // --restarts / --sweep-k: runLloyd() keeps its "Break in iteration" line to itself
+    int run_iterations;                   // runSilent(): iterations of this run
+    double run_inertia;                   // runSilent(): sum of squared distances at the end of this run
+    chrono::high_resolution_clock::time_point run_begin, run_end_phase1, run_end;
+    ConvergenceMonitor convergence;       // Per-iteration inertia and centroid shift, for the tolerances and --history
+
+    // Step 2a for the bound modes: same blocked_range split as the direct kernels, plus a count of the distances
+    // actually computed so we can report how many the bounds skipped
+    template <typename BoundAssigner>
+    void assignWithBounds(BoundAssigner &assigner, PointMatrix &points, std::atomic<bool> &done)
     {
-        // Attempted to parallelize this function but even on big datasets such as 8.txt we get no speedup
-        double min_dist_sq = numeric_limits<double>::max(); // Store squared distance
-        int id_cluster_center = 0;
-
-        for (int i = 0; i < K; i++)
-        {
-            double sum = 0.0;
-            int j = 0;
-
-            // SAMIR - Process 4 values at a time (Loop Unrolling by 4)
-            for (; j + 3 < total_values; j += 4)
-            {
-                double diff0 = clusters[i].getCentralValue(j) - point.getValue(j);
-                double diff1 = clusters[i].getCentralValue(j + 1) - point.getValue(j + 1);
-                double diff2 = clusters[i].getCentralValue(j + 2) - point.getValue(j + 2);
-                double diff3 = clusters[i].getCentralValue(j + 3) - point.getValue(j + 3);
-
-                // SAMIR - Replace pow(x, 2.0) with Direct Multiplication
-                sum += (diff1 * diff1) + (diff2 * diff2) + (diff3 * diff3) + (diff0 * diff0);
-            }
-
-            // Process remaining elements (if any)
-            for (; j < total_values; j++)
+        assigner.setCentroids(centroids.data()); // SAMIR - centroid shifts (and inter-centroid distances) once per iteration
+        std::atomic<long long> computed(0);
+        tbb::parallel_for(
+            tbb::blocked_range<int>(0, total_points),
+            [&](const tbb::blocked_range<int> &range)
             {
-                double diff = clusters[i].getCentralValue(j) - point.getValue(j);
-                sum += diff * diff;
-            }
-
-            // SAMIR - No sqrt() needed - compare squared distances
-            if (sum < min_dist_sq)
-            {
-                min_dist_sq = sum;
-                id_cluster_center = i;
-            }
-        }
-        return id_cluster_center;
+                TRACE_TASK("Step 2a task");
+                long long range_computed = 0;
+                int32_t *assignments = points.getAssignments();
+                int moved = delta.assignRecording(accumulators.localSlot(), assignments, range.begin(), range.end(), [&]
+                                                  { return assigner.assign(points, range.begin(), range.end(), assignments, range_computed); });
+                if (moved != 0)
+                    done.store(false, std::memory_order_relaxed); // Mark a change
+                computed.fetch_add(range_computed, std::memory_order_relaxed);
+                TRACE_COUNT(TRACE_POINTS_MOVED, moved);
+                TRACE_COUNT(TRACE_DISTANCES, range_computed);
+                TRACE_COUNT(TRACE_BYTES, (long long)range.size() * (total_values * sizeof(double) + sizeof(int32_t)));
+            });
+        skipped_distances.push_back((long long)total_points * K - computed.load());
     }
 
 public:
-    KMeans(int K, int total_points, int total_values, int max_iterations)
+    KMeans(int K, int total_points, int total_values, int max_iterations, const KMeansOptions &options)
     {
         this->K = K;
         this->total_points = total_points;
         this->total_values = total_values;
         this->max_iterations = max_iterations;
+
+        // SAMIR - pick the widest SIMD kernel this CPU supports once, instead of compiling with -march=native
+        simd_level = detectSimdLevel();
+        nearest_centers = selectNearestCenterKernel(simd_level, total_values); // SAMIR - unrolled for this dataset's dimension count
+        accumulate_clusters = selectAccumulateKernel(total_values);
+        accumulate_errors = selectAccumulateErrorKernel(total_values);
+        accumulators.init(K, total_values);
+        centroids.resize((size_t)K * total_values);
+
+        // SAMIR - for large K * total_values, treat Step 2a as a blocked matrix product instead (double only; the
+        // float32 mode and its float64 baseline both use the direct kernels)
+        assign_mode = options.precision == PRECISION_FLOAT32 ? ASSIGN_DIRECT : chooseAssignMode(options.assign_mode, K, total_values);
+        if (assign_mode == ASSIGN_GEMM)
+            gemm.init(simd_level, K, total_values);
+        else if (assign_mode == ASSIGN_ELKAN)
+            elkan.init(K, total_points, total_values);
+        else if (assign_mode == ASSIGN_HAMERLY)
+            hamerly.init(K, total_points, total_values);
+        else if (assign_mode == ASSIGN_YINYANG)
+            yinyang.init(K, total_points, total_values);
+
+        batch_size = options.batch_size;
+        final_assign = options.final_assign;
+        init_mode = options.init_mode;
+        init_rounds = options.init_rounds;
+        seed = options.seed;
+        update_mode = options.update_mode;
+        recompute_every = options.recompute_every;
+        if (update_mode == UPDATE_DELTA)
+            delta.init(K, total_values, accumulators.getSlots());
+        precision = options.precision;
+        sum_mode = options.sum_mode;
+
+        // SAMIR - deterministic reductions: the chunk size depends on total_points only, never on the thread count
+        reduction_mode = options.reduction_mode;
+        iteration_time = 0;
+        perf = nullptr;
+        numa = nullptr;
+        first_pass_loaded = first_pass_moved = first_centroids_known = false;
+        silent = false;
+        run_iterations = 0;
+        run_inertia = 0;
+        convergence.init(K, total_values, options.tol_inertia, options.tol_shift, options.history);
+        chunk_points = max(REDUCTION_CHUNK_POINTS, (total_points + REDUCTION_MAX_CHUNKS - 1) / REDUCTION_MAX_CHUNKS);
+        int chunks = max(1, (total_points + chunk_points - 1) / chunk_points);
+        if (reduction_mode == REDUCTION_DETERMINISTIC)
+            chunk_sums.init(K, total_values, chunks);
+        else if (reduction_mode == REDUCTION_COMPENSATED)
+        {
+            compensated_sums.init(K, total_values, chunks);
+            compensated_totals.resize((size_t)K * total_values);
+            accumulate_compensated = selectCompensatedAccumulateKernel(total_values);
+            accumulate_compensated_errors = selectCompensatedAccumulateErrorKernel(total_values);
+        }
     }
 
-    void run(vector<Point> &points)
+    // Trace counters of one Step 2a range of the direct and GEMM engines, which compute every distance
+    inline void traceAssignment(size_t points_in_range, int moved)
     {
-        auto begin = chrono::high_resolution_clock::now();
-
-        if (K > total_points)
-            return;
-
-        unordered_set<int> chosen_indexes; // SAMIR - unordered_set for O(1) lookups
-
-        clusters.reserve(K); // SAMIR - reserve memory for K clusters to avoid dynamic resizing
+#ifdef KMEANS_TRACE
+        TRACE_COUNT(TRACE_POINTS_MOVED, moved);
+        TRACE_COUNT(TRACE_DISTANCES, (long long)points_in_range * K);
+        TRACE_COUNT(TRACE_BYTES, (long long)points_in_range * (total_values * sizeof(double) + sizeof(int32_t)));
+#else
+        (void)points_in_range;
+        (void)moved;
+#endif
+    }
 
-        // Step 1: **Select K unique initial centroids randomly**
-        while (chosen_indexes.size() < K)
+    // Step 2a on points [first, last) of any point matrix (the dataset or a mini-batch): nearest centroid of every point
+    // with the direct or GEMM engine, in the calling arena. The GEMM centroids must already be packed. Returns whether
+    // any point changed cluster.
+    bool assignRange(PointMatrix &matrix, int first, int last)
+    {
+        std::atomic<bool> changed(false);
+        if (assign_mode == ASSIGN_GEMM)
         {
-            int index_point = rand() % total_points;
-
-            if (chosen_indexes.insert(index_point).second) // SAMIR - O(1) lookup and insert
-            {
-                points[index_point].setCluster(chosen_indexes.size() - 1);             // Assign cluster
-                clusters.emplace_back(chosen_indexes.size() - 1, points[index_point]); // SAMIR - emplace back
-            }
+            tbb::parallel_for(
+                tbb::blocked_range<int>(first, last, GEMM_POINT_TILE),
+                [&](const tbb::blocked_range<int> &range)
+                {
+                    TRACE_TASK("Step 2a task");
+                    int32_t *assignments = matrix.getAssignments();
+                    int moved = delta.assignRecording(accumulators.localSlot(), assignments, range.begin(), range.end(), [&]
+                                                      { return gemm.assign(matrix, range.begin(), range.end(), assignments); });
+                    if (moved != 0)
+                        changed.store(true, std::memory_order_relaxed);
+                    traceAssignment(range.size(), moved);
+                });
         }
-
-        //^^^ Don't want to parallelize this because Time Phase 1 is very small regardless of dataset and it can mess with rand(). Gets too confusing
-        auto end_phase1 = chrono::high_resolution_clock::now();
-        int iter = 1;
-        long long total_iteration_time = 0;
-
-        // Step 2: **Iterate until convergence or max_iterations reached**
-        while (true)
+        else
         {
-            auto iteration_start = chrono::high_resolution_clock::now();
-            // Use an atomic variable for convergence detection
-            std::atomic<bool> done(true);
-            // Step 2a: **Assign each point to the nearest cluster**, SAMIR, parallelization
             tbb::parallel_for(
-                tbb::blocked_range<int>(0, total_points),
+                tbb::blocked_range<int>(first, last),
                 [&](const tbb::blocked_range<int> &range)
                 {
-                    for (int i = range.begin(); i < range.end(); ++i)
-                    {
-                        int id_old_cluster = points[i].getCluster();
-                        int id_nearest_center = getIDNearestCenter(points[i]);
-
-                        if (id_old_cluster != id_nearest_center)
-                        {
-                            points[i].setCluster(id_nearest_center);
-                            done.store(false, std::memory_order_relaxed); // Mark a change
-                        }
-                    }
+                    TRACE_TASK("Step 2a task");
+                    // SAMIR - the SIMD kernel compares the whole block of points against one centroid at a time
+                    int32_t *assignments = matrix.getAssignments();
+                    int moved = delta.assignRecording(accumulators.localSlot(), assignments, range.begin(), range.end(), [&]
+                                                      { return nearest_centers(matrix, range.begin(), range.end(), centroids.data(), K, assignments); });
+                    if (moved != 0)
+                        changed.store(true, std::memory_order_relaxed);
+                    traceAssignment(range.size(), moved);
                 });
-            // Step 2b: **Recalculate centroids based on new assignments**, SAMIR, parallelization
-            // DID NOT Preallocate memory for all threads before computation to remove unnecessary dynamic allocation as there's not any consistent speedup from this
+        }
+        return changed;
+    }
 
-            // Global accumulators for new centroids and cluster sizes
-            vector<vector<double>> new_centroids(K, vector<double>(total_values, 0.0));
-            vector<int> cluster_sizes(K, 0);
+    // Step 2a over all points of matrix
+    bool assignNearest(PointMatrix &matrix)
+    {
+        if (assign_mode == ASSIGN_GEMM)
+            gemm.setCentroids(centroids.data()); // SAMIR - pack the centroids and their norms once per iteration
+        return assignRange(matrix, 0, matrix.getTotalPoints());
+    }
 
-            // Step 2b.1: Thread-local storage for safe accumulation without race conditions
-            tbb::enumerable_thread_specific<vector<vector<double>>> local_sums;
-            tbb::enumerable_thread_specific<vector<int>> local_counts;
+    // Step 2a with --numa: every node assigns its own block of points in its own arena
+    bool assignNearestNuma(PointMatrix &points)
+    {
+        if (assign_mode == ASSIGN_GEMM)
+            gemm.setCentroids(centroids.data());
+        std::atomic<bool> changed(false);
+        numa->forEachNode([&](int node)
+                          {
+            if (assignRange(points, numa->begin(node), numa->end(node)))
+                changed.store(true, std::memory_order_relaxed); });
+        return changed;
+    }
 
-            // Step 2b.2: Parallel Accumulation of Centroids using Thread-Local Storage
-            tbb::parallel_for(tbb::blocked_range<size_t>(0, points.size()), [&](const tbb::blocked_range<size_t> &r)
+    // Step 2b.1-2b.3 with --numa: each node sums its block into its own worker slots and merges them, so the points
+    // are only read on their own node; then the node totals (one K x total_values block per node) are merged
+    void sumNuma(const PointMatrix &points)
+    {
+        numa->forEachNode([&](int node)
+                          {
+            ClusterAccumulators &sums = node_sums[node];
+            sums.zero();
+            tbb::parallel_for(tbb::blocked_range<int>(numa->begin(node), numa->end(node)), [&](const tbb::blocked_range<int> &r)
                               {
-			// Each thread gets a local copy of centroid accumulators and cluster sizes
-			auto &local_centroids = local_sums.local();
-			auto &local_cluster_sizes = local_counts.local();
-
-			// Allocate memory for local storage only when needed
-			if (local_centroids.empty()) {
-				local_centroids.resize(K, vector<double>(total_values, 0.0));
-				local_cluster_sizes.resize(K, 0);
-			}
-
-			// Iterate over a subset of points assigned to this thread
-			for (size_t i = r.begin(); i < r.end(); ++i)
-			{
-				int cluster_id = points[i].getCluster(); // Get assigned cluster
-				local_cluster_sizes[cluster_id]++;       // Count points in each cluster
-
-				int j = 0;
-				// Use **loop unrolling** for better cache utilization
-				for (; j + 3 < total_values; j += 4)
-				{
-					local_centroids[cluster_id][j] += points[i].getValue(j);
-					local_centroids[cluster_id][j + 1] += points[i].getValue(j + 1);
-					local_centroids[cluster_id][j + 2] += points[i].getValue(j + 2);
-					local_centroids[cluster_id][j + 3] += points[i].getValue(j + 3);
-				}
+                TRACE_TASK("Step 2b.2 task");
+                if (convergence.measuresInertia())
+                    accumulate_errors(points, r.begin(), r.end(), centroids.data(), sums.localSums(), sums.localCounts(), sums.localError());
+                else
+                    accumulate_clusters(points, r.begin(), r.end(), sums.localSums(), sums.localCounts());
+                TRACE_COUNT(TRACE_BYTES, (long long)r.size() * (total_values * sizeof(double) + sizeof(int32_t))); });
+            sums.reduce();
+            memcpy(node_totals.sumsOf(node), sums.totalSums(), (size_t)K * total_values * sizeof(double));
+            memcpy(node_totals.countsOf(node), sums.totalCounts(), (size_t)K * sizeof(int));
+            *node_totals.errorOf(node) = sums.totalError(); });
+        node_totals.reduce();
+    }
 
-				// Handle remaining feature values
-				for (; j < total_values; j++)
-				{
-					local_centroids[cluster_id][j] += points[i].getValue(j);
-				}
-			} });
+    // ========================================================================
+    // Step 2 (mini-batch mode): each iteration samples batch_size points, assigns them to their nearest centroid and
+    // moves every centroid towards the mean of its batch points. Each centroid has its own learning rate,
+    // (its points in this batch) / (all points it has been given so far), so it settles as it sees more data.
+    // Runs max_iterations batches, or stops early once a batch leaves every centroid where it was.
+    // ========================================================================
+    int runMiniBatch(PointMatrix &points)
+    {
+        PointMatrix batch(batch_size, total_values);
+        CounterRng rng(seed, STREAM_MINIBATCH); // SAMIR - batch b of iteration t is the same for any thread count
+        vector<long long> points_seen(K, 0);
+        int iter = 1;
 
-            // Step 2b.3: Merge Thread-Local Results into Global Accumulators
+        while (true)
+        {
+            auto iteration_start = chrono::high_resolution_clock::now();
+            perfStart();
+            // Step 2a: sample the batch (with replacement) and assign it
+            tbb::parallel_for(tbb::blocked_range<int>(0, batch_size), [&](const tbb::blocked_range<int> &range)
+                              {
+                for (int b = range.begin(); b < range.end(); b++)
+                {
+                    int index_point = rng.index((uint64_t)(iter - 1) * batch_size + b, total_points);
+                    memcpy(batch.row(b), points.row(index_point), total_values * sizeof(double));
+                } });
+            batch.buildColumns();
+            assignNearest(batch);
+            auto assign_end = chrono::high_resolution_clock::now();
+            perfStop(PERF_STEP2A);
+
+            // Step 2b.1-2b.3: per-worker sums and counts of the batch points of each centroid, merged into slot 0
+            accumulators.zero();
+            tbb::parallel_for(tbb::blocked_range<int>(0, batch_size), [&](const tbb::blocked_range<int> &r)
+                              { accumulate_clusters(batch, r.begin(), r.end(), accumulators.localSums(), accumulators.localCounts()); });
+            accumulators.reduce();
+
+            // Step 2b.4: step each centroid towards its batch mean
+            std::atomic<bool> done(true);
             tbb::parallel_for(0, K, [&](int i)
                               {
-			for (const auto &local_centroids : local_sums)
-			{
-				for (int j = 0; j < total_values; j++)
-				{
-					new_centroids[i][j] += local_centroids[i][j];
-				}
-			}
+                const double *batch_sums = accumulators.totalSums() + (size_t)i * total_values;
+                int batch_count = accumulators.totalCounts()[i];
+                if (batch_count == 0)
+                    return;
+
+                points_seen[i] += batch_count;
+                double learning_rate = (double)batch_count / points_seen[i];
+                for (int j = 0; j < total_values; j++)
+                {
+                    double value = clusters[i].getCentralValue(j);
+                    double moved = value + learning_rate * (batch_sums[j] / batch_count - value);
+                    if (moved != value)
+                        done.store(false, std::memory_order_relaxed);
+                    clusters[i].setCentralValue(j, moved);
+                } });
+            auto iteration_end = chrono::high_resolution_clock::now();
+            perfStop(PERF_STEP2B);
+            bench.assignment += benchMicros(assign_end - iteration_start);
+            bench.update += benchMicros(iteration_end - assign_end);
 
-			for (const auto &local_cluster_sizes : local_counts)
-			{
-				cluster_sizes[i] += local_cluster_sizes[i];
-			} });
+            // Step 2c: **Check stopping condition**
+            if (done || iter >= max_iterations)
+            {
+                cout << "Break in iteration " << iter << "\n\n";
+                break;
+            }
+            iter++;
+        }
 
-            // Step 2b.4: Compute the New Centroid Positions (Parallelized)
-            tbb::parallel_for(0, K, [&](int i)
-                              {
+        // Optional full pass so every point gets the label of its final centroid
+        if (final_assign)
+            assignNearest(points);
+        return iter;
+    }
+
+    // Step 2b.1-2b.3 of the deterministic reductions: chunk c (points [c * chunk_points, (c + 1) * chunk_points)) is
+    // summed in index order into slot c by whichever worker picks it up, then the slots are merged by the pairwise tree.
+    // Both only depend on total_points, so the sums (and the inertia, summed by accumulate_error when measured) are the
+    // same for any thread count and schedule.
+    template <typename Sum, typename Kernel, typename ErrorKernel>
+    void sumChunks(BasicClusterAccumulators<Sum> &chunk_accumulators, const PointMatrix &points, Kernel accumulate,
+                   ErrorKernel accumulate_error)
+    {
+        tbb::parallel_for(0, chunk_accumulators.getSlots(), [&](int chunk)
+                          {
+            TRACE_TASK("Step 2b.2 task");
+            int begin = chunk * chunk_points;
+            int end = min(begin + chunk_points, total_points);
+            chunk_accumulators.zeroSlot(chunk);
+            if (convergence.measuresInertia())
+                accumulate_error(points, begin, end, centroids.data(), chunk_accumulators.sumsOf(chunk),
+                                 chunk_accumulators.countsOf(chunk), chunk_accumulators.errorOf(chunk));
+            else
+                accumulate(points, begin, end, chunk_accumulators.sumsOf(chunk), chunk_accumulators.countsOf(chunk));
+            TRACE_COUNT(TRACE_BYTES, (long long)(end - begin) * (total_values * sizeof(double) + sizeof(int32_t))); });
+        chunk_accumulators.reduce();
+    }
+
+    // Step 2b.4: Compute the New Centroid Positions (Parallelized) from the merged sums and counts. Clusters without
+    // points keep their centroid.
+    void divideCentroids(const double *new_centroids, const int *cluster_sizes)
+    {
+        tbb::parallel_for(0, K, [&](int i)
+                          {
 			if (cluster_sizes[i] > 0)
 			{
 				double inv_cluster_size = 1.0 / cluster_sizes[i]; // Precompute division
+				const double *cluster_sums = &new_centroids[(size_t)i * total_values];
 
 				int j = 0;
 				// Loop unrolling for performance optimization
 				for (; j + 3 < total_values; j += 4)
 				{
-					clusters[i].setCentralValue(j, new_centroids[i][j] * inv_cluster_size);
-					clusters[i].setCentralValue(j + 1, new_centroids[i][j + 1] * inv_cluster_size);
-					clusters[i].setCentralValue(j + 2, new_centroids[i][j + 2] * inv_cluster_size);
-					clusters[i].setCentralValue(j + 3, new_centroids[i][j + 3] * inv_cluster_size);
+					clusters[i].setCentralValue(j, cluster_sums[j] * inv_cluster_size);
+					clusters[i].setCentralValue(j + 1, cluster_sums[j + 1] * inv_cluster_size);
+					clusters[i].setCentralValue(j + 2, cluster_sums[j + 2] * inv_cluster_size);
+					clusters[i].setCentralValue(j + 3, cluster_sums[j + 3] * inv_cluster_size);
 				}
 
 				// Handle remaining feature values
 				for (; j < total_values; j++)
 				{
-					clusters[i].setCentralValue(j, new_centroids[i][j] * inv_cluster_size);
+					clusters[i].setCentralValue(j, cluster_sums[j] * inv_cluster_size);
 				}
 			} });
+    }
+
+    // Step 2b.2 on points [first, last): Parallel Accumulation of Centroids into the calling worker's slot
+    void accumulateRange(const PointMatrix &points, int first, int last)
+    {
+        tbb::parallel_for(tbb::blocked_range<int>(first, last), [&](const tbb::blocked_range<int> &r)
+                          {
+            TRACE_TASK("Step 2b.2 task");
+            // Iterate over a subset of points assigned to this thread, SAMIR - unrolled for this dataset's dimension count
+            if (convergence.measuresInertia())
+                accumulate_errors(points, r.begin(), r.end(), centroids.data(), accumulators.localSums(), accumulators.localCounts(), accumulators.localError());
+            else
+                accumulate_clusters(points, r.begin(), r.end(), accumulators.localSums(), accumulators.localCounts());
+            TRACE_COUNT(TRACE_BYTES, (long long)r.size() * (total_values * sizeof(double) + sizeof(int32_t))); });
+    }
+
+    // ========================================================================
+    // Step 2: **Iterate until convergence or max_iterations reached**. Returns the number of iterations; report = false
+    // for the float64 baseline of the float32 mode, which must not print its own "Break in iteration" line.
+    // ========================================================================
+    int runLloyd(PointMatrix &points, bool report)
+    {
+        int iter = 1;
+        long long total_iteration_time = 0;
+        // SAMIR - the dataset's scatter once, the scale of --tol-shift
+        if (convergence.isEnabled())
+        {
+            if (convergence.needsScatter())
+                convergence.setScatter(measureScatter(points, 0, total_points));
+            convergence.start(centroids.data());
+        }
+        while (true)
+        {
+            auto iteration_start = chrono::high_resolution_clock::now();
+            if (report)
+                perfStart();
+            TRACE_BEGIN(iteration);
+            // Use an atomic variable for convergence detection
+            std::atomic<bool> done(true);
+            // SAMIR - delta updates: sum everything in iteration 1 and every recompute_every iterations to bound the
+            // drift of the running sums, otherwise only the points Step 2a moves
+            bool full_pass = update_mode == UPDATE_FULL || iter == 1 ||
+                             (recompute_every > 0 && (iter - 1) % recompute_every == 0);
+            delta.startIteration(!full_pass);
+            // SAMIR - --pipeline: Step 2a and the Step 2b.2 sums of iteration 1 already ran while the dataset was parsed
+            bool presummed = iter == 1 && first_pass_loaded;
+            first_pass_loaded = false;
+            // Step 2a: **Assign each point to the nearest cluster**, SAMIR, parallelization
+            TRACE_BEGIN(step2a);
+            if (presummed)
+            {
+                if (first_pass_moved)
+                    done = false;
+            }
+            else if (assign_mode == ASSIGN_ELKAN)
+                assignWithBounds(elkan, points, done);
+            else if (assign_mode == ASSIGN_HAMERLY)
+                assignWithBounds(hamerly, points, done);
+            else if (assign_mode == ASSIGN_YINYANG)
+                assignWithBounds(yinyang, points, done);
+            else if (numa ? assignNearestNuma(points) : assignNearest(points))
+                done = false; // Mark a change
+            TRACE_END(step2a, "Step 2a");
+            // Step 2b: **Recalculate centroids based on new assignments**, SAMIR, parallelization
+            auto step2b_start = chrono::high_resolution_clock::now();
+            if (report)
+                perfStop(PERF_STEP2A);
+            TRACE_BEGIN(step2b_sums);
+            const double *new_centroids;
+            const int *cluster_sizes;
+            double inertia = 0; // Of Step 2a's assignment, summed by the Step 2b.2 kernels when measured
+            if (full_pass && reduction_mode == REDUCTION_DETERMINISTIC)
+            {
+                // Step 2b.1-2b.3 (deterministic): one slot per fixed chunk of points, fixed tree over the chunks
+                sumChunks(chunk_sums, points, accumulate_clusters, accumulate_errors);
+                new_centroids = chunk_sums.totalSums();
+                cluster_sizes = chunk_sums.totalCounts();
+                inertia = chunk_sums.totalError();
+            }
+            else if (full_pass && reduction_mode == REDUCTION_COMPENSATED)
+            {
+                // Step 2b.1-2b.3 (compensated): the same chunks and tree with Kahan sums, rounded once at the end
+                sumChunks(compensated_sums, points, accumulate_compensated, accumulate_compensated_errors);
+                const KahanDouble *sums = compensated_sums.totalSums();
+                for (size_t v = 0; v < compensated_totals.size(); v++)
+                    compensated_totals[v] = sumValue(sums[v]);
+                new_centroids = compensated_totals.data();
+                cluster_sizes = compensated_sums.totalCounts();
+                inertia = compensated_sums.totalError();
+            }
+            else if (full_pass && numa)
+            {
+                // Step 2b.1-2b.3 (NUMA): per-node slots and tree, then a tree over the node totals
+                sumNuma(points);
+                new_centroids = node_totals.totalSums();
+                cluster_sizes = node_totals.totalCounts();
+                inertia = node_totals.totalError();
+            }
+            else if (full_pass)
+            {
+                if (!presummed)
+                {
+                    // Step 2b.1: Per-worker accumulators, allocated once per run and cleared in parallel, SAMIR - padded
+                    // to cache lines so two workers never write the same line
+                    accumulators.zero();
+
+                    // Step 2b.2: Parallel Accumulation of Centroids into the calling worker's slot
+                    TRACE_BEGIN(step2b2);
+                    accumulateRange(points, 0, total_points);
+                    TRACE_END(step2b2, "Step 2b.2");
+                }
+
+                // Step 2b.3: Merge the slots with a tree reduction
+                TRACE_BEGIN(step2b3);
+                accumulators.reduce();
+                TRACE_END(step2b3, "Step 2b.3");
+                new_centroids = accumulators.totalSums();
+                cluster_sizes = accumulators.totalCounts();
+                inertia = accumulators.totalError();
+                if (update_mode == UPDATE_DELTA)
+                    delta.resetSums(new_centroids, cluster_sizes);
+            }
+            else
+            {
+                // Step 2b.1-2b.3 (delta): move the reassigned points between the running sums
+                delta.applyMoves(points, accumulators);
+                new_centroids = delta.totalSums();
+                cluster_sizes = delta.totalCounts();
+            }
+
+            TRACE_END(step2b_sums, "Step 2b.1-2b.3");
+
+            // Step 2b.4: Compute the New Centroid Positions (Parallelized)
+            TRACE_BEGIN(step2b4);
+            divideCentroids(new_centroids, cluster_sizes);
+            // SAMIR - inertia (summed by Step 2b.2) and largest centroid shift of this iteration: no pass over the points
+            bool converged = convergence.isEnabled() && convergence.record(iter, centroids.data(), inertia);
+
+            TRACE_END(step2b4, "Step 2b.4");
 
             auto iteration_end = chrono::high_resolution_clock::now();
+            if (report && iter == 1)
+            {
+                first_centroids = iteration_end;
+                first_centroids_known = true;
+            }
+            if (report)
+                perfStop(PERF_STEP2B);
+            TRACE_END(iteration, "iteration");
+            TRACE_ITERATION();
             total_iteration_time += chrono::duration_cast<chrono::microseconds>(iteration_end - iteration_start).count();
+            if (report)
+            {
+                bench.assignment += benchMicros(step2b_start - iteration_start);
+                bench.update += benchMicros(iteration_end - step2b_start);
+            }
+
+            // Step 2c: **Check stopping condition**, or a tolerance of --tol-inertia / --tol-shift met
+            if (done || converged || iter >= max_iterations)
+            {
+                if (report && !silent)
+                    cout << "Break in iteration " << iter << "\n\n";
+                break;
+            }
+            iter++;
+        }
+        if (report)
+            iteration_time = total_iteration_time;
+        return iter;
+    }
+
+    // ========================================================================
+    // Step 2 (float32 mode): Lloyd iterations on points32 with float distances and Sum (double or KahanFloat) sums.
+    // The final centroids and assignments are copied back into the double centroids and points for Step 3.
+    // ========================================================================
+    template <typename Sum>
+    int runLloydF32(PointMatrix &points)
+    {
+        NearestCenterKernelF32 nearest_centers32 = selectNearestCenterKernelF32(simd_level, total_values);
+        typename AccumulateKernelF32<Sum>::Kernel accumulate_clusters32 = selectAccumulateKernelF32<Sum>(total_values);
+        BasicClusterAccumulators<Sum> accumulators32;
+        accumulators32.init(K, total_values);
+
+        AlignedBuffer<float> centroids32((size_t)K * total_values);
+        for (size_t v = 0; v < centroids32.size(); v++)
+            centroids32[v] = (float)centroids[v];
+
+        int iter = 1;
+        while (true)
+        {
+            auto iteration_start = chrono::high_resolution_clock::now();
+            perfStart();
+            std::atomic<bool> done(true);
+            // Step 2a: float kernel, twice the points per register of the double one
+            tbb::parallel_for(
+                tbb::blocked_range<int>(0, total_points),
+                [&](const tbb::blocked_range<int> &range)
+                {
+                    if (nearest_centers32(points32, range.begin(), range.end(), centroids32.data(), K, points32.getAssignments()) != 0)
+                        done.store(false, std::memory_order_relaxed); // Mark a change
+                });
+            auto assign_end = chrono::high_resolution_clock::now();
+            perfStop(PERF_STEP2A);
+
+            // Step 2b: per-worker sums, tree-reduced and divided straight into the float centroids
+            accumulators32.zero();
+            tbb::parallel_for(tbb::blocked_range<int>(0, total_points), [&](const tbb::blocked_range<int> &r)
+                              { accumulate_clusters32(points32, r.begin(), r.end(), accumulators32.localSums(), accumulators32.localCounts()); });
+            accumulators32.reduceToMeans(centroids32.data());
+            auto iteration_end = chrono::high_resolution_clock::now();
+            perfStop(PERF_STEP2B);
+            bench.assignment += benchMicros(assign_end - iteration_start);
+            bench.update += benchMicros(iteration_end - assign_end);
 
             // Step 2c: **Check stopping condition**
             if (done || iter >= max_iterations)
@@ -332,20 +698,87 @@ public:
             iter++;
         }
 
-        auto end = chrono::high_resolution_clock::now();
+        for (size_t v = 0; v < centroids32.size(); v++)
+            centroids[v] = centroids32[v];
+        memcpy(points.getAssignments(), points32.getAssignments(), total_points * sizeof(int32_t));
+        return iter;
+    }
 
-        // Step 3: **Display results**
+    // Float32 mode: reruns Step 2 in double from the same starting centroids and reports how far the float32 result is
+    // from it. Runs after the timers stop; the float32 centroids and assignments are put back afterwards.
+    void compareWithDouble(PointMatrix &points, const vector<double> &initial_centroids, const vector<int32_t> &initial_assignments)
+    {
+        vector<double> float_centroids(centroids.data(), centroids.data() + (size_t)K * total_values);
+        vector<int32_t> float_assignments(points.getAssignments(), points.getAssignments() + total_points);
+
+        memcpy(centroids.data(), initial_centroids.data(), initial_centroids.size() * sizeof(double));
+        memcpy(points.getAssignments(), initial_assignments.data(), total_points * sizeof(int32_t));
+        int double_iter = runLloyd(points, false);
+
+        double max_difference = 0.0, max_relative = 0.0;
+        for (size_t v = 0; v < float_centroids.size(); v++)
+        {
+            double difference = fabs(float_centroids[v] - centroids[v]);
+            max_difference = max(max_difference, difference);
+            if (centroids[v] != 0.0)
+                max_relative = max(max_relative, difference / fabs(centroids[v]));
+        }
+        long long reassigned = 0;
+        for (int i = 0; i < total_points; i++)
+            if (float_assignments[i] != points.getCluster(i))
+                reassigned++;
+
+        cout << "FLOAT32 VS FLOAT64 = max centroid difference " << max_difference << " (relative " << max_relative << "), "
+             << reassigned << " of " << total_points << " points assigned differently, float64 took " << double_iter << " iterations\n";
+
+        memcpy(centroids.data(), float_centroids.data(), float_centroids.size() * sizeof(double));
+        memcpy(points.getAssignments(), float_assignments.data(), total_points * sizeof(int32_t));
+    }
+
+    inline const BenchReport &getBenchReport() const { return bench; }
+
+    // When iteration 1 of the Lloyd loop had its centroids, i.e. the first moment the dataset was summarized at all
+    inline bool hasFirstCentroids() const { return first_centroids_known; }
+    inline chrono::high_resolution_clock::time_point getFirstCentroidsTime() const { return first_centroids; }
+
+    // Counters opened by main() before any worker thread existed
+    inline void attachPerfCounters(PerfCounters *counters) { perf = counters; }
+
+    // Node blocks and arenas for --numa; each node's accumulator slots are allocated (first touched) on that node
+    void attachNuma(NumaPartition *partition)
+    {
+        numa = partition;
+        node_sums.resize(numa->getNodes());
+        numa->forEachNode([&](int node)
+                          { node_sums[node].init(K, total_values, numa->getConcurrency(node)); });
+        node_totals.init(K, total_values, numa->getNodes());
+    }
+    inline void perfStart()
+    {
+        if (perf)
+            perf->start();
+    }
+    inline void perfStop(PerfPhase phase)
+    {
+        if (perf)
+            perf->stop(phase);
+    }
+
+    // Step 3 of run() and runStreaming(): centroids, timings and statistics. points is nullptr when they were streamed.
+    void report(const PointMatrix *points, chrono::high_resolution_clock::time_point begin,
+                chrono::high_resolution_clock::time_point end_phase1, chrono::high_resolution_clock::time_point end, int iter)
+    {
         for (int i = 0; i < K; i++)
         {
             cout << "Cluster " << clusters[i].getID() + 1 << endl;
-            for (int j = 0; j < total_points; j++)
+            for (int j = 0; points && j < total_points; j++)
             {
-                if (points[j].getCluster() == i)
+                if (points->getCluster(j) == i)
                 {
-                    // cout << "Point " << points[j].getID() + 1 << ": ";
+                    // cout << "Point " << j + 1 << ": ";
                     // for (int p = 0; p < total_values; p++)
-                    //     cout << points[j].getValue(p) << " ";
-                    // string point_name = points[j].getName();
+                    //     cout << points.getValue(j, p) << " ";
+                    // string point_name = points.hasNames() ? points.getName(j) : "";
                     // if (point_name != "")
                     //     cout << "- " << point_name;
 
@@ -362,6 +795,50 @@ public:
         cout << "TOTAL EXECUTION TIME = " << chrono::duration_cast<chrono::microseconds>(end - begin).count() << " µs\n";
         cout << "TIME PHASE 1 = " << chrono::duration_cast<chrono::microseconds>(end_phase1 - begin).count() << " µs\n";
         cout << "TIME PHASE 2 = " << chrono::duration_cast<chrono::microseconds>(end - end_phase1).count() << " µs\n";
+        cout << "SIMD KERNEL = " << simdLevelName(simd_level) << (isFixedDimension(total_values) ? " (dimension-specialized)" : " (generic)") << "\n";
+        cout << "ASSIGNMENT ENGINE = " << assignModeName(assign_mode) << "\n";
+        cout << "PRECISION = " << precisionName(precision);
+        if (precision == PRECISION_FLOAT32)
+            cout << ", " << sumModeName(sum_mode) << " sums";
+        cout << "\n";
+        cout << "REDUCTION = " << reductionModeName(reduction_mode);
+        if (reduction_mode != REDUCTION_WORKERS)
+            cout << ", " << chunk_points << " points per chunk";
+        cout << "\n";
+        if (batch_size == 0 && precision == PRECISION_DOUBLE)
+        {
+            cout << "TIME ITERATIONS = " << iteration_time << " µs\n";
+            cout << "TIME STEP 2B = " << (long long)bench.update << " µs\n";
+        }
+        cout << "CENTROID UPDATE = " << updateModeName(update_mode);
+        if (update_mode == UPDATE_DELTA && batch_size == 0)
+        {
+            if (recompute_every > 0)
+                cout << ", full recompute every " << recompute_every << " iterations";
+            else
+                cout << ", full sums in iteration 1 only";
+            cout << ", " << delta.movesApplied() << " moved points applied";
+        }
+        cout << "\n";
+        cout << "INITIALIZATION = " << initModeName(init_mode);
+        if (init_mode == INIT_KMEANS_PARALLEL)
+            cout << ", " << init_rounds << " rounds";
+        cout << "\n";
+        if (batch_size > 0)
+            cout << "MINI-BATCH = " << batch_size << " points per batch, " << (long long)batch_size * iter << " sampled, final assignment "
+                 << (final_assign ? "on" : "off") << "\n";
+        convergence.report(cout);
+        if (!skipped_distances.empty())
+        {
+            long long total_skipped = 0;
+            for (size_t i = 0; i < skipped_distances.size(); i++)
+            {
+                cout << "SKIPPED DISTANCE COMPUTATIONS, ITERATION " << i + 1 << " = " << skipped_distances[i] << " of "
+                     << (long long)total_points * K << "\n";
+                total_skipped += skipped_distances[i];
+            }
+            cout << "SKIPPED DISTANCE COMPUTATIONS, TOTAL = " << 100.0 * total_skipped / ((double)total_points * K * skipped_distances.size()) << " %\n";
+        }
 
         // Calculate and display the **average time per iteration**
         if (iter > 1) // Only compute if we have at least 1 iteration
@@ -372,81 +849,704 @@ public:
             // Compute Phase 2 execution time in microseconds
             long long phase2_execution_time = chrono::duration_cast<chrono::microseconds>(end - end_phase1).count();
 
+            // Points that went through Step 2a: all of them per iteration, or one batch per iteration (plus the final labelling pass)
+            long long points_processed = (long long)total_points * iter;
+            if (batch_size > 0)
+                points_processed = (long long)batch_size * iter + (final_assign ? total_points : 0);
+
             // Compute throughput (points processed per second) for Phase 2
-            double throughput_phase2 = (double)(total_points * iter) / (phase2_execution_time / 1e6); // Convert µs to seconds
+            double throughput_phase2 = (double)points_processed / (phase2_execution_time / 1e6); // Convert µs to seconds
 
             // Compute latency (time taken per point in µs) for Phase 2
-            double latency_phase2 = (double)phase2_execution_time / (total_points * iter);
+            double latency_phase2 = (double)phase2_execution_time / points_processed;
 
             // Print results for Phase 2
             cout << "PHASE 2 THROUGHPUT = " << throughput_phase2 << " points per second\n";
             cout << "PHASE 2 LATENCY = " << latency_phase2 << " µs per point\n";
         }
+
+        // Hardware counters per phase; the peak assumes two FMA pipes per core (2 x 2 flops per double lane per cycle)
+        if (perf)
+            perf->report(cout, simd_level == SIMD_AVX512 ? 32 : simd_level == SIMD_AVX2 ? 16 : 4);
     }
-};
 
-int main(int argc, char *argv[])
-{
-    // Seed the random number generator (for selecting initial centroids randomly)
-    // srand(time(NULL));
-    srand(10);
+    // Step 1 (k-means++ / k-means||)
+    vector<int> chooseSpreadSeeds(const PointMatrix &points)
+    {
+        // SAMIR - k-means++ / k-means|| seeds: far apart from the start, so Phase 2 needs fewer iterations.
+        // Parallel over fixed chunks with the counter-based generator, so the seeds do not depend on the thread count
+        return init_mode == INIT_KMEANS_PLUSPLUS ? seedKMeansPlusPlus(points, K, seed)
+                                                 : seedKMeansParallel(points, K, seed, init_rounds, SEEDING_OVERSAMPLING);
+    }
 
-    int total_points, total_values, K, max_iterations, has_name;
+    // Step 1: seed point id_cluster becomes the initial centroid of cluster id_cluster
+    void placeSeeds(PointMatrix &points, const vector<int> &seeds)
+    {
+        for (int id_cluster = 0; id_cluster < K; id_cluster++)
+        {
+            points.setCluster(seeds[id_cluster], id_cluster); // Assign cluster
+            clusters.emplace_back(id_cluster, centroids.data() + (size_t)id_cluster * total_values, points.row(seeds[id_cluster]), total_values); // SAMIR - emplace back
+        }
+    }
 
-    // ==========================================================================
-    // Step 1: Read Input Values
-    // ==========================================================================
-    // Read the total number of data points, the number of features per point,
-    // the number of clusters (K), the maximum number of iterations, and whether
-    // each point has a name.
-    cin >> total_points >> total_values >> K >> max_iterations >> has_name;
+    void run(PointMatrix &points)
+    {
+        auto begin = chrono::high_resolution_clock::now();
+        perfStart();
 
-    // Declare a vector to store all points in the dataset
-    vector<Point> points;
-    points.reserve(total_points); // SAMIR - Preallocate memory for all points
-    string point_name;            // To store the optional name of the point
+        if (K > total_points)
+            return;
 
-    // ==========================================================================
-    // Step 2: Read Points from Input
-    // ==========================================================================
-    for (int i = 0; i < total_points; i++)
+        clusters.reserve(K); // SAMIR - reserve memory for K clusters to avoid dynamic resizing
+
+        // Step 1: **Select K unique initial centroids randomly**
+        placeSeeds(points, init_mode == INIT_RANDOM ? drawRandomSeeds(K, total_points) : chooseSpreadSeeds(points));
+
+        // SAMIR - float32 mode: float copy of the points, plus the starting state for the float64 comparison run
+        vector<double> initial_centroids;
+        vector<int32_t> initial_assignments;
+        if (precision == PRECISION_FLOAT32)
+        {
+            convertPoints(points, points32);
+            initial_centroids.assign(centroids.data(), centroids.data() + (size_t)K * total_values);
+            initial_assignments.assign(points.getAssignments(), points.getAssignments() + total_points);
+        }
+
+        auto end_phase1 = chrono::high_resolution_clock::now();
+        perfStop(PERF_PHASE1);
+        int iter = 1;
+
+        // Step 2: **Iterate until convergence or max_iterations reached**
+        if (batch_size > 0)
+            iter = runMiniBatch(points); // Mini-batches instead of full passes
+        else if (precision == PRECISION_FLOAT32)
+            iter = sum_mode == SUM_KAHAN ? runLloydF32<KahanFloat>(points) : runLloydF32<double>(points);
+        else
+            iter = runLloyd(points, true);
+
+        auto end = chrono::high_resolution_clock::now();
+        bench.seeding = benchMicros(end_phase1 - begin);
+        bench.phase2 = benchMicros(end - end_phase1);
+        bench.total = benchMicros(end - begin);
+        bench.iterations = iter;
+        if (precision == PRECISION_FLOAT32)
+            compareWithDouble(points, initial_centroids, initial_assignments);
+
+        // Step 3: **Display results**
+        report(&points, begin, end_phase1, end, iter);
+    }
+
+    // ========================================================================
+    // Out-of-core run (--stream): the points stay on disk and every pass reads them chunk by chunk (stream-dataset.h),
+    // so memory only holds two chunks. Step 2a and Step 2b.2 are fused into one pass per iteration: each chunk is
+    // assigned with the centroids of the previous iteration, its labels are written back if they changed, and it is
+    // added to the per-worker sums before the next chunk (already read in the background) takes its place.
+    // Returns false if the dataset or the labels file could not be read or written.
+    // ========================================================================
+    bool runStreaming(StreamingDataset &dataset)
+    {
+        auto begin = chrono::high_resolution_clock::now();
+        perfStart();
+
+        if (K > total_points)
+            return true;
+
+        clusters.reserve(K);
+
+        // Step 1: the same rand() draws as run(), then one pass to copy the chosen points into the centroids
+        vector<int> drawn = drawRandomSeeds(K, total_points);
+        vector<pair<int, int>> seeds; // (point, cluster), sorted by point
+        for (int id_cluster = 0; id_cluster < K; id_cluster++)
+            seeds.push_back(make_pair(drawn[id_cluster], id_cluster));
+        sort(seeds.begin(), seeds.end());
+        bool io_ok = true;
+        for (const pair<int, int> &seed : seeds)
+            io_ok = io_ok && dataset.writeLabel(seed.first, seed.second); // Assign cluster
+        AlignedBuffer<double> seed_values((size_t)K * total_values);
+        DataScatter scatter(total_values); // SAMIR - the --tol-shift scale, measured by this pass for free
+        io_ok = io_ok && dataset.pass([&](StreamChunk &chunk)
+                                      {
+            if (convergence.needsScatter())
+                scatter.merge(measureScatter(chunk.points, 0, chunk.count));
+            auto seed = lower_bound(seeds.begin(), seeds.end(), make_pair(chunk.first, -1));
+            for (; seed != seeds.end() && seed->first < chunk.first + chunk.count; ++seed)
+                memcpy(&seed_values[(size_t)seed->second * total_values], chunk.points.row(seed->first - chunk.first),
+                       total_values * sizeof(double)); });
+        if (!io_ok)
+            return false;
+        for (int id_cluster = 0; id_cluster < K; id_cluster++)
+            clusters.emplace_back(id_cluster, centroids.data() + (size_t)id_cluster * total_values, &seed_values[(size_t)id_cluster * total_values], total_values);
+
+        auto end_phase1 = chrono::high_resolution_clock::now();
+        perfStop(PERF_PHASE1);
+        if (convergence.isEnabled())
+        {
+            if (convergence.needsScatter())
+                convergence.setScatter(scatter);
+            convergence.start(centroids.data());
+        }
+
+        // Step 2: **Iterate until convergence or max_iterations reached**, one pass over the file per iteration
+        int iter = 1;
+        long long total_iteration_time = 0;
+        while (true)
+        {
+            auto iteration_start = chrono::high_resolution_clock::now();
+            perfStart();
+            TRACE_BEGIN(iteration);
+            bool done = true;
+            double assign_time = 0;
+            accumulators.zero();
+            if (assign_mode == ASSIGN_GEMM)
+                gemm.setCentroids(centroids.data());
+
+            bool pass_ok = dataset.pass([&](StreamChunk &chunk)
+                                        {
+                // Step 2a: **Assign each point of the chunk to the nearest cluster**
+                auto assign_start = chrono::high_resolution_clock::now();
+                if (assignRange(chunk.points, 0, chunk.count))
+                {
+                    done = false; // Mark a change
+                    io_ok = io_ok && dataset.writeLabels(chunk);
+                }
+                assign_time += benchMicros(chrono::high_resolution_clock::now() - assign_start);
+
+                // Step 2b.2: add the chunk to the calling worker's sums
+                accumulateRange(chunk.points, 0, chunk.count); });
+            if (!pass_ok)
+                return false;
+            if (!io_ok)
+            {
+                cerr << "Error: could not write the labels file" << endl;
+                return false;
+            }
+            auto pass_end = chrono::high_resolution_clock::now();
+            perfStop(PERF_STEP2A);
+
+            // Step 2b.3-2b.4: merge the slots and divide
+            accumulators.reduce();
+            divideCentroids(accumulators.totalSums(), accumulators.totalCounts());
+            bool converged = convergence.isEnabled() && convergence.record(iter, centroids.data(), accumulators.totalError());
+
+            auto iteration_end = chrono::high_resolution_clock::now();
+            perfStop(PERF_STEP2B);
+            TRACE_END(iteration, "iteration");
+            TRACE_ITERATION();
+            total_iteration_time += chrono::duration_cast<chrono::microseconds>(iteration_end - iteration_start).count();
+            bench.assignment += assign_time;
+            bench.update += benchMicros(pass_end - iteration_start) - assign_time + benchMicros(iteration_end - pass_end);
+
+            // Step 2c: **Check stopping condition**, or a tolerance met
+            if (done || converged || iter >= max_iterations)
+            {
+                cout << "Break in iteration " << iter << "\n\n";
+                break;
+            }
+            iter++;
+        }
+        iteration_time = total_iteration_time;
+
+        auto end = chrono::high_resolution_clock::now();
+        bench.seeding = benchMicros(end_phase1 - begin);
+        bench.phase2 = benchMicros(end - end_phase1);
+        bench.total = benchMicros(end - begin);
+        bench.iterations = iter;
+
+        // Step 3: **Display results**
+        report(nullptr, begin, end_phase1, end, iter);
+        return true;
+    }
+
+    // ========================================================================
+    // Pipelined load (--pipeline): run() for a text dataset that load.open() has only counted. Step 1 parses its K seed
+    // points straight from the text, then load.run() parses the chunks and, as each run of points is complete, does
+    // Step 2a and Step 2b.2 of iteration 1 on it, so the first iteration is over when the parse is. runLloyd() picks
+    // up from Step 2b.3. Phase 2 therefore includes most of the parsing, and TIME LOAD only the header and the counts.
+    // ========================================================================
+    void runPipelined(LoadPipeline &load, PointMatrix &points)
+    {
+        auto begin = chrono::high_resolution_clock::now();
+        perfStart();
+
+        if (K > total_points)
+        {
+            load.run(points, [](int, int) {});
+            return;
+        }
+
+        clusters.reserve(K);
+
+        // Step 1: **Select K unique initial centroids randomly**, parsed on their own since nothing else is yet
+        vector<int> seeds = drawRandomSeeds(K, total_points);
+        AlignedBuffer<double> seed_values((size_t)K * total_values); // Zero where a seed cannot be read
+        vector<bool> seed_read(K);
+        for (int id_cluster = 0; id_cluster < K; id_cluster++)
+        {
+            double *values = &seed_values[(size_t)id_cluster * total_values];
+            seed_read[id_cluster] = load.readPoint(seeds[id_cluster], values);
+            if (!seed_read[id_cluster])
+                memset(values, 0, total_values * sizeof(double));
+            points.setCluster(seeds[id_cluster], id_cluster); // Assign cluster
+            clusters.emplace_back(id_cluster, centroids.data() + (size_t)id_cluster * total_values, values, total_values);
+        }
+
+        auto end_phase1 = chrono::high_resolution_clock::now();
+        perfStop(PERF_PHASE1);
+
+        // Iteration 1, Step 2a and Step 2b.1-2b.2, on each run of points as soon as the pipeline has parsed it
+        std::atomic<bool> moved(false);
+        accumulators.zero();
+        if (assign_mode == ASSIGN_GEMM)
+            gemm.setCentroids(centroids.data());
+        int complete = load.run(points, [&](int first, int last)
+                                {
+            if (assignRange(points, first, last))
+                moved.store(true, std::memory_order_relaxed);
+            accumulateRange(points, first, last); });
+
+        // A seed after a malformed value parsed fine in Step 1 but is zero in the matrix, like every point from there
+        // on: take the seeds from the matrix and redo the pass the usual way
+        bool reseed = false;
+        for (int id_cluster = 0; id_cluster < K; id_cluster++)
+            reseed = reseed || (seeds[id_cluster] >= complete && seed_read[id_cluster]);
+        if (reseed)
+        {
+            for (int i = 0; i < total_points; i++)
+                points.setCluster(i, -1);
+            for (int id_cluster = 0; id_cluster < K; id_cluster++)
+            {
+                points.setCluster(seeds[id_cluster], id_cluster);
+                memcpy(centroids.data() + (size_t)id_cluster * total_values, points.row(seeds[id_cluster]), total_values * sizeof(double));
+            }
+            accumulators.zero();
+            moved = assignNearest(points);
+            accumulateRange(points, 0, total_points);
+        }
+        first_pass_loaded = true;
+        first_pass_moved = moved;
+
+        // Step 2: **Iterate until convergence or max_iterations reached**, from Step 2b.3 of iteration 1
+        int iter = runLloyd(points, true);
+
+        auto end = chrono::high_resolution_clock::now();
+        bench.seeding = benchMicros(end_phase1 - begin);
+        bench.phase2 = benchMicros(end - end_phase1);
+        bench.total = benchMicros(end - begin);
+        bench.iterations = iter;
+
+        // Step 3: **Display results**
+        report(&points, begin, end_phase1, end, iter);
+    }
+
+    // ========================================================================
+    // One of the concurrent runs of --restarts or --sweep-k: Step 1 (step1() places the initial centroids), then
+    // Step 2, without any output. Records the iterations, the time and the final inertia; reportRun() prints them.
+    // ========================================================================
+    template <typename Step1>
+    void runSilent(PointMatrix &points, const Step1 &step1)
     {
-        vector<double> values;        // Store feature values of the current point
-        values.reserve(total_values); // SAMIR - preallocate memory for feature values
+        run_begin = chrono::high_resolution_clock::now();
+        silent = true;
+        clusters.reserve(K);
 
-        // Read the feature values for the current point
+        // Step 1: **Select K initial centroids**
+        step1();
+        run_end_phase1 = chrono::high_resolution_clock::now();
+
+        // Step 2: **Iterate until convergence or max_iterations reached**
+        run_iterations = runLloyd(points, true);
+        run_end = chrono::high_resolution_clock::now();
+        run_inertia = computeInertia(points);
+
+        bench.seeding = benchMicros(run_end_phase1 - run_begin);
+        bench.phase2 = benchMicros(run_end - run_end_phase1);
+        bench.total = benchMicros(run_end - run_begin);
+        bench.iterations = run_iterations;
+    }
+
+    // Cold start: random_seeds (drawn beforehand, since rand() is not thread-safe), or k-means++ / k-means|| with this
+    // run's seed
+    void runRestart(PointMatrix &points, const vector<int> &random_seeds)
+    {
+        runSilent(points, [&]()
+                  { placeSeeds(points, init_mode == INIT_RANDOM ? random_seeds : chooseSpreadSeeds(points)); });
+    }
+
+    // Warm start: K given initial centroids, e.g. splitWorstCluster() of the run for K - 1
+    void runFromCentroids(PointMatrix &points, const double *initial_centroids)
+    {
+        runSilent(points, [&]()
+                  {
+            for (int id_cluster = 0; id_cluster < K; id_cluster++)
+                clusters.emplace_back(id_cluster, centroids.data() + (size_t)id_cluster * total_values, initial_centroids + (size_t)id_cluster * total_values, total_values); });
+    }
+
+    // Step 3 of a silent run, with its own iterations and timings
+    void reportRun(const PointMatrix &points)
+    {
+        cout << "Break in iteration " << run_iterations << "\n\n";
+        report(&points, run_begin, run_end_phase1, run_end, run_iterations);
+    }
+
+    inline int getRunIterations() const { return run_iterations; }
+    inline double getRunInertia() const { return run_inertia; }
+    inline long long getRunMicros() const { return chrono::duration_cast<chrono::microseconds>(run_end - run_begin).count(); }
+
+    // Warm start for K + 1 clusters (--sweep-k): these K centroids, with the cluster of the highest SSE replaced by two
+    // centroids at its centroid minus and plus its per-dimension standard deviation, so the new pair starts on either
+    // side of the cluster's spread. Fixed chunks and tree, like computeInertia().
+    vector<double> splitWorstCluster(const PointMatrix &points) const
+    {
+        // Per cluster: the squared deviation from the centroid of every dimension, then the point count
+        const size_t per_cluster = total_values + 1;
+        vector<double> spread = tbb::parallel_deterministic_reduce(
+            tbb::blocked_range<int>(0, total_points, REDUCTION_CHUNK_POINTS), vector<double>(K * per_cluster, 0.0),
+            [&](const tbb::blocked_range<int> &range, vector<double> sums)
+            {
+                for (int i = range.begin(); i < range.end(); i++)
+                {
+                    int id_cluster = points.getCluster(i);
+                    if (id_cluster < 0)
+                        continue;
+                    const double *point = points.row(i);
+                    const double *centroid = centroids.data() + (size_t)id_cluster * total_values;
+                    double *cluster = &sums[id_cluster * per_cluster];
+                    for (int j = 0; j < total_values; j++)
+                        cluster[j] += (point[j] - centroid[j]) * (point[j] - centroid[j]);
+                    cluster[total_values] += 1;
+                }
+                return sums;
+            },
+            [](vector<double> left, const vector<double> &right)
+            {
+                for (size_t v = 0; v < left.size(); v++)
+                    left[v] += right[v];
+                return left;
+            });
+
+        int worst = 0;
+        double worst_sse = -1;
+        for (int id_cluster = 0; id_cluster < K; id_cluster++)
+        {
+            double sse = 0;
+            for (int j = 0; j < total_values; j++)
+                sse += spread[id_cluster * per_cluster + j];
+            if (sse > worst_sse)
+            {
+                worst = id_cluster;
+                worst_sse = sse;
+            }
+        }
+
+        vector<double> next((size_t)(K + 1) * total_values);
+        copy(centroids.data(), centroids.data() + (size_t)K * total_values, next.begin());
+        double count = max(1.0, spread[worst * per_cluster + total_values]);
         for (int j = 0; j < total_values; j++)
         {
-            double value;
-            cin >> value;
-            values.push_back(value);
+            double deviation = sqrt(spread[worst * per_cluster + j] / count);
+            double center = centroids.data()[(size_t)worst * total_values + j];
+            next[(size_t)worst * total_values + j] = center - deviation;
+            next[(size_t)K * total_values + j] = center + deviation;
         }
+        return next;
+    }
+
+    // Sum of squared distances from every point to the centroid of its cluster, the quantity K-Means minimizes.
+    // Fixed chunks and a fixed reduction tree, so it is the same for any thread count.
+    double computeInertia(const PointMatrix &points) const
+    {
+        return tbb::parallel_deterministic_reduce(
+            tbb::blocked_range<int>(0, total_points, REDUCTION_CHUNK_POINTS), 0.0,
+            [&](const tbb::blocked_range<int> &range, double sum)
+            {
+                for (int i = range.begin(); i < range.end(); i++)
+                {
+                    int id_cluster = points.getCluster(i);
+                    if (id_cluster < 0)
+                        continue;
+                    const double *point = points.row(i);
+                    const double *centroid = centroids.data() + (size_t)id_cluster * total_values;
+                    for (int j = 0; j < total_values; j++)
+                        sum += (point[j] - centroid[j]) * (point[j] - centroid[j]);
+                }
+                return sum;
+            },
+            std::plus<double>());
+    }
+};
+
+// ============================================================================
+// --restarts: R independent K-Means runs at once over the one loaded point matrix, instead of R processes that each
+// parse the dataset. Every run has its own centroids, accumulators and engine state, and a view of the points with
+// assignments of its own, so the values are shared read-only. The random seeds of all runs are drawn first, in
+// order, so run 1 starts exactly like a single run and no draw depends on scheduling; k-means++ / k-means|| give run
+// r the seed --seed + r. The runs are a parallel_for over restarts whose bodies are parallel over blocks of points;
+// each run is isolated, so a thread waiting inside one run's parallel_for only takes work of that same run instead of
+// starting a whole other run on top of it. The run with the lowest inertia is reported and its labels are copied
+// into points. Returns its index.
+// ============================================================================
+int runRestarts(PointMatrix &points, const DatasetHeader &header, const KMeansOptions &options, vector<unique_ptr<KMeans>> &runs)
+{
+    const int restarts = options.restarts;
+    vector<PointMatrix> views(restarts);
+    vector<vector<int>> random_seeds(restarts);
+    for (int r = 0; r < restarts; r++)
+    {
+        KMeansOptions run_options = options;
+        run_options.seed = options.seed + r;
+        runs.emplace_back(new KMeans(header.K, header.total_points, header.total_values, header.max_iterations, run_options));
+        views[r].shareValues(points);
+        if (options.init_mode == INIT_RANDOM)
+            random_seeds[r] = drawRandomSeeds(header.K, header.total_points);
+    }
+
+    auto begin = chrono::high_resolution_clock::now();
+    tbb::parallel_for(0, restarts, [&](int r)
+                      { tbb::this_task_arena::isolate([&]()
+                                                      { runs[r]->runRestart(views[r], random_seeds[r]); }); });
+    auto end = chrono::high_resolution_clock::now();
+
+    int best = 0;
+    for (int r = 1; r < restarts; r++)
+        if (runs[r]->getRunInertia() < runs[best]->getRunInertia())
+            best = r;
+    memcpy(points.getAssignments(), views[best].getAssignments(), (size_t)header.total_points * sizeof(int32_t));
+
+    runs[best]->reportRun(views[best]);
+    streamsize precision = cout.precision(12); // Restarts that end in the same clustering differ in the last digits only
+    for (int r = 0; r < restarts; r++)
+        cout << "RESTART " << r + 1 << " = inertia " << runs[r]->getRunInertia() << ", " << runs[r]->getRunIterations()
+             << " iterations, " << runs[r]->getRunMicros() << " µs" << (r == best ? " (best)" : "") << "\n";
+    cout.precision(precision);
+    cout << "TIME RESTARTS = " << chrono::duration_cast<chrono::microseconds>(end - begin).count() << " µs for "
+         << restarts << " concurrent runs\n";
+    return best;
+}
+
+// ============================================================================
+// --sweep-k=A..B: one K-Means run per K from A to B over the one loaded point matrix, to pick K from the elbow of
+// the inertia curve without a process (and a parse) per K. The first K starts cold (Step 1 as usual) and every later
+// K warm-starts from the solution for K - 1 with its highest-SSE cluster split in two (splitWorstCluster()), so the
+// runs form one chain; the concurrency comes from inside each run, whose steps are parallel over blocks of points in
+// the arena. Cutting the range into independent chains instead would give each chain a cold head that can end above
+// the warm K before it and bend the elbow curve the wrong way. Only the previous run is kept alive. Prints one line
+// per K and returns the timings of the whole sweep.
+// ============================================================================
+struct SweepResult
+{
+    double inertia;
+    int iterations;
+    long long micros;
+    bool warm;
+};
+
+BenchReport runSweep(PointMatrix &points, const DatasetHeader &header, const KMeansOptions &options)
+{
+    const int first_k = options.sweep_first;
+    const int last_k = min(options.sweep_last, header.total_points);
+    const int count = last_k - first_k + 1;
+
+    vector<int> random_seeds;
+    if (options.init_mode == INIT_RANDOM)
+        random_seeds = drawRandomSeeds(first_k, header.total_points);
+
+    vector<SweepResult> results(count);
+    vector<BenchReport> benches(count);
+    auto begin = chrono::high_resolution_clock::now();
+    unique_ptr<KMeans> previous;
+    PointMatrix views[2]; // Assignments of this run and of the previous one, which the split reads
+    for (int i = 0; i < count; i++)
+    {
+        KMeansOptions run_options = options;
+        run_options.seed = options.seed + i;
+        unique_ptr<KMeans> run(new KMeans(first_k + i, header.total_points, header.total_values, header.max_iterations, run_options));
+        PointMatrix &view = views[i % 2];
+        view.shareValues(points);
+        if (!previous)
+            run->runRestart(view, random_seeds);
+        else
+            run->runFromCentroids(view, previous->splitWorstCluster(views[(i - 1) % 2]).data());
+
+        results[i].inertia = run->getRunInertia();
+        results[i].iterations = run->getRunIterations();
+        results[i].micros = run->getRunMicros();
+        results[i].warm = previous != nullptr;
+        benches[i] = run->getBenchReport();
+        previous.swap(run);
+    }
+    auto end = chrono::high_resolution_clock::now();
+
+    streamsize precision = cout.precision(12);
+    for (int i = 0; i < count; i++)
+        cout << "SWEEP K = " << first_k + i << ": inertia " << results[i].inertia << ", " << results[i].iterations
+             << " iterations, " << results[i].micros << " µs, " << (results[i].warm ? "warm" : "cold") << " start\n";
+    cout.precision(precision);
+    cout << "TIME SWEEP = " << chrono::duration_cast<chrono::microseconds>(end - begin).count() << " µs for K = " << first_k
+         << ".." << last_k << "\n";
+
+    // For benchmark.cpp: the sweep as one run, with the work of every K summed
+    BenchReport sweep;
+    for (int i = 0; i < count; i++)
+    {
+        sweep.seeding += benches[i].seeding;
+        sweep.assignment += benches[i].assignment;
+        sweep.update += benches[i].update;
+        sweep.iterations += benches[i].iterations;
+    }
+    sweep.total = sweep.phase2 = benchMicros(end - begin);
+    return sweep;
+}
 
-        // If the points have names, read and store the name
-        if (has_name)
+int main(int argc, char *argv[])
+{
+    // Seed the random number generator (for selecting initial centroids randomly)
+    // srand(time(NULL));
+    srand(10);
+
+    KMeansOptions options;
+    if (!parseOptions(argc, argv, options))
+        return 1;
+
+    // SAMIR - opened before the first TBB worker starts, so the inherited counters cover every worker thread
+    PerfCounters perf;
+    if (options.perf_counters)
+        perf.open();
+
+    // SAMIR - one explicit arena for the whole run: --threads, or the count benchmark.cpp asks for (KMEANS_BENCH_THREADS),
+    // or TBB's default; --pin binds its threads to CPUs
+    ThreadArena arena(options.threads > 0 ? options.threads : benchThreads(), options.pin_policy);
+    int status = arena.execute([&]() -> int
+                               {
+        // ==========================================================================
+        // Step 1: Read Input Values and Points
+        // ==========================================================================
+        // The header gives the total number of data points, the number of features per point,
+        // the number of clusters (K), the maximum number of iterations, and whether
+        // each point has a name. SAMIR - every point is read straight into one contiguous matrix
+        auto begin_load = chrono::high_resolution_clock::now();
+        DatasetHeader header;
+        PointMatrix points;
+        StreamingDataset stream;
+        LoadPipeline pipeline;
+        if (options.stream_mb > 0)
         {
-            cin >> point_name;
-            Point p(i, values, point_name); // Create a Point with a name
-            points.emplace_back(i, values); // SAMIR - emplace back
+            // SAMIR - out of core: only the header is read here, every pass streams the points from the file
+            if (!stream.open(STDIN_FILENO, (size_t)options.stream_mb << 20, options.labels_path))
+                return 1;
+            header = stream.getHeader();
+        }
+        else if (options.pipeline_load)
+        {
+            // SAMIR - only the header and the token counts here; kmeans.runPipelined() parses the chunks together
+            // with iteration 1. Binary datasets load in place as usual
+            if (!pipeline.open(STDIN_FILENO, header, points))
+            {
+                cerr << "Error: malformed dataset on standard input" << endl;
+                return 1;
+            }
+            if (!pipeline.isText())
+                points.buildColumns();
         }
         else
         {
-            Point p(i, values);             // Create a Point without a name
-            points.emplace_back(i, values); // SAMIR - emplace back`
+            if (!loadPointMatrixParallel(STDIN_FILENO, header, points)) // SAMIR - mmap the dataset and parse it in parallel chunks
+            {
+                cerr << "Error: malformed dataset on standard input" << endl;
+                return 1;
+            }
+            points.buildColumns(); // SAMIR - column-major copy for the SIMD kernels
         }
-    }
 
-    // ==========================================================================
-    // Step 3: Initialize K-Means Algorithm and Run Clustering
-    // ==========================================================================
-    // Create an instance of KMeans with the input parameters
-    KMeans kmeans(K, total_points, total_values, max_iterations);
+        // SAMIR - NUMA: one block of points per node, re-homed so each block's pages are first touched on its node.
+        // auto only turns it on with more than one node (or KMEANS_NUMA_NODES) and a run it covers
+        NumaPartition numa;
+        bool use_numa = options.numa_mode == NUMA_ON;
+        if (options.numa_mode == NUMA_AUTO && supportsNuma(options))
+            use_numa = detectNumaNodes().size() > 1;
+        if (use_numa)
+        {
+            numa.init(header.total_points, options.threads > 0 ? options.threads : benchThreads());
+            numa.placePoints(points);
+        }
+        auto end_load = chrono::high_resolution_clock::now();
+
+        // ==========================================================================
+        // Step 3: Initialize K-Means Algorithm and Run Clustering
+        // ==========================================================================
+        // Create an instance of KMeans with the input parameters (one per run with --restarts)
+        vector<unique_ptr<KMeans>> runs;
+        int best = 0;
+        BenchReport report;
+        if (options.sweep_first > 0)
+        {
+            // SAMIR - elbow sweep: the K values of the range instead of the header's K
+            if (options.sweep_first > header.total_points)
+            {
+                cerr << "Error: --sweep-k starts above the " << header.total_points << " points of the dataset" << endl;
+                return 1;
+            }
+            report = runSweep(points, header, options);
+        }
+        else if (options.restarts > 1 && header.K <= header.total_points)
+            best = runRestarts(points, header, options, runs); // SAMIR - n_init runs at once over the shared points
+        else
+        {
+            runs.emplace_back(new KMeans(header.K, header.total_points, header.total_values, header.max_iterations, options));
+            if (options.perf_counters)
+                runs[0]->attachPerfCounters(&perf);
+            if (use_numa)
+                runs[0]->attachNuma(&numa);
+
+            // Run the K-Means algorithm on the dataset
+            if (options.stream_mb > 0)
+            {
+                if (!runs[0]->runStreaming(stream))
+                    return 1;
+            }
+            else if (options.pipeline_load && pipeline.isText())
+                runs[0]->runPipelined(pipeline, points);
+            else
+                runs[0]->run(points);
+        }
+        cout << "TIME LOAD = " << chrono::duration_cast<chrono::microseconds>(end_load - begin_load).count() << " µs\n";
+        if (!runs.empty())
+        {
+            // SAMIR - from the start of the load to the end of iteration 1, the number --pipeline is meant to cut
+            if (runs[best]->hasFirstCentroids())
+                cout << "TIME FIRST CENTROIDS = " << chrono::duration_cast<chrono::microseconds>(runs[best]->getFirstCentroidsTime() - begin_load).count() << " µs\n";
+            report = runs[best]->getBenchReport();
+        }
+        cout << "THREADS = " << arena.getConcurrency() << ", PINNING = " << pinPolicyName(options.pin_policy) << "\n";
+        cout << "NUMA = ";
+        if (use_numa)
+            numa.describe(cout);
+        else
+            cout << "off";
+        cout << "\n";
+        if (options.pipeline_load)
+        {
+            cout << "PIPELINE = ";
+            if (pipeline.isText())
+                cout << pipeline.getTotalChunks() << " chunks, up to " << pipeline.getMaxTokens() << " in flight";
+            else
+                cout << "off (binary dataset, nothing to parse)";
+            cout << "\n";
+        }
+        if (options.stream_mb > 0)
+        {
+            cout << "STREAM = ";
+            stream.describe(cout);
+            cout << "\n";
+        }
 
-    // Run the K-Means algorithm on the dataset
-    kmeans.run(points);
+        // SAMIR - phase timings as JSON for benchmark.cpp, when it asks for them
+        report.load = benchMicros(end_load - begin_load);
+        writeBenchReport("parallel", report);
+        TRACE_FINISH(); // SAMIR - per-step summary and Chrome trace, only in -DKMEANS_TRACE builds
+        return 0; });
 
     // ==========================================================================
     // Step 4: Exit Program
     // ==========================================================================
-    return 0; // Return 0 to indicate successful execution
+    return status; // Return 0 to indicate successful execution
 }
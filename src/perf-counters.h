@@ -0,0 +1,234 @@
+// Hardware performance counters around the phases of KMeans::run (Linux perf_event_open)
+//
+// SUMMARY
+// Timings alone do not say whether a run such as 8.txt is limited by memory or by arithmetic. With --perf=on,
+// parallel.cpp opens these counters for the whole process before the dataset is loaded:
+//   task-clock                CPU time of all threads (software counter, available almost everywhere)
+//   cycles, instructions      IPC
+//   cache-misses              last-level cache misses, times 64 bytes for an estimate of the memory traffic
+//   FP_ARITH_INST_RETIRED.*   scalar and 128/256/512-bit packed double instructions (Intel raw events), which give
+//                             the vector instruction mix and the FLOP count (an FMA counts as two)
+// Each counter is opened with inherit set, so threads created later (the TBB workers) are counted too and reading the
+// counter returns the sum over all of them. stop(phase) adds what happened since the last start()/stop() to that phase;
+// counts are scaled by time_enabled / time_running in case the kernel had to multiplex them. Counters the kernel or CPU
+// does not offer (virtual machines, perf_event_paranoid, other vendors) are left out of the report, and if none opens
+// the report says why instead.
+// Samir's code
+
+#ifndef KMEANS_PERF_COUNTERS_H
+#define KMEANS_PERF_COUNTERS_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+enum PerfPhase
+{
+    PERF_PHASE1,
+    PERF_STEP2A,
+    PERF_STEP2B,
+    PERF_PHASE_COUNT
+};
+
+enum PerfCounter
+{
+    PERF_TASK_CLOCK,   // Nanoseconds
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_LLC_MISSES,
+    PERF_FP_SCALAR,    // Scalar double instructions
+    PERF_FP_128,       // 128-bit packed double (2 doubles)
+    PERF_FP_256,       // 256-bit packed double (4 doubles)
+    PERF_FP_512,       // 512-bit packed double (8 doubles)
+    PERF_COUNTER_COUNT
+};
+
+class PerfCounters
+{
+private:
+    int fds[PERF_COUNTER_COUNT];
+    double last[PERF_COUNTER_COUNT];                     // Scaled values at the last start()/stop()
+    double totals[PERF_PHASE_COUNT][PERF_COUNTER_COUNT]; // Per phase
+    double elapsed[PERF_PHASE_COUNT];                    // Wall time per phase, seconds
+    std::chrono::steady_clock::time_point last_time;
+    bool opened;
+    std::string unavailable; // Why no counter opened
+
+    // Current value of every open counter, scaled for multiplexing
+    void read(double *values) const
+    {
+#ifdef __linux__
+        for (int c = 0; c < PERF_COUNTER_COUNT; c++)
+        {
+            values[c] = 0.0;
+            uint64_t data[3]; // value, time_enabled, time_running
+            if (fds[c] < 0 || ::read(fds[c], data, sizeof(data)) != (ssize_t)sizeof(data))
+                continue;
+            values[c] = data[2] > 0 ? (double)data[0] * data[1] / data[2] : 0.0;
+        }
+#else
+        for (int c = 0; c < PERF_COUNTER_COUNT; c++)
+            values[c] = 0.0;
+#endif
+    }
+
+#ifdef __linux__
+    static int openCounter(uint32_t type, uint64_t config)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.inherit = 1; // Threads created after this point are counted into this counter
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+
+    static bool isIntel()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        unsigned int eax, ebx, ecx, edx;
+        __asm__("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(0));
+        return ebx == 0x756e6547 && edx == 0x49656e69 && ecx == 0x6c65746e; // "GenuineIntel"
+#else
+        return false;
+#endif
+    }
+#endif
+
+    inline double value(int phase, PerfCounter counter) const { return totals[phase][counter]; }
+    inline bool has(PerfCounter counter) const { return fds[counter] >= 0; }
+
+public:
+    PerfCounters() : opened(false)
+    {
+        for (int c = 0; c < PERF_COUNTER_COUNT; c++)
+            fds[c] = -1;
+        memset(last, 0, sizeof(last));
+        memset(totals, 0, sizeof(totals));
+        memset(elapsed, 0, sizeof(elapsed));
+    }
+
+    ~PerfCounters()
+    {
+#ifdef __linux__
+        for (int c = 0; c < PERF_COUNTER_COUNT; c++)
+            if (fds[c] >= 0)
+                close(fds[c]);
+#endif
+    }
+
+    // Call before any worker thread exists. Returns whether at least one counter opened.
+    bool open()
+    {
+#ifdef __linux__
+        fds[PERF_TASK_CLOCK] = openCounter(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK);
+        fds[PERF_CYCLES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        int hardware_errno = errno;
+        fds[PERF_INSTRUCTIONS] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        fds[PERF_LLC_MISSES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        if (isIntel())
+        {
+            // FP_ARITH_INST_RETIRED (event 0xC7), umask per width; Skylake and later
+            fds[PERF_FP_SCALAR] = openCounter(PERF_TYPE_RAW, 0x01c7);
+            fds[PERF_FP_128] = openCounter(PERF_TYPE_RAW, 0x04c7);
+            fds[PERF_FP_256] = openCounter(PERF_TYPE_RAW, 0x10c7);
+            fds[PERF_FP_512] = openCounter(PERF_TYPE_RAW, 0x40c7);
+        }
+
+        for (int c = 0; c < PERF_COUNTER_COUNT; c++)
+            opened = opened || fds[c] >= 0;
+        if (!has(PERF_CYCLES))
+            unavailable = std::string("hardware counters: ") + strerror(hardware_errno) +
+                          " (virtual machine, or /proc/sys/kernel/perf_event_paranoid too high)";
+#else
+        unavailable = "perf_event_open needs Linux";
+#endif
+        start();
+        return opened;
+    }
+
+    inline bool isOpen() const { return opened; }
+
+    // Begins a measured interval
+    void start()
+    {
+        if (!opened)
+            return;
+        read(last);
+        last_time = std::chrono::steady_clock::now();
+    }
+
+    // Ends the interval begun by the last start() or stop() and adds it to phase
+    void stop(PerfPhase phase)
+    {
+        if (!opened)
+            return;
+        double now[PERF_COUNTER_COUNT];
+        read(now);
+        std::chrono::steady_clock::time_point now_time = std::chrono::steady_clock::now();
+        for (int c = 0; c < PERF_COUNTER_COUNT; c++)
+        {
+            totals[phase][c] += now[c] - last[c];
+            last[c] = now[c];
+        }
+        elapsed[phase] += std::chrono::duration<double>(now_time - last_time).count();
+        last_time = now_time;
+    }
+
+    // One line per phase, with the derived metrics of the counters that opened. peak_flops_per_cycle is what one core
+    // can retire per cycle with the SIMD level in use, so FLOP/s are given against cycles actually spent.
+    void report(std::ostream &out, double peak_flops_per_cycle) const
+    {
+        static const char *phase_names[PERF_PHASE_COUNT] = {"PHASE 1", "STEP 2A", "STEP 2B"};
+        if (!opened)
+        {
+            out << "PERF COUNTERS = unavailable (" << unavailable << ")\n";
+            return;
+        }
+        if (!unavailable.empty())
+            out << "PERF COUNTERS = software only, " << unavailable << "\n";
+
+        for (int p = 0; p < PERF_PHASE_COUNT; p++)
+        {
+            double seconds = elapsed[p];
+            if (seconds <= 0.0)
+                continue;
+            out << "PERF " << phase_names[p] << ":";
+            if (has(PERF_TASK_CLOCK))
+                out << " CPU " << value(p, PERF_TASK_CLOCK) / 1e3 << " µs (" << value(p, PERF_TASK_CLOCK) / 1e9 / seconds
+                    << " threads busy)";
+            if (has(PERF_CYCLES) && has(PERF_INSTRUCTIONS) && value(p, PERF_CYCLES) > 0)
+                out << ", IPC " << value(p, PERF_INSTRUCTIONS) / value(p, PERF_CYCLES);
+            if (has(PERF_LLC_MISSES))
+                out << ", LLC MISSES " << value(p, PERF_LLC_MISSES) << " (~"
+                    << value(p, PERF_LLC_MISSES) * 64 / 1e9 / seconds << " GB/s)";
+            if (has(PERF_FP_SCALAR) && has(PERF_FP_128) && has(PERF_FP_256) && has(PERF_FP_512))
+            {
+                double flops = value(p, PERF_FP_SCALAR) + 2 * value(p, PERF_FP_128) + 4 * value(p, PERF_FP_256) +
+                               8 * value(p, PERF_FP_512);
+                double vector = value(p, PERF_FP_128) + value(p, PERF_FP_256) + value(p, PERF_FP_512);
+                out << ", VECTOR FP INSTRUCTIONS " << vector << " of " << vector + value(p, PERF_FP_SCALAR)
+                    << ", " << flops / 1e9 / seconds << " GFLOP/s";
+                if (has(PERF_CYCLES) && value(p, PERF_CYCLES) > 0)
+                    out << " (" << 100.0 * flops / (value(p, PERF_CYCLES) * peak_flops_per_cycle) << "% of peak)";
+            }
+            out << "\n";
+        }
+    }
+};
+
+#endif
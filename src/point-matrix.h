@@ -0,0 +1,328 @@
+// Shared dense point storage for the K-Means implementations
+//
+// SUMMARY
+// Every variant used to keep one `Point` object per data point, each owning its own heap-allocated `vector<double>`
+// plus an `int total_values` and a `std::string name`. On 8.txt that is 200k small allocations scattered across the heap,
+// and the assignment loop chased a pointer for every point. This header replaces that with one contiguous, 64-byte aligned
+// matrix of feature values (row-major, with an optional column-major/SoA copy for kernels that vectorize across points),
+// a separate int32 assignment array, and an optional side table for point names.
+// Samir's code
+
+#ifndef KMEANS_POINT_MATRIX_H
+#define KMEANS_POINT_MATRIX_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+// ============================================================================
+//                              AlignedBuffer
+// ============================================================================
+// Owning, zero-initialized array aligned to a cache line (64 bytes, which is also the width of an AVX-512 register).
+// Move-only so a matrix can never be copied by accident.
+
+template <typename T>
+class AlignedBuffer
+{
+private:
+    T *data_;
+    size_t size_;
+
+public:
+    static const size_t ALIGNMENT = 64;
+
+    AlignedBuffer() : data_(nullptr), size_(0) {}
+
+    explicit AlignedBuffer(size_t size) : data_(nullptr), size_(0) { resize(size); }
+
+    AlignedBuffer(AlignedBuffer &&other) : data_(other.data_), size_(other.size_)
+    {
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+
+    AlignedBuffer &operator=(AlignedBuffer &&other)
+    {
+        if (this != &other)
+        {
+            free(data_);
+            data_ = other.data_;
+            size_ = other.size_;
+            other.data_ = nullptr;
+            other.size_ = 0;
+        }
+        return *this;
+    }
+
+    AlignedBuffer(const AlignedBuffer &) = delete;
+    AlignedBuffer &operator=(const AlignedBuffer &) = delete;
+
+    ~AlignedBuffer() { free(data_); }
+
+    // Discards the old contents; the new buffer is zero-filled
+    void resize(size_t size)
+    {
+        free(data_);
+        data_ = nullptr;
+        size_ = 0;
+        if (size == 0)
+            return;
+
+        void *memory = nullptr;
+        if (posix_memalign(&memory, ALIGNMENT, size * sizeof(T)) != 0)
+            throw std::bad_alloc();
+
+        memset(memory, 0, size * sizeof(T));
+        data_ = static_cast<T *>(memory);
+        size_ = size;
+    }
+
+    // Like resize() but leaves the contents uninitialized, so no page is touched until someone writes it: with NUMA
+    // first-touch placement, each page then lands on the node of the thread that fills it. alignment may be a page.
+    void allocate(size_t size, size_t alignment = ALIGNMENT)
+    {
+        free(data_);
+        data_ = nullptr;
+        size_ = 0;
+        if (size == 0)
+            return;
+
+        void *memory = nullptr;
+        if (posix_memalign(&memory, alignment, size * sizeof(T)) != 0)
+            throw std::bad_alloc();
+
+        data_ = static_cast<T *>(memory);
+        size_ = size;
+    }
+
+    inline T *data() { return data_; }
+    inline const T *data() const { return data_; }
+    inline size_t size() const { return size_; }
+    inline T &operator[](size_t index) { return data_[index]; }
+    inline const T &operator[](size_t index) const { return data_[index]; }
+};
+
+// ============================================================================
+//                              Dataset Header
+// ============================================================================
+// Mirrors the first line of every datasets/*.txt file:
+// total_points total_values K max_iterations has_name
+
+struct DatasetHeader
+{
+    int total_points;
+    int total_values;
+    int K;
+    int max_iterations;
+    int has_name;
+};
+
+// ============================================================================
+//                              PointMatrix Class
+// ============================================================================
+// Row i holds the total_values features of point i at values[i * total_values]. The column-major copy is only built
+// when a kernel asks for it (buildColumns()); its column stride is rounded up to a multiple of 16 points so SIMD kernels
+// can always load a full register without a scalar tail.
+// The values can also live outside the matrix (attach()), e.g. in a mapped binary dataset, in which case the matrix
+// only views them and owns nothing but the assignments and names.
+// Scalar is the type of the values: PointMatrix (double) everywhere, PointMatrixF32 for the float32 mode of
+// parallel.cpp, which is converted from a loaded PointMatrix with convertPoints().
+
+template <typename Scalar>
+class BasicPointMatrix
+{
+private:
+    int total_points;                   // Number of points (rows)
+    int total_values;                   // Number of features per point (columns)
+    size_t column_stride;               // Distance between two columns in the column-major copy
+    AlignedBuffer<Scalar> values;       // Row-major feature values (unless attached)
+    AlignedBuffer<Scalar> columns;      // Column-major (SoA) feature values, empty until buildColumns()
+    AlignedBuffer<int32_t> assignments; // Cluster of each point, -1 while unassigned
+    std::vector<std::string> names;     // Optional point names, empty when the dataset has none
+    Scalar *values_data;                // Row-major values in use: values, or attached storage
+    Scalar *columns_data;               // Column-major values in use: columns, attached storage or nullptr
+    bool columns_attached;              // The columns live in attached storage, so buildColumns() has nothing to do
+    std::shared_ptr<void> storage;      // Keeps attached storage (a mapped file) alive as long as the matrix
+
+    void setShape(int total_points, int total_values, bool has_name)
+    {
+        this->total_points = total_points;
+        this->total_values = total_values;
+        column_stride = ((size_t)total_points + COLUMN_PADDING - 1) / COLUMN_PADDING * COLUMN_PADDING;
+
+        values.resize(0);
+        columns.resize(0);
+        values_data = columns_data = nullptr;
+        columns_attached = false;
+        storage.reset();
+
+        assignments.resize(total_points);
+        for (int i = 0; i < total_points; i++)
+            assignments[i] = -1; // Initially, no point is assigned to any cluster
+
+        names.clear();
+        if (has_name)
+            names.resize(total_points);
+    }
+
+public:
+    static const int COLUMN_PADDING = 16;
+
+    BasicPointMatrix() : total_points(0), total_values(0), column_stride(0), values_data(nullptr), columns_data(nullptr),
+                    columns_attached(false) {}
+
+    BasicPointMatrix(int total_points, int total_values, bool has_name = false)
+        : total_points(0), total_values(0), column_stride(0), values_data(nullptr), columns_data(nullptr),
+          columns_attached(false)
+    {
+        reset(total_points, total_values, has_name);
+    }
+
+    void reset(int total_points, int total_values, bool has_name = false)
+    {
+        setShape(total_points, total_values, has_name);
+        values.resize((size_t)total_points * total_values);
+        values_data = values.data();
+    }
+
+    // Views values stored elsewhere instead of copying them. attached_columns must have the layout buildColumns()
+    // produces (getColumnStride() points per feature, zero padding); attached_rows may be nullptr, in which case the
+    // row-major values are transposed from the columns into memory the matrix owns. owner is kept until the matrix is
+    // reset or destroyed.
+    void attach(int total_points, int total_values, bool has_name, Scalar *attached_rows, Scalar *attached_columns,
+                std::shared_ptr<void> owner)
+    {
+        setShape(total_points, total_values, has_name);
+        storage = owner;
+        columns_data = attached_columns;
+        columns_attached = true;
+
+        if (attached_rows)
+            values_data = attached_rows;
+        else
+        {
+            values.resize((size_t)total_points * total_values);
+            values_data = values.data();
+            for (int i = 0; i < total_points; i++)
+                for (int j = 0; j < total_values; j++)
+                    values_data[(size_t)i * total_values + j] = attached_columns[j * column_stride + i];
+        }
+    }
+
+    // Views the values of other (rows and column-major copy, which must be built) with assignments of its own and no
+    // names, so several runs can share one dataset read-only (parallel.cpp --restarts). other must outlive this view.
+    void shareValues(BasicPointMatrix &other)
+    {
+        attach(other.total_points, other.total_values, false, other.values_data, other.columns_data, other.storage);
+    }
+
+    // Takes over row-major values, a column-major copy (buildColumns() layout, padding zeroed) and assignments that
+    // were filled elsewhere, e.g. block by block from the NUMA node that will read them (numa-partition.h). Shape and
+    // names are kept; the previous storage is released.
+    void adopt(AlignedBuffer<Scalar> &&rows, AlignedBuffer<Scalar> &&columns_copy, AlignedBuffer<int32_t> &&assignments_copy)
+    {
+        values = std::move(rows);
+        columns = std::move(columns_copy);
+        assignments = std::move(assignments_copy);
+        values_data = values.data();
+        columns_data = columns.data();
+        columns_attached = false;
+        storage.reset();
+    }
+
+    inline int getTotalPoints() const { return total_points; }
+    inline int getTotalValues() const { return total_values; }
+
+    // ========================================================================
+    // Row-major access: one contiguous run of total_values values per point
+    // ========================================================================
+    inline Scalar *row(int index) { return values_data + (size_t)index * total_values; }
+    inline const Scalar *row(int index) const { return values_data + (size_t)index * total_values; }
+    inline Scalar getValue(int index, int feature) const { return values_data[(size_t)index * total_values + feature]; }
+    inline Scalar *data() { return values_data; }
+    inline const Scalar *data() const { return values_data; }
+
+    // ========================================================================
+    // Column-major access: feature j of every point, padded to COLUMN_PADDING
+    // ========================================================================
+    void buildColumns()
+    {
+        allocateColumns();
+        buildColumns(0, total_points);
+    }
+
+    // The zero-filled column-major buffer, without copying any point into it yet. Rebuilding only overwrites the real
+    // points, so the padding stays zero and the buffer can be reused.
+    void allocateColumns()
+    {
+        if (columns_attached)
+            return;
+        if (columns.size() != column_stride * total_values)
+            columns.resize(column_stride * total_values);
+        columns_data = columns.data();
+    }
+
+    // Copies points [first, last) into the column-major buffer (allocateColumns() first), e.g. one parsed chunk at a time
+    void buildColumns(int first, int last)
+    {
+        if (columns_attached)
+            return;
+        for (int i = first; i < last; i++)
+        {
+            const Scalar *point = row(i);
+            for (int j = 0; j < total_values; j++)
+                columns_data[j * column_stride + i] = point[j];
+        }
+    }
+
+    inline bool hasColumns() const { return columns_data != nullptr || total_points == 0; }
+    inline const Scalar *column(int feature) const { return columns_data + feature * column_stride; }
+    inline size_t getColumnStride() const { return column_stride; }
+
+    // ========================================================================
+    // Cluster assignments
+    // ========================================================================
+    inline int getCluster(int index) const { return assignments[index]; }
+    inline void setCluster(int index, int id_cluster) { assignments[index] = id_cluster; }
+    inline int32_t *getAssignments() { return assignments.data(); }
+    inline const int32_t *getAssignments() const { return assignments.data(); }
+
+    // ========================================================================
+    // Names side table
+    // ========================================================================
+    inline bool hasNames() const { return !names.empty(); }
+    inline const std::string &getName(int index) const { return names[index]; }
+    inline void setName(int index, const std::string &name) { names[index] = name; }
+};
+
+template <typename Scalar>
+const int BasicPointMatrix<Scalar>::COLUMN_PADDING;
+
+typedef BasicPointMatrix<double> PointMatrix;
+typedef BasicPointMatrix<float> PointMatrixF32;
+
+// Copies the values (rounded to the target type), assignments and shape of source; names are not copied
+template <typename Target, typename Source>
+inline void convertPoints(const BasicPointMatrix<Source> &source, BasicPointMatrix<Target> &target)
+{
+    const int total_points = source.getTotalPoints();
+    const int total_values = source.getTotalValues();
+    target.reset(total_points, total_values);
+    for (int i = 0; i < total_points; i++)
+    {
+        const Source *source_values = source.row(i);
+        Target *target_values = target.row(i);
+        for (int j = 0; j < total_values; j++)
+            target_values[j] = (Target)source_values[j];
+        target.setCluster(i, source.getCluster(i));
+    }
+    if (source.hasColumns())
+        target.buildColumns();
+}
+
+#endif
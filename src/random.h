@@ -0,0 +1,52 @@
+// Counter-based random numbers for the parallel phases
+//
+// SUMMARY
+// rand() keeps one hidden state, so it cannot be called from TBB tasks, and even a per-thread generator makes the
+// results depend on how the work happened to be split across threads. A counter-based generator has no state to
+// share: the n-th number of a stream is a pure function of (seed, stream, n), computed with the SplitMix64 mixing
+// function. Any thread can draw number n, in any order, and the whole run stays reproducible for a given --seed no
+// matter how many threads there are.
+// Samir's code
+
+#ifndef KMEANS_RANDOM_H
+#define KMEANS_RANDOM_H
+
+#include <stdint.h>
+
+// One stream per use, so two phases with the same seed never see the same numbers
+enum RandomStream
+{
+    STREAM_MINIBATCH = 1, // Mini-batch sampling
+    STREAM_SEEDING = 2    // k-means++ / k-means|| seeding
+};
+
+// SplitMix64 finalizer: a bijective mix of 64 bits
+inline uint64_t splitMix64(uint64_t z)
+{
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+class CounterRng
+{
+private:
+    uint64_t key;
+
+public:
+    CounterRng(uint64_t seed, uint64_t stream) : key(splitMix64(splitMix64(seed) ^ (stream * 0x9e3779b97f4a7c15ULL))) {}
+
+    // The counter-th 64-bit number of this stream
+    inline uint64_t bits(uint64_t counter) const { return splitMix64(key + counter * 0x9e3779b97f4a7c15ULL); }
+
+    // Uniform in [0, 1), 53 random bits
+    inline double uniform(uint64_t counter) const { return (bits(counter) >> 11) * (1.0 / 9007199254740992.0); }
+
+    // Uniform in [0, n), without the bias of bits % n
+    inline int index(uint64_t counter, int n) const
+    {
+        return (int)(((unsigned __int128)bits(counter) * (uint64_t)n) >> 64);
+    }
+};
+
+#endif
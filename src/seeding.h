@@ -0,0 +1,281 @@
+// k-means++ and k-means|| seeding (Phase 1)
+//
+// SUMMARY
+// Phase 1 picks K distinct random points with rand(). Poor seeds are why 3.txt needs 177 iterations. Both methods
+// here pick seeds far away from the seeds already chosen, with probability proportional to the squared distance D(x)^2
+// to the nearest one:
+//   - k-means++ picks the K seeds one at a time, one parallel pass over the points per seed
+//   - k-means|| (Bahmani et al., "Scalable K-Means++") oversamples instead: every round keeps each point independently
+//     with probability min(1, l * D(x)^2 / total), for a handful of rounds, which gives roughly rounds * l candidates
+//     in a few passes. Each candidate is then weighted by how many points are closest to it and the candidates are
+//     reclustered down to K seeds with a weighted k-means++.
+// All randomness comes from CounterRng (random.h), and every sum is taken over fixed chunks of SEEDING_CHUNK points
+// added in chunk order, so the seeds are the same for any number of threads.
+// Samir's code
+
+#ifndef KMEANS_SEEDING_H
+#define KMEANS_SEEDING_H
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include "dimension-kernels.h"
+#include "random.h"
+
+#define SEEDING_CHUNK 4096
+#define SEEDING_OVERSAMPLING 2.0 // k-means||: l = 2K candidates per round, as in the paper
+
+// ============================================================================
+// D(x)^2 bookkeeping shared by both methods
+// ============================================================================
+
+// One chunk of updateMinDistances(): min_dist_sq[i] = min(min_dist_sq[i], ||x_i - c||^2) over the total_seeds rows of
+// seeds, and the sum of the updated distances. If nearest is given, nearest[i] also follows which seed that is
+// (first_id + its row). Instantiated per dimension count like the kernels in dimension-kernels.h.
+typedef double (*MinDistanceKernel)(const PointMatrix &points, int begin, int end, const double *seeds,
+                                    int total_seeds, double *min_dist_sq, int *nearest, int first_id);
+
+template <int D>
+inline double minDistances(const PointMatrix &points, int begin, int end, const double *seeds, int total_seeds,
+                           double *min_dist_sq, int *nearest, int first_id)
+{
+    const int total_values = D > 0 ? D : points.getTotalValues();
+    double sum = 0.0;
+    for (int i = begin; i < end; i++)
+    {
+        const double *point_values = points.row(i);
+        for (int s = 0; s < total_seeds; s++)
+        {
+            double dist_sq = squaredDistance<D>(seeds + (size_t)s * total_values, point_values, total_values);
+            if (dist_sq < min_dist_sq[i])
+            {
+                min_dist_sq[i] = dist_sq;
+                if (nearest)
+                    nearest[i] = first_id + s;
+            }
+        }
+        sum += min_dist_sq[i];
+    }
+    return sum;
+}
+
+template <int D>
+struct MinDistanceDispatch
+{
+    static MinDistanceKernel select(int total_values)
+    {
+        if (total_values == D)
+            return minDistances<D>;
+        return MinDistanceDispatch<D - 1>::select(total_values);
+    }
+};
+
+template <>
+struct MinDistanceDispatch<0>
+{
+    static MinDistanceKernel select(int) { return minDistances<0>; }
+};
+
+// Brings min_dist_sq (and nearest, if given) up to date with new_seeds; returns the new total, summed per chunk
+inline double updateMinDistances(const PointMatrix &points, const std::vector<int> &new_seeds,
+                                 std::vector<double> &min_dist_sq, std::vector<int> *nearest = nullptr,
+                                 int first_id = 0)
+{
+    const int total_points = points.getTotalPoints();
+    const int total_values = points.getTotalValues();
+    const int total_chunks = (total_points + SEEDING_CHUNK - 1) / SEEDING_CHUNK;
+    const MinDistanceKernel kernel = MinDistanceDispatch<KMEANS_MAX_FIXED_DIMENSION>::select(total_values);
+    std::vector<double> chunk_sums(total_chunks, 0.0);
+
+    // The new seeds packed next to each other, so they stay in cache while every point streams past
+    std::vector<double> seeds((size_t)new_seeds.size() * total_values);
+    for (size_t s = 0; s < new_seeds.size(); s++)
+        memcpy(seeds.data() + s * total_values, points.row(new_seeds[s]), total_values * sizeof(double));
+
+    tbb::parallel_for(0, total_chunks, [&](int chunk)
+                      {
+        int end = (chunk + 1) * SEEDING_CHUNK < total_points ? (chunk + 1) * SEEDING_CHUNK : total_points;
+        chunk_sums[chunk] = kernel(points, chunk * SEEDING_CHUNK, end, seeds.data(), (int)new_seeds.size(),
+                                   min_dist_sq.data(), nearest ? nearest->data() : nullptr, first_id); });
+
+    double total = 0.0;
+    for (int chunk = 0; chunk < total_chunks; chunk++)
+        total += chunk_sums[chunk];
+    return total;
+}
+
+// Index i with probability weights[i] / total: walks the chunk sums first, then the points of one chunk
+inline int sampleProportional(const std::vector<double> &weights, double total, double uniform)
+{
+    const int n = (int)weights.size();
+    double target = uniform * total;
+    double running = 0.0;
+
+    for (int chunk_begin = 0; chunk_begin < n; chunk_begin += SEEDING_CHUNK)
+    {
+        int chunk_end = chunk_begin + SEEDING_CHUNK < n ? chunk_begin + SEEDING_CHUNK : n;
+        double chunk_sum = 0.0;
+        for (int i = chunk_begin; i < chunk_end; i++)
+            chunk_sum += weights[i];
+
+        if (running + chunk_sum > target || chunk_end == n)
+        {
+            for (int i = chunk_begin; i < chunk_end; i++)
+            {
+                running += weights[i];
+                if (running > target && weights[i] > 0.0)
+                    return i;
+            }
+            // Rounding left us just short of the end: take the last point with any weight
+            for (int i = n - 1; i >= 0; i--)
+                if (weights[i] > 0.0)
+                    return i;
+            return 0;
+        }
+        running += chunk_sum;
+    }
+    return 0;
+}
+
+// ============================================================================
+//                              k-means++
+// ============================================================================
+// Returns the K point indexes to seed the clusters with, in the order they were picked
+
+inline std::vector<int> seedKMeansPlusPlus(const PointMatrix &points, int K, unsigned long long seed)
+{
+    const int total_points = points.getTotalPoints();
+    CounterRng rng(seed, STREAM_SEEDING);
+    std::vector<double> min_dist_sq(total_points, HUGE_VAL);
+    std::vector<int> seeds(1, rng.index(0, total_points));
+
+    double total = updateMinDistances(points, seeds, min_dist_sq);
+    while ((int)seeds.size() < K)
+    {
+        int next;
+        if (total > 0.0)
+            next = sampleProportional(min_dist_sq, total, rng.uniform(seeds.size()));
+        else
+        {
+            // Every remaining point sits on a seed already; take the first one that is not a seed itself
+            std::vector<char> chosen(total_points, 0);
+            for (size_t s = 0; s < seeds.size(); s++)
+                chosen[seeds[s]] = 1;
+            next = 0;
+            while (chosen[next])
+                next++;
+        }
+
+        std::vector<int> new_seed(1, next);
+        seeds.push_back(next);
+        total = updateMinDistances(points, new_seed, min_dist_sq);
+    }
+    return seeds;
+}
+
+// ============================================================================
+//                              k-means||
+// ============================================================================
+// rounds oversampling rounds of about oversampling * K candidates each, then a weighted k-means++ over the candidates
+
+inline std::vector<int> seedKMeansParallel(const PointMatrix &points, int K, unsigned long long seed, int rounds,
+                                           double oversampling)
+{
+    const int total_points = points.getTotalPoints();
+    const int total_values = points.getTotalValues();
+    const int total_chunks = (total_points + SEEDING_CHUNK - 1) / SEEDING_CHUNK;
+    CounterRng rng(seed, STREAM_SEEDING);
+    const double l = oversampling * K;
+
+    // Counters of the stream: 0 picks the first candidate, then one block of total_points per round for the coin
+    // flips, then the weighted reclustering
+    std::vector<int> candidates(1, rng.index(0, total_points));
+    std::vector<char> is_candidate(total_points, 0);
+    is_candidate[candidates[0]] = 1;
+    std::vector<double> min_dist_sq(total_points, HUGE_VAL);
+    std::vector<int> nearest(total_points, 0); // Closest candidate so far, which is all Step 2 needs
+    double total = updateMinDistances(points, candidates, min_dist_sq, &nearest, 0);
+
+    // Step 1: oversampling rounds, each point flips its own coin
+    for (int round = 0; round < rounds && total > 0.0; round++)
+    {
+        std::vector<std::vector<int>> chunk_picks(total_chunks);
+        tbb::parallel_for(0, total_chunks, [&](int chunk)
+                          {
+            int end = (chunk + 1) * SEEDING_CHUNK < total_points ? (chunk + 1) * SEEDING_CHUNK : total_points;
+            for (int i = chunk * SEEDING_CHUNK; i < end; i++)
+            {
+                if (is_candidate[i])
+                    continue;
+                double probability = l * min_dist_sq[i] / total;
+                if (rng.uniform(1 + (uint64_t)round * total_points + i) < probability)
+                    chunk_picks[chunk].push_back(i);
+            } });
+
+        // Concatenated in chunk order, so the candidate list does not depend on the thread count
+        std::vector<int> new_candidates;
+        for (int chunk = 0; chunk < total_chunks; chunk++)
+            new_candidates.insert(new_candidates.end(), chunk_picks[chunk].begin(), chunk_picks[chunk].end());
+        for (size_t c = 0; c < new_candidates.size(); c++)
+            is_candidate[new_candidates[c]] = 1;
+        int first_id = (int)candidates.size();
+        candidates.insert(candidates.end(), new_candidates.begin(), new_candidates.end());
+
+        total = updateMinDistances(points, new_candidates, min_dist_sq, &nearest, first_id);
+    }
+
+    // Too few distinct points to oversample from: k-means++ on the whole dataset does the rest
+    if ((int)candidates.size() <= K)
+        return (int)candidates.size() == K ? candidates : seedKMeansPlusPlus(points, K, seed);
+
+    // Step 2: weight each candidate by the number of points closest to it. The rounds already tracked the closest
+    // candidate of every point, so this is a count, not another pass over all the candidates.
+    const int total_candidates = (int)candidates.size();
+    std::vector<double> weights(total_candidates, 0.0);
+    for (int i = 0; i < total_points; i++)
+        weights[nearest[i]] += 1.0;
+
+    // Step 3: weighted k-means++ over the candidates (a few thousand at most, so serially)
+    uint64_t counter = 1 + (uint64_t)rounds * total_points;
+    std::vector<int> picked(1, sampleProportional(weights, (double)total_points, rng.uniform(counter++)));
+    std::vector<double> candidate_dist_sq(total_candidates, HUGE_VAL);
+    std::vector<double> scores(total_candidates, 0.0);
+
+    while ((int)picked.size() < K)
+    {
+        const double *last = points.row(candidates[picked.back()]);
+        double score_total = 0.0;
+        for (int c = 0; c < total_candidates; c++)
+        {
+            double dist_sq = squaredDistance<0>(last, points.row(candidates[c]), total_values);
+            if (dist_sq < candidate_dist_sq[c])
+                candidate_dist_sq[c] = dist_sq;
+            scores[c] = weights[c] * candidate_dist_sq[c];
+            score_total += scores[c];
+        }
+
+        int next;
+        if (score_total > 0.0)
+            next = sampleProportional(scores, score_total, rng.uniform(counter++));
+        else
+        {
+            // The remaining weight sits on picked candidates; candidates are distinct points, so take an unpicked one
+            std::vector<char> used(total_candidates, 0);
+            for (size_t p = 0; p < picked.size(); p++)
+                used[picked[p]] = 1;
+            next = 0;
+            while (used[next])
+                next++;
+        }
+        picked.push_back(next);
+    }
+
+    std::vector<int> seeds(K);
+    for (int k = 0; k < K; k++)
+        seeds[k] = candidates[picked[k]];
+    return seeds;
+}
+
+#endif
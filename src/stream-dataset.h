@@ -0,0 +1,523 @@
+// Out-of-core access to a dataset, one bounded chunk of points at a time
+//
+// SUMMARY
+// The loaders put the whole dataset in memory before Phase 1, so the largest dataset we can cluster is the one whose
+// point matrix (plus its column-major copy) fits in RAM. With --stream=MB, parallel.cpp keeps the dataset on disk
+// instead and every pass over the points (the seeding pass and each Lloyd iteration) reads it front to back through
+// StreamingDataset:
+//   - stdin must be a regular file (`< dataset`), since every pass reads it again with pread()
+//   - text datasets are read in blocks and parsed like text-loader.h does (token by token, split into sub-chunks that
+//     TBB parses in parallel, same values bit for bit, short datasets padded with zero points); binary datasets
+//     (binary-dataset.h) are read from the row section, or column by column when the file has none
+//   - two chunks are kept: while the kernels work on one, the next one is read on a separate thread (double
+//     buffering), so the disk and the cores are busy at the same time
+//   - each point's cluster lives in a labels side file (--labels=FILE, or an unlinked temporary file): total_points
+//     int32 cluster numbers in the machine's byte order, -1 for unassigned, read and written back chunk by chunk
+// The MB budget covers both chunks (rows, column-major copy, labels, read buffers); the chunk size is derived from it,
+// with at least STREAM_MIN_CHUNK_POINTS points per chunk. Binary datasets are much cheaper to stream than text ones,
+// whose every pass has to parse the digits again.
+// Samir's code
+
+#ifndef KMEANS_STREAM_DATASET_H
+#define KMEANS_STREAM_DATASET_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <tbb/parallel_for.h>
+#include "binary-dataset.h"
+#include "point-matrix.h"
+#include "text-loader.h"
+
+#define STREAM_MIN_CHUNK_POINTS 1024
+#define STREAM_LABEL_BLOCK 65536 // Labels written per call when the labels file is initialized
+
+// pread() until bytes are read or the file ends; returns the bytes read, or -1 on an error
+inline ssize_t preadFully(int fd, void *buffer, size_t bytes, uint64_t offset)
+{
+    size_t done = 0;
+    while (done < bytes)
+    {
+        ssize_t got = pread(fd, (char *)buffer + done, bytes - done, offset + done);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got < 0)
+            return -1;
+        if (got == 0)
+            break;
+        done += got;
+    }
+    return done;
+}
+
+inline bool pwriteFully(int fd, const void *buffer, size_t bytes, uint64_t offset)
+{
+    size_t done = 0;
+    while (done < bytes)
+    {
+        ssize_t put = pwrite(fd, (const char *)buffer + done, bytes - done, offset + done);
+        if (put < 0 && errno == EINTR)
+            continue;
+        if (put <= 0)
+            return false;
+        done += put;
+    }
+    return true;
+}
+
+// One of the two buffers a pass alternates between
+struct StreamChunk
+{
+    PointMatrix points;             // Rows, column-major copy and labels (the assignments) of the chunk's points
+    int first;                      // Dataset index of the chunk's first point
+    int count;                      // Points in the chunk; 0 marks the end of the pass
+    std::vector<char> text;         // Text: raw bytes, starting with what the previous chunk left unparsed
+    size_t text_bytes;              // Text: bytes of text in use
+    bool text_eof;                  // Text: the read that filled text reached the end of the file
+    std::vector<char> column_bytes; // Binary without rows: each column's stretch of the chunk, as stored
+
+    StreamChunk() : first(0), count(0), text_bytes(0), text_eof(false) {}
+};
+
+// ============================================================================
+//                              StreamingDataset Class
+// ============================================================================
+class StreamingDataset
+{
+private:
+    int fd;                       // The dataset (stdin)
+    DatasetHeader header;
+    bool binary;
+    BinaryDatasetHeader binary_header;
+    uint64_t file_size;
+    uint64_t body_offset;         // Text: first byte after the header
+    int per_point;                // Text: tokens per point (values, plus the name)
+    int chunk_points;             // Points per chunk
+    size_t text_capacity;         // Text: bytes per chunk buffer
+    size_t budget;                // The --stream budget in bytes
+    StreamChunk chunks[2];
+
+    int next_point;               // First point of the next chunk of this pass
+    uint64_t text_offset;         // Text: next byte to read
+    bool ended;                   // Text: the data ran out (end of file or not a number) before total_points
+    bool warned;                  // The short-dataset warning was printed (first pass only)
+
+    int labels_fd;
+    std::string labels_path;      // Empty for the unlinked temporary file
+
+    long long passes;
+    long long chunks_read;
+    double io_wait;               // Microseconds the compute side waited for a read, over all passes
+    uint64_t bytes_read;
+
+    // Text header: five integers at the start of the file
+    bool readTextHeader()
+    {
+        char block[4096];
+        ssize_t got = preadFully(fd, block, sizeof(block), 0);
+        if (got <= 0)
+            return false;
+        const char *p = block, *end = block + got, *token_begin;
+        int *fields[5] = {&header.total_points, &header.total_values, &header.K, &header.max_iterations, &header.has_name};
+        for (int f = 0; f < 5; f++)
+            if (!nextToken(p, end, token_begin) || !parseHeaderInt(token_begin, p, *fields[f]))
+                return false;
+        body_offset = p - block;
+        return header.total_points >= 0 && header.total_values > 0;
+    }
+
+    bool readBinaryHeader()
+    {
+        if (preadFully(fd, &binary_header, sizeof(binary_header), 0) != (ssize_t)sizeof(binary_header) ||
+            binary_header.version != BINARY_DATASET_VERSION ||
+            (binary_header.value_bytes != 8 && binary_header.value_bytes != 4) || binary_header.total_points < 0 ||
+            binary_header.total_values <= 0)
+            return false;
+        header.total_points = binary_header.total_points;
+        header.total_values = binary_header.total_values;
+        header.K = binary_header.K;
+        header.max_iterations = binary_header.max_iterations;
+        header.has_name = binary_header.has_name;
+        return true;
+    }
+
+    // Binary: the next chunk_points points straight from the row section, or from every column block, with their
+    // column-major copy (built here, on the reader thread, so it overlaps with the kernels too)
+    bool fetchBinary(StreamChunk &chunk)
+    {
+        chunk.first = next_point;
+        chunk.count = std::min(chunk_points, header.total_points - next_point);
+        next_point += chunk.count;
+        if (chunk.count == 0)
+            return true;
+
+        const int total_values = header.total_values;
+        if (binary_header.rows_offset && binary_header.value_bytes == 8)
+        {
+            size_t bytes = (size_t)chunk.count * total_values * sizeof(double);
+            bytes_read += bytes;
+            if (preadFully(fd, chunk.points.row(0), bytes, binary_header.rows_offset + (uint64_t)chunk.first * total_values * sizeof(double)) != (ssize_t)bytes)
+                return false;
+            chunk.points.buildColumns();
+            return true;
+        }
+
+        const size_t value_bytes = binary_header.value_bytes;
+        const size_t bytes = (size_t)chunk.count * value_bytes;
+        for (int j = 0; j < total_values; j++)
+        {
+            uint64_t offset = binary_header.columns_offset + ((uint64_t)j * binary_header.column_stride + chunk.first) * value_bytes;
+            if (preadFully(fd, chunk.column_bytes.data() + j * bytes, bytes, offset) != (ssize_t)bytes)
+                return false;
+        }
+        bytes_read += bytes * total_values;
+        for (int i = 0; i < chunk.count; i++)
+            for (int j = 0; j < total_values; j++)
+            {
+                const char *value = chunk.column_bytes.data() + j * bytes + i * value_bytes;
+                if (value_bytes == 8)
+                    memcpy(chunk.points.row(i) + j, value, sizeof(double));
+                else
+                {
+                    float narrow;
+                    memcpy(&narrow, value, sizeof(float));
+                    chunk.points.row(i)[j] = narrow;
+                }
+            }
+        chunk.points.buildColumns();
+        return true;
+    }
+
+    // Text: fill the rest of the chunk's buffer from the file
+    bool fetchText(StreamChunk &chunk)
+    {
+        if (ended)
+        {
+            chunk.text_eof = true;
+            return true;
+        }
+        if (chunk.text.size() < text_capacity)
+            chunk.text.resize(text_capacity);
+        size_t wanted = chunk.text.size() - chunk.text_bytes;
+        ssize_t got = preadFully(fd, chunk.text.data() + chunk.text_bytes, wanted, text_offset);
+        if (got < 0)
+            return false;
+        chunk.text_bytes += got;
+        text_offset += got;
+        bytes_read += got;
+        chunk.text_eof = text_offset >= file_size;
+        return true;
+    }
+
+    // Text: parse the chunk's buffer into its points (in parallel, like the loader) and hand the unparsed rest to next
+    bool decodeText(StreamChunk &chunk, StreamChunk &next)
+    {
+        const int total_values = header.total_values;
+        chunk.first = next_point;
+        int wanted = std::min(chunk_points, header.total_points - next_point);
+        next.text_bytes = 0;
+        if (wanted == 0 || ended)
+        {
+            // Past the end of a short dataset every point is zero, like the loader makes them
+            chunk.count = wanted;
+            if (wanted > 0)
+                memset(chunk.points.row(0), 0, (size_t)wanted * total_values * sizeof(double));
+            next_point += wanted;
+            return true;
+        }
+
+        for (;;)
+        {
+            const char *begin = chunk.text.data(), *end = begin + chunk.text_bytes;
+
+            // A token cut off by the end of the buffer waits for the next chunk; sub-chunks for the parallel passes
+            const char *cut = end;
+            if (!chunk.text_eof)
+                while (cut > begin && !isBlank(cut[-1]))
+                    cut--;
+            std::vector<const char *> bounds(1, begin);
+            while (bounds.back() < cut)
+            {
+                const char *bound = cut - bounds.back() > LOADER_CHUNK_BYTES ? bounds.back() + LOADER_CHUNK_BYTES : cut;
+                while (bound < cut && !isBlank(*bound))
+                    bound++;
+                bounds.push_back(bound);
+            }
+            const int sub_chunks = (int)bounds.size() - 1;
+
+            // Pass 1: tokens per sub-chunk
+            std::vector<long long> first_token(sub_chunks + 1, 0);
+            tbb::parallel_for(0, sub_chunks, [&](int s)
+                              {
+                const char *q = bounds[s], *token_begin;
+                long long count = 0;
+                while (nextToken(q, bounds[s + 1], token_begin))
+                    count++;
+                first_token[s + 1] = count; });
+            for (int s = 0; s < sub_chunks; s++)
+                first_token[s + 1] += first_token[s];
+            const long long tokens = first_token[sub_chunks];
+
+            // How many points this buffer completes
+            long long used = (long long)wanted * per_point;
+            int points_here = wanted;
+            bool runs_out = false;
+            if (tokens < used && chunk.text_eof)
+            {
+                used = tokens;
+                runs_out = true;
+            }
+            else if (tokens < used)
+            {
+                points_here = (int)(tokens / per_point);
+                used = (long long)points_here * per_point;
+                if (points_here == 0)
+                {
+                    // Not even one point fits: grow the buffers and read more now
+                    text_capacity *= 2;
+                    next.text.resize(text_capacity);
+                    if (!fetchText(chunk))
+                        return false;
+                    continue;
+                }
+            }
+
+            // Pass 2: parse the tokens of the complete points; each sub-chunk remembers its first non-number
+            std::vector<long long> first_bad(sub_chunks, used);
+            tbb::parallel_for(0, sub_chunks, [&](int s)
+                              {
+                const char *q = bounds[s], *token_begin;
+                for (long long t = first_token[s]; t < used && nextToken(q, bounds[s + 1], token_begin); t++)
+                {
+                    int field = (int)(t % per_point);
+                    if (field < total_values && !parseDouble(token_begin, q, chunk.points.row((int)(t / per_point))[field]))
+                    {
+                        first_bad[s] = t;
+                        break;
+                    }
+                } });
+            long long good = used;
+            for (int s = 0; s < sub_chunks; s++)
+                good = std::min(good, first_bad[s]);
+
+            if (runs_out || good < used)
+            {
+                // The data ends inside this chunk: the incomplete point and everything after it are zero
+                int complete = (int)(good / per_point);
+                memset(chunk.points.row(complete), 0, (size_t)(points_here - complete) * total_values * sizeof(double));
+                ended = true;
+                if (!warned)
+                    std::cerr << "Warning: dataset ended after " << chunk.first + complete << " of " << header.total_points
+                              << " points, the remaining points are zero" << std::endl;
+                warned = true;
+            }
+            else if (used > 0)
+            {
+                // Everything after the last token used goes to the next chunk
+                int s = 0;
+                while (first_token[s + 1] < used)
+                    s++;
+                const char *q = bounds[s], *token_begin;
+                for (long long t = first_token[s]; t < used; t++)
+                    nextToken(q, bounds[s + 1], token_begin);
+                next.text_bytes = end - q;
+                if (next.text.size() < std::max(text_capacity, next.text_bytes))
+                    next.text.resize(std::max(text_capacity, next.text_bytes));
+                memcpy(next.text.data(), q, next.text_bytes);
+            }
+
+            chunk.count = points_here;
+            next_point += points_here;
+            return true;
+        }
+    }
+
+public:
+    StreamingDataset() : fd(-1), binary(false), file_size(0), body_offset(0), per_point(0), chunk_points(0),
+                         text_capacity(0), budget(0), next_point(0), text_offset(0), ended(false), warned(false),
+                         labels_fd(-1), passes(0), chunks_read(0), io_wait(0), bytes_read(0)
+    {
+        memset(&header, 0, sizeof(header));
+        memset(&binary_header, 0, sizeof(binary_header));
+    }
+
+    ~StreamingDataset()
+    {
+        if (labels_fd >= 0)
+            close(labels_fd);
+    }
+
+    // Reads the header from fd (which must be a regular file), sizes the chunks to budget_bytes and creates the
+    // labels file with every point unassigned. Returns false after saying why.
+    bool open(int input, size_t budget_bytes, const std::string &labels)
+    {
+        fd = input;
+        budget = budget_bytes;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode))
+        {
+            std::cerr << "Error: --stream reads the dataset once per iteration, so stdin must be a file (< dataset)" << std::endl;
+            return false;
+        }
+        file_size = info.st_size;
+
+        char magic[8] = {0};
+        binary = preadFully(fd, magic, sizeof(magic), 0) == (ssize_t)sizeof(magic) && isBinaryDataset(magic, magic + 8);
+        if (binary ? !readBinaryHeader() : !readTextHeader())
+        {
+            std::cerr << "Error: malformed dataset header on standard input" << std::endl;
+            return false;
+        }
+        per_point = header.total_values + (header.has_name ? 1 : 0);
+
+        // Bytes one point costs in a chunk (rows, columns, label, read buffer), times the two chunks
+        const int total_values = header.total_values;
+        double text_per_point = binary ? 0.0 : (double)(file_size - body_offset) / std::max(1, header.total_points) * 1.25 + 16;
+        bool columns_only = binary && !(binary_header.rows_offset && binary_header.value_bytes == 8);
+        double per_point_bytes = 2 * (2.0 * total_values * sizeof(double) + sizeof(int32_t) + text_per_point +
+                                      (columns_only ? (double)total_values * binary_header.value_bytes : 0.0));
+        long long points = (long long)(budget / per_point_bytes);
+        long long padded_total = ((long long)header.total_points + PointMatrix::COLUMN_PADDING - 1) /
+                                 PointMatrix::COLUMN_PADDING * PointMatrix::COLUMN_PADDING;
+        points = std::min(std::max(points, (long long)STREAM_MIN_CHUNK_POINTS), std::max(padded_total, (long long)PointMatrix::COLUMN_PADDING));
+        chunk_points = (int)(points / PointMatrix::COLUMN_PADDING * PointMatrix::COLUMN_PADDING);
+        text_capacity = (size_t)(chunk_points * text_per_point);
+        for (int c = 0; c < 2; c++)
+        {
+            chunks[c].points.reset(chunk_points, total_values);
+            if (columns_only)
+                chunks[c].column_bytes.resize((size_t)chunk_points * total_values * binary_header.value_bytes);
+        }
+
+        // Labels: every point unassigned
+        labels_path = labels;
+        if (labels.empty())
+        {
+            char labels_template[] = "/tmp/kmeans-labels-XXXXXX";
+            labels_fd = mkstemp(labels_template);
+            if (labels_fd >= 0)
+                unlink(labels_template);
+        }
+        else
+            labels_fd = ::open(labels.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (labels_fd < 0)
+        {
+            std::cerr << "Error: could not create the labels file " << labels << ": " << strerror(errno) << std::endl;
+            return false;
+        }
+        std::vector<int32_t> unassigned(STREAM_LABEL_BLOCK, -1);
+        for (int first = 0; first < header.total_points; first += STREAM_LABEL_BLOCK)
+        {
+            size_t count = std::min(STREAM_LABEL_BLOCK, header.total_points - first);
+            if (!pwriteFully(labels_fd, unassigned.data(), count * sizeof(int32_t), (uint64_t)first * sizeof(int32_t)))
+            {
+                std::cerr << "Error: could not write the labels file: " << strerror(errno) << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    inline const DatasetHeader &getHeader() const { return header; }
+    inline int getChunkPoints() const { return chunk_points; }
+
+    // Reads the next chunk of this pass into chunk: I/O, plus for binary datasets the float widening and the column-major
+    // copy. Runs on the reader thread while the previous chunk is being clustered.
+    bool fetch(StreamChunk &chunk)
+    {
+        return binary ? fetchBinary(chunk) : fetchText(chunk);
+    }
+
+    // Text: parses what fetch() read into the chunk's rows and columns, and leaves the unparsed bytes in next, which
+    // must not be fetched into before this returns. Runs on the calling thread, with the parsing in parallel.
+    bool decode(StreamChunk &chunk, StreamChunk &next)
+    {
+        if (binary)
+            return true;
+        if (!decodeText(chunk, next))
+            return false;
+        if (chunk.count > 0)
+            chunk.points.buildColumns();
+        return true;
+    }
+
+    // ========================================================================
+    // One sequential pass over the dataset: body(chunk) for every chunk in order, with the labels of the chunk's
+    // points in chunk.points.getAssignments(). The next chunk is read on another thread while body runs.
+    // ========================================================================
+    template <typename Body>
+    bool pass(const Body &body)
+    {
+        next_point = 0;
+        text_offset = body_offset;
+        ended = false;
+        for (int c = 0; c < 2; c++)
+            chunks[c].text_bytes = 0;
+        passes++;
+
+        int current = 0;
+        std::future<bool> pending = std::async(std::launch::async, [this]()
+                                               { return fetch(chunks[0]); });
+        for (;;)
+        {
+            auto wait_start = std::chrono::high_resolution_clock::now();
+            bool fetched = pending.get();
+            io_wait += std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - wait_start).count();
+            StreamChunk &chunk = chunks[current], &next = chunks[1 - current];
+            if (!fetched || !decode(chunk, next))
+            {
+                std::cerr << "Error: could not read the dataset: " << strerror(errno) << std::endl;
+                return false;
+            }
+            if (chunk.count == 0)
+                return true;
+            chunks_read++;
+
+            pending = std::async(std::launch::async, [this, &next]()
+                                 { return fetch(next); });
+            size_t label_bytes = (size_t)chunk.count * sizeof(int32_t);
+            if (preadFully(labels_fd, chunk.points.getAssignments(), label_bytes, (uint64_t)chunk.first * sizeof(int32_t)) != (ssize_t)label_bytes)
+            {
+                pending.wait();
+                std::cerr << "Error: could not read the labels file" << std::endl;
+                return false;
+            }
+            body(chunk);
+            current = 1 - current;
+        }
+    }
+
+    // Writes the chunk's labels back; pass bodies call this after changing them
+    bool writeLabels(StreamChunk &chunk)
+    {
+        return pwriteFully(labels_fd, chunk.points.getAssignments(), (size_t)chunk.count * sizeof(int32_t),
+                           (uint64_t)chunk.first * sizeof(int32_t));
+    }
+
+    bool writeLabel(int point, int32_t label)
+    {
+        return pwriteFully(labels_fd, &label, sizeof(label), (uint64_t)point * sizeof(int32_t));
+    }
+
+    // "text, 13611 points per chunk (2 chunks, 64 MB budget), 178 passes of 2 chunks, 12.3 MB read per pass, ..."
+    void describe(std::ostream &out) const
+    {
+        out << (binary ? "binary" : "text") << ", " << chunk_points << " points per chunk (2 chunks, " << (budget >> 20)
+            << " MB budget), " << passes << " passes of " << (passes > 0 ? chunks_read / passes : 0) << " chunks, "
+            << (passes > 0 ? bytes_read / passes / 1e6 : 0.0) << " MB read per pass, " << (long long)io_wait
+            << " µs waiting for reads, labels in " << (labels_path.empty() ? "a temporary file" : labels_path);
+    }
+};
+
+#endif
@@ -0,0 +1,415 @@
+// Memory-mapped text dataset loader
+//
+// SUMMARY
+// The old stream reader pulled every value through `cin >>`, one locale-aware stream extraction per double, and on
+// 7.txt/8.txt (20 MB each) that took longer than all of Phase 2 without ever showing up in a timing. This loader maps
+// the dataset (or, when stdin is a pipe, reads it in one go), splits the body into chunks on whitespace boundaries and
+// parses the chunks independently, straight into the point matrix:
+//   1. count the tokens of every chunk
+//   2. prefix-sum the counts, so every chunk knows the global index of its first token
+//   3. parse every chunk: token t is value t % per_point of point t / per_point (per_point = total_values, plus one
+//      for the name when the header says has_name)
+// Steps 1 and 3 are loops over chunks; the serial variants run them in order, parallel-text-loader.h hands them to TBB,
+// and load-pipeline.h runs step 3 as a pipeline that clusters each chunk as soon as it is parsed.
+// Going by tokens rather than lines keeps the exact semantics of the old `cin >>` loop, which matters because some of
+// our datasets have short lines (157 lines of 8.txt are missing a value) and the reference centroids were computed by
+// reading straight through them.
+// parseDouble() uses Clinger's fast path: a mantissa below 2^53 and a power of ten below 10^23 is one exact multiply or
+// divide, which IEEE rounding makes correctly rounded. Longer mantissas (up to 19 digits, with up to 19 decimals) are
+// one 128-bit integer division rounded by hand. Everything else goes to strtod(), so every value is bit-identical to
+// what `cin >>` produced.
+// Input that starts with the binary dataset magic is not parsed at all but handed to binary-dataset.h, so every variant
+// takes either format on stdin.
+// Samir's code
+
+#ifndef KMEANS_TEXT_LOADER_H
+#define KMEANS_TEXT_LOADER_H
+
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "binary-dataset.h"
+#include "mapped-input.h"
+#include "point-matrix.h"
+
+#define LOADER_CHUNK_BYTES (256 * 1024)
+
+// ============================================================================
+// Tokens and numbers
+// ============================================================================
+
+// Same set as isspace() in the C locale, which is what `cin >>` skips
+inline bool isBlank(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+}
+
+// isBlank() as 0 or 1 without branches: ' ', or '\t' to '\r'
+inline int isBlankByte(unsigned char c)
+{
+    return (c == ' ') | ((unsigned char)(c - '\t') < 5);
+}
+
+// Next whitespace-separated token in [p, end): returns false when there is none, otherwise sets [token, p)
+inline bool nextToken(const char *&p, const char *end, const char *&token)
+{
+    while (p < end && isBlank(*p))
+        p++;
+    if (p == end)
+        return false;
+    token = p;
+    while (p < end && !isBlank(*p))
+        p++;
+    return true;
+}
+
+// Slow path: strtod() on a NUL-terminated copy, with the checks `cin >>` makes on top of it
+inline bool parseDoubleSlow(const char *begin, const char *end, double &value)
+{
+    // num_get only ever collects signs, digits, the decimal point and exponent markers (no inf, nan or hex)
+    for (const char *p = begin; p < end; p++)
+        if (!((*p >= '0' && *p <= '9') || *p == '.' || *p == '-' || *p == '+' || *p == 'e' || *p == 'E'))
+            return false;
+
+    // Numbers fit in a stack buffer; only absurdly long tokens pay for a heap copy
+    char stack_copy[64];
+    std::string heap_copy;
+    size_t length = end - begin;
+    const char *copy = stack_copy;
+    if (length < sizeof(stack_copy))
+    {
+        memcpy(stack_copy, begin, length);
+        stack_copy[length] = '\0';
+    }
+    else
+    {
+        heap_copy.assign(begin, end);
+        copy = heap_copy.c_str();
+    }
+
+    char *parsed_end = nullptr;
+    errno = 0;
+    value = strtod(copy, &parsed_end);
+    if (length == 0 || parsed_end != copy + length)
+        return false;
+    if (errno == ERANGE && (value == HUGE_VAL || value == -HUGE_VAL)) // Overflow sets failbit on the stream
+        return false;
+    return true;
+}
+
+// mantissa * 10^exponent correctly rounded, for any mantissa and -19 <= exponent <= 0 (so 10^-exponent fits in 64 bits):
+// the mantissa is shifted up so the 128-bit quotient keeps at least 63 bits, and that is rounded to 53 bits exactly
+// once, half to even, with the remainder of the division as the sticky bit
+inline double divideExact(uint64_t mantissa, int exponent)
+{
+    static const uint64_t powers_of_ten[20] = {1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+                                               10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+                                               100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+                                               100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+                                               100000000000000000ULL, 1000000000000000000ULL,
+                                               10000000000000000000ULL};
+    if (mantissa == 0)
+        return 0.0;
+
+    int shift = __builtin_clzll(mantissa) + 63; // numerator < 2^127
+    unsigned __int128 numerator = (unsigned __int128)mantissa << shift;
+    uint64_t divisor = powers_of_ten[-exponent];
+    unsigned __int128 quotient = numerator / divisor;
+    bool sticky = numerator % divisor != 0;
+
+    uint64_t high = (uint64_t)(quotient >> 64);
+    int bits = high ? 128 - __builtin_clzll(high) : 64 - __builtin_clzll((uint64_t)quotient);
+    int drop = bits - 53; // At least 10, since the quotient has at least 63 bits
+    uint64_t top = (uint64_t)(quotient >> drop);
+    unsigned __int128 rest = quotient & (((unsigned __int128)1 << drop) - 1);
+    unsigned __int128 half = (unsigned __int128)1 << (drop - 1);
+    if (rest > half || (rest == half && (sticky || (top & 1))))
+        top++;
+    return ldexp((double)top, drop - shift); // top <= 2^53, so the conversion is exact
+}
+
+// The whole of [begin, end) as a double, bit-identical to `cin >> value`; false if it is not a number
+inline bool parseDouble(const char *begin, const char *end, double &value)
+{
+    static const double powers_of_ten[23] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                             1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    const char *p = begin;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    uint64_t mantissa = 0;
+    int significant_digits = 0, exponent = 0;
+    bool any_digit = false, truncated = false;
+
+    for (; p < end && *p >= '0' && *p <= '9'; p++)
+    {
+        any_digit = true;
+        if (significant_digits < 19)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            significant_digits += mantissa != 0;
+        }
+        else
+        {
+            exponent++;
+            truncated |= *p != '0';
+        }
+    }
+    if (p < end && *p == '.')
+    {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++)
+        {
+            any_digit = true;
+            if (significant_digits < 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                significant_digits += mantissa != 0;
+                exponent--;
+            }
+            else
+                truncated |= *p != '0';
+        }
+    }
+
+    // Exponents, dropped digits and anything unusual take the slow path
+    if (p != end || !any_digit || truncated)
+        return parseDoubleSlow(begin, end, value);
+
+    if (mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22)
+        value = exponent >= 0 ? (double)mantissa * powers_of_ten[exponent] : (double)mantissa / powers_of_ten[-exponent];
+    else if (exponent >= -19 && exponent <= 0)
+        value = divideExact(mantissa, exponent); // 16-19 significant digits, like most of 8.txt
+    else
+        return parseDoubleSlow(begin, end, value);
+    if (negative)
+        value = -value;
+    return true;
+}
+
+// Whole int for the header fields, like `cin >> int`
+inline bool parseHeaderInt(const char *begin, const char *end, int &value)
+{
+    std::string copy(begin, end);
+    char *parsed_end = nullptr;
+    errno = 0;
+    long parsed = strtol(copy.c_str(), &parsed_end, 10);
+    if (copy.empty() || parsed_end != copy.c_str() + copy.size() || errno != 0 || parsed < -0x7fffffffL - 1 ||
+        parsed > 0x7fffffffL)
+        return false;
+    value = (int)parsed;
+    return true;
+}
+
+// ============================================================================
+//                              Chunk loops
+// ============================================================================
+// loadPointMatrix() only needs "call body(chunk) for every chunk in [0, total_chunks)", with the chunks in any order
+// and on any thread. This one runs them in order on the calling thread.
+
+struct SerialChunkLoop
+{
+    template <typename Body>
+    void operator()(int total_chunks, const Body &body) const
+    {
+        for (int chunk = 0; chunk < total_chunks; chunk++)
+            body(chunk);
+    }
+};
+
+// ============================================================================
+//                              TextDatasetParser Class
+// ============================================================================
+// The steps of loading one text dataset: header, chunk bounds, token counts, then the chunks themselves. Each chunk is
+// parsed independently once the counts are known, so loadPointMatrix() runs every step back to back and
+// load-pipeline.h interleaves the parsing with the first iteration instead.
+
+class TextDatasetParser
+{
+private:
+    int total_points;
+    int total_values;
+    bool has_name;
+    int per_point;                       // Tokens per point: the values, plus the name when there is one
+    long long needed_tokens;             // total_points * per_point
+    std::vector<const char *> bounds;    // Chunk c is [bounds[c], bounds[c + 1])
+    std::vector<long long> first_token;  // Global index of the first token of every chunk, then the total
+    std::vector<long long> first_bad;    // First token of every chunk that is not a number, needed_tokens if none
+
+public:
+    // Header: five integers. Then the chunk boundaries, each moved forward to the next whitespace so no token is split
+    bool readHeader(const char *p, const char *end, DatasetHeader &header)
+    {
+        int *fields[5] = {&header.total_points, &header.total_values, &header.K, &header.max_iterations, &header.has_name};
+        for (int f = 0; f < 5; f++)
+        {
+            const char *token_begin;
+            if (!nextToken(p, end, token_begin) || !parseHeaderInt(token_begin, p, *fields[f]))
+                return false;
+        }
+        if (header.total_points < 0 || header.total_values <= 0)
+            return false;
+
+        total_points = header.total_points;
+        total_values = header.total_values;
+        has_name = header.has_name != 0;
+        per_point = total_values + (has_name ? 1 : 0);
+        needed_tokens = (long long)total_points * per_point;
+
+        bounds.assign(1, p);
+        while (bounds.back() < end)
+        {
+            const char *next = end - bounds.back() > LOADER_CHUNK_BYTES ? bounds.back() + LOADER_CHUNK_BYTES : end;
+            while (next < end && !isBlank(*next))
+                next++;
+            bounds.push_back(next);
+        }
+        first_token.assign(bounds.size(), 0);
+        first_bad.assign(bounds.size() - 1, needed_tokens);
+        return true;
+    }
+
+    inline int getTotalChunks() const { return (int)bounds.size() - 1; }
+    inline int getPerPoint() const { return per_point; }
+    inline long long getFirstToken(int chunk) const { return first_token[chunk]; }
+    inline long long getFirstBad(int chunk) const { return first_bad[chunk]; } // After parseChunk(chunk)
+
+    // Pass 1: tokens of one chunk. Every chunk must be counted, then sumCounts() called, before anything is parsed.
+    // A token starts wherever a blank is followed by anything else; counting those without branches lets the
+    // compiler vectorize the loop, which made pass 1 about 3x faster than walking nextToken().
+    void countChunk(int chunk)
+    {
+        const unsigned char *q = (const unsigned char *)bounds[chunk];
+        const long long length = bounds[chunk + 1] - bounds[chunk];
+        long long count = length > 0 && !isBlankByte(q[0]);
+        for (long long i = 1; i < length; i++)
+            count += isBlankByte(q[i - 1]) & !isBlankByte(q[i]);
+        first_token[chunk + 1] = count;
+    }
+
+    void sumCounts()
+    {
+        for (int chunk = 0; chunk < getTotalChunks(); chunk++)
+            first_token[chunk + 1] += first_token[chunk];
+    }
+
+    // Pass 2: parse one chunk into the matrix; the chunk remembers the first token that is not a number
+    void parseChunk(int chunk, PointMatrix &points)
+    {
+        const char *q = bounds[chunk], *token_begin;
+        for (long long t = first_token[chunk]; t < needed_tokens && nextToken(q, bounds[chunk + 1], token_begin); t++)
+        {
+            int point = (int)(t / per_point), field = (int)(t % per_point);
+            if (field < total_values)
+            {
+                if (!parseDouble(token_begin, q, points.row(point)[field]))
+                {
+                    first_bad[chunk] = t;
+                    break;
+                }
+            }
+            else
+                points.setName(point, std::string(token_begin, q));
+        }
+    }
+
+    // Points that precede the first bad or missing token among chunks [0, chunks), which must all have been parsed
+    int completePoints(int chunks) const
+    {
+        long long good_tokens = first_token[chunks] < needed_tokens ? first_token[chunks] : needed_tokens;
+        for (int chunk = 0; chunk < chunks; chunk++)
+            if (first_bad[chunk] < good_tokens)
+                good_tokens = first_bad[chunk];
+        return (int)(good_tokens / per_point);
+    }
+
+    // The values of one point, found through the token counts and parsed on their own (the same way parseChunk()
+    // would). false if one of them is missing or not a number.
+    bool parsePoint(int point, double *values) const
+    {
+        if (point >= total_points)
+            return false;
+        long long t = (long long)point * per_point;
+        int chunk = (int)(std::upper_bound(first_token.begin(), first_token.end(), t) - first_token.begin()) - 1;
+        if (chunk >= getTotalChunks())
+            return false;
+        const char *q = bounds[chunk], *token_begin;
+        for (long long skip = t - first_token[chunk]; skip > 0; skip--)
+            nextToken(q, bounds[chunk + 1], token_begin);
+        for (int field = 0; field < total_values; field++)
+        {
+            // Tokens of one point may continue in the following chunks
+            while (!nextToken(q, bounds[chunk + 1], token_begin))
+            {
+                if (++chunk >= getTotalChunks())
+                    return false;
+                q = bounds[chunk];
+            }
+            if (!parseDouble(token_begin, q, values[field]))
+                return false;
+        }
+        return true;
+    }
+
+    // Some of our datasets (4.txt, 8.txt) have fewer points than their header claims; like the old `cin >> value`
+    // loop, the points from the first incomplete one on are left at zero so results stay comparable, but we say so on
+    // stderr. Returns the number of complete points.
+    int finish(PointMatrix &points) const
+    {
+        int complete = completePoints(getTotalChunks());
+        if (complete < total_points)
+        {
+            std::cerr << "Warning: dataset ended after " << complete << " of " << total_points
+                      << " points, the remaining points are zero" << std::endl;
+            memset(points.row(complete), 0, (size_t)(total_points - complete) * total_values * sizeof(double));
+            if (has_name)
+                for (int i = complete; i < total_points; i++)
+                    points.setName(i, std::string());
+        }
+        return complete;
+    }
+};
+
+// ============================================================================
+// Reads a dataset in the datasets/*.txt layout (or a binary dataset) from fd into the matrix. Returns false when the
+// input cannot be read or the header is malformed.
+// ============================================================================
+template <typename ChunkLoop>
+inline bool loadPointMatrix(int fd, DatasetHeader &header, PointMatrix &points, const ChunkLoop &for_each_chunk)
+{
+    std::shared_ptr<MappedInput> input(new MappedInput());
+    if (!input->open(fd))
+        return false;
+    if (isBinaryDataset(input->begin(), input->end()))
+        return attachBinaryDataset(input, header, points); // The matrix keeps the mapping alive
+
+    TextDatasetParser parser;
+    if (!parser.readHeader(input->begin(), input->end(), header))
+        return false;
+    points.reset(header.total_points, header.total_values, header.has_name != 0);
+
+    // Pass 1: tokens per chunk, prefix-summed into the first token of every chunk
+    for_each_chunk(parser.getTotalChunks(), [&](int chunk)
+                   { parser.countChunk(chunk); });
+    parser.sumCounts();
+
+    // Pass 2: parse
+    for_each_chunk(parser.getTotalChunks(), [&](int chunk)
+                   { parser.parseChunk(chunk, points); });
+    parser.finish(points);
+    return true;
+}
+
+inline bool loadPointMatrix(int fd, DatasetHeader &header, PointMatrix &points)
+{
+    return loadPointMatrix(fd, header, points, SerialChunkLoop());
+}
+
+#endif
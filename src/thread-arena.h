@@ -0,0 +1,181 @@
+// Explicit TBB arena with an optional thread pinning policy
+//
+// SUMMARY
+// By default every parallel_for runs in TBB's implicit arena, with one worker per logical CPU the process may use, and
+// the OS is free to move those workers between cores (and away from a noisy neighbour, or onto it). ThreadArena runs
+// the program inside a tbb::task_arena of a chosen size (--threads) and can pin each thread of that arena to one
+// logical CPU (--pin) through a task_scheduler_observer, which TBB calls whenever a thread joins the arena:
+//   compact   arena slot i gets the i-th CPU in (package, core, hyperthread) order, so the threads share caches and
+//             fill a socket, SMT siblings included, before using the next one
+//   scatter   slots are spread first across packages, then across physical cores, and SMT siblings come last, so
+//             every thread gets as much cache and memory bandwidth as possible
+// Only CPUs in the process's affinity mask are used (taskset and cgroup limits are respected); if there are more slots
+// than CPUs, slots wrap around. Topology comes from /sys/devices/system/cpu, and pinning is a no-op off Linux.
+// Samir's code
+
+#ifndef KMEANS_THREAD_ARENA_H
+#define KMEANS_THREAD_ARENA_H
+
+#include <stdio.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <tbb/global_control.h>
+#include <tbb/task_arena.h>
+#include <tbb/task_scheduler_observer.h>
+
+#include "options.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+struct CpuPlace
+{
+    int cpu;
+    int package;
+    int core;
+    int sibling; // 0 for the first hyperthread of its core, 1 for the second, ...
+};
+
+// Integer from a sysfs topology file, -1 if it is missing
+inline int readTopology(int cpu, const char *field)
+{
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, field);
+    FILE *file = fopen(path, "r");
+    int value = -1;
+    if (file)
+    {
+        if (fscanf(file, "%d", &value) != 1)
+            value = -1;
+        fclose(file);
+    }
+    return value;
+}
+
+// The CPUs this process may run on, in the order the policy hands them to arena slots
+inline std::vector<int> pinningOrder(PinPolicy policy)
+{
+    std::vector<CpuPlace> places;
+#ifdef __linux__
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return std::vector<int>();
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        if (CPU_ISSET(cpu, &allowed))
+        {
+            CpuPlace place = {cpu, std::max(0, readTopology(cpu, "physical_package_id")), readTopology(cpu, "core_id"), 0};
+            if (place.core < 0)
+                place.core = cpu;
+            places.push_back(place);
+        }
+#endif
+
+    // Number the hyperthreads of each core in CPU order
+    for (size_t i = 0; i < places.size(); i++)
+        for (size_t j = 0; j < i; j++)
+            if (places[j].package == places[i].package && places[j].core == places[i].core)
+                places[i].sibling++;
+
+    if (policy == PIN_COMPACT)
+        std::sort(places.begin(), places.end(), [](const CpuPlace &a, const CpuPlace &b)
+                  { return a.package != b.package ? a.package < b.package : a.core != b.core ? a.core < b.core : a.sibling < b.sibling; });
+    else
+    {
+        // Round-robin over packages within each rank of cores, SMT siblings last
+        std::vector<int> rank(places.size(), 0);
+        for (size_t i = 0; i < places.size(); i++)
+            for (size_t j = 0; j < places.size(); j++)
+                if (places[j].package == places[i].package && places[j].sibling == places[i].sibling && places[j].core < places[i].core)
+                    rank[i]++;
+        std::vector<size_t> index(places.size());
+        for (size_t i = 0; i < index.size(); i++)
+            index[i] = i;
+        std::sort(index.begin(), index.end(), [&](size_t a, size_t b)
+                  {
+            if (places[a].sibling != places[b].sibling)
+                return places[a].sibling < places[b].sibling;
+            if (rank[a] != rank[b])
+                return rank[a] < rank[b];
+            return places[a].package < places[b].package; });
+        std::vector<CpuPlace> scattered;
+        for (size_t i = 0; i < index.size(); i++)
+            scattered.push_back(places[index[i]]);
+        places.swap(scattered);
+    }
+
+    std::vector<int> order;
+    for (size_t i = 0; i < places.size(); i++)
+        order.push_back(places[i].cpu);
+    return order;
+}
+
+// Pins every thread that joins the arena (the main thread included) to the CPU of its arena slot
+class PinningObserver : public tbb::task_scheduler_observer
+{
+private:
+    std::vector<int> cpus;
+
+public:
+    PinningObserver(tbb::task_arena &arena, PinPolicy policy) : tbb::task_scheduler_observer(arena), cpus(pinningOrder(policy))
+    {
+        if (!cpus.empty())
+            observe(true);
+    }
+
+    ~PinningObserver() { observe(false); }
+
+    void on_scheduler_entry(bool) override
+    {
+#ifdef __linux__
+        int slot = tbb::this_task_arena::current_thread_index();
+        if (slot < 0)
+            return;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpus[slot % cpus.size()], &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+    }
+};
+
+// ============================================================================
+// threads = 0 keeps TBB's default concurrency. Otherwise TBB's global worker limit is also set to threads, since it
+// caps every arena at the CPU count by default and the scaling sweeps go past it on purpose. Run the program through
+// execute() so every parallel_for inside it, and this_task_arena::max_concurrency() (which sizes the accumulator
+// slots), sees this arena.
+// ============================================================================
+class ThreadArena
+{
+private:
+    std::unique_ptr<tbb::global_control> worker_limit;
+    tbb::task_arena arena;
+    PinningObserver *observer;
+
+public:
+    ThreadArena(int threads, PinPolicy policy)
+        : worker_limit(threads > 0 ? new tbb::global_control(tbb::global_control::max_allowed_parallelism, threads) : nullptr),
+          arena(threads > 0 ? threads : tbb::task_arena::automatic), observer(nullptr)
+    {
+        arena.initialize();
+        if (policy != PIN_NONE)
+            observer = new PinningObserver(arena, policy);
+    }
+
+    ~ThreadArena() { delete observer; }
+
+    ThreadArena(const ThreadArena &) = delete;
+    ThreadArena &operator=(const ThreadArena &) = delete;
+
+    inline int getConcurrency() { return arena.max_concurrency(); }
+
+    template <typename Function>
+    auto execute(const Function &function) -> decltype(function())
+    {
+        return arena.execute(function);
+    }
+};
+
+#endif
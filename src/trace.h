@@ -0,0 +1,234 @@
+// Per-step instrumentation of the Phase 2 hot path, compiled out unless KMEANS_TRACE is defined
+//
+// SUMMARY
+// "TIME PHASE 2" says how long the iterations took, not whether Step 2a, the 2b.2 accumulation, the 2b.3 merge or the
+// 2b.4 divide dominates. Built with -DKMEANS_TRACE (./run.sh trace ...), parallel.cpp and usion-parallel.cpp record:
+//   TRACE_SCOPE(name)   a timed span on the calling thread, up to the end of the enclosing block
+//   TRACE_BEGIN(span) / TRACE_END(span, name)   the same between two statements, for steps that are not a block
+//   TRACE_TASK(name)    a timed span inside a TBB task body; these also add up to each thread's busy time
+//   TRACE_COUNT(c, n)   adds n to counter c (points moved, distance evaluations, bytes streamed) in the thread's buffer
+//   TRACE_ITERATION()   ends an iteration: the counters of all threads are summed into one sample per iteration
+//   TRACE_FINISH()      prints a per-step and per-thread summary and writes the Chrome trace (chrome://tracing or
+//                       ui.perfetto.dev) to $KMEANS_TRACE_FILE, default kmeans-trace.json
+// Every thread appends to its own buffer, so recording costs two clock reads and a push_back per span and never takes
+// a lock after the thread's first span. Without KMEANS_TRACE every macro expands to nothing.
+// Samir's code
+
+#ifndef KMEANS_TRACE_H
+#define KMEANS_TRACE_H
+
+enum TraceCounter
+{
+    TRACE_POINTS_MOVED, // Points Step 2a put in a different cluster
+    TRACE_DISTANCES,    // Point-centroid distances computed in Step 2a
+    TRACE_BYTES,        // Point values and assignments streamed by Steps 2a and 2b.2 (an estimate: sums and centroids are not counted)
+    TRACE_COUNTER_COUNT
+};
+
+#ifdef KMEANS_TRACE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class TraceRecorder
+{
+private:
+    struct Span
+    {
+        const char *name;
+        int64_t begin; // Nanoseconds since the recorder started
+        int64_t end;
+    };
+
+    struct Sample
+    {
+        int64_t time;
+        long long values[TRACE_COUNTER_COUNT];
+    };
+
+    // One per thread, only ever written by its thread
+    struct ThreadBuffer
+    {
+        int id;
+        std::vector<Span> spans;
+        int64_t busy;                             // Sum of the thread's TRACE_TASK spans
+        long long counts[TRACE_COUNTER_COUNT];    // Since the last TRACE_ITERATION
+    };
+
+    std::chrono::steady_clock::time_point origin;
+    std::mutex registration;
+    std::vector<ThreadBuffer *> buffers;
+    std::vector<Sample> samples;
+
+public:
+    TraceRecorder() : origin(std::chrono::steady_clock::now()) {}
+
+    ~TraceRecorder()
+    {
+        for (size_t b = 0; b < buffers.size(); b++)
+            delete buffers[b];
+    }
+
+    inline int64_t now() const
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+    }
+
+    // The calling thread's buffer, registered on its first use
+    ThreadBuffer &local()
+    {
+        static thread_local ThreadBuffer *buffer = nullptr;
+        if (!buffer)
+        {
+            buffer = new ThreadBuffer();
+            buffer->busy = 0;
+            memset(buffer->counts, 0, sizeof(buffer->counts));
+            std::lock_guard<std::mutex> lock(registration);
+            buffer->id = (int)buffers.size();
+            buffers.push_back(buffer);
+        }
+        return *buffer;
+    }
+
+    inline void record(const char *name, int64_t begin, int64_t end, bool task)
+    {
+        ThreadBuffer &buffer = local();
+        buffer.spans.push_back(Span{name, begin, end});
+        if (task)
+            buffer.busy += end - begin;
+    }
+
+    inline void count(TraceCounter counter, long long value) { local().counts[counter] += value; }
+
+    // Called by the main thread between parallel regions, so no other thread is writing its counts
+    void endIteration()
+    {
+        Sample sample;
+        sample.time = now();
+        memset(sample.values, 0, sizeof(sample.values));
+        std::lock_guard<std::mutex> lock(registration);
+        for (size_t b = 0; b < buffers.size(); b++)
+            for (int c = 0; c < TRACE_COUNTER_COUNT; c++)
+            {
+                sample.values[c] += buffers[b]->counts[c];
+                buffers[b]->counts[c] = 0;
+            }
+        samples.push_back(sample);
+    }
+
+    void finish()
+    {
+        static const char *counter_names[TRACE_COUNTER_COUNT] = {"points moved", "distances", "bytes"};
+        std::lock_guard<std::mutex> lock(registration);
+
+        // Summary: time per span name (in order of first appearance) and busy time per thread
+        std::vector<std::string> order;
+        std::map<std::string, std::pair<long long, int64_t>> per_name; // count, total ns
+        for (size_t b = 0; b < buffers.size(); b++)
+            for (size_t s = 0; s < buffers[b]->spans.size(); s++)
+            {
+                const Span &span = buffers[b]->spans[s];
+                std::pair<long long, int64_t> &entry = per_name[span.name];
+                if (entry.first == 0)
+                    order.push_back(span.name);
+                entry.first++;
+                entry.second += span.end - span.begin;
+            }
+        for (size_t n = 0; n < order.size(); n++)
+            printf("TRACE %s = %.0f µs over %lld spans\n", order[n].c_str(), per_name[order[n]].second / 1e3,
+                   per_name[order[n]].first);
+        long long totals[TRACE_COUNTER_COUNT] = {0};
+        for (size_t s = 0; s < samples.size(); s++)
+            for (int c = 0; c < TRACE_COUNTER_COUNT; c++)
+                totals[c] += samples[s].values[c];
+        for (int c = 0; c < TRACE_COUNTER_COUNT; c++)
+            printf("TRACE %s = %lld\n", counter_names[c], totals[c]);
+        for (size_t b = 0; b < buffers.size(); b++)
+            printf("TRACE THREAD %d BUSY = %.0f µs\n", buffers[b]->id, buffers[b]->busy / 1e3);
+
+        // Chrome trace: complete ("X") events per span, one counter ("C") track per counter, thread names
+        const char *path = getenv("KMEANS_TRACE_FILE");
+        if (!path || !*path)
+            path = "kmeans-trace.json";
+        FILE *file = fopen(path, "w");
+        if (!file)
+        {
+            perror(path);
+            return;
+        }
+        fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+        bool first = true;
+        for (size_t b = 0; b < buffers.size(); b++)
+        {
+            fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s %d\"}}",
+                    first ? "" : ",\n", buffers[b]->id, buffers[b]->id == 0 ? "main" : "worker", buffers[b]->id);
+            first = false;
+            for (size_t s = 0; s < buffers[b]->spans.size(); s++)
+            {
+                const Span &span = buffers[b]->spans[s];
+                fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+                        span.name, buffers[b]->id, span.begin / 1e3, (span.end - span.begin) / 1e3);
+            }
+        }
+        for (size_t s = 0; s < samples.size(); s++)
+            for (int c = 0; c < TRACE_COUNTER_COUNT; c++)
+            {
+                fprintf(file, "%s{\"name\": \"%s\", \"ph\": \"C\", \"pid\": 1, \"ts\": %.3f, \"args\": {\"per iteration\": %lld}}",
+                        first ? "" : ",\n", counter_names[c], samples[s].time / 1e3, samples[s].values[c]);
+                first = false;
+            }
+        fprintf(file, "\n]}\n");
+        fclose(file);
+        printf("TRACE FILE = %s\n", path);
+    }
+};
+
+inline TraceRecorder &traceRecorder()
+{
+    static TraceRecorder recorder;
+    return recorder;
+}
+
+class TraceSpan
+{
+private:
+    const char *name;
+    bool task;
+    int64_t begin;
+
+public:
+    TraceSpan(const char *name, bool task) : name(name), task(task), begin(traceRecorder().now()) {}
+    ~TraceSpan() { traceRecorder().record(name, begin, traceRecorder().now(), task); }
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(name, false)
+#define TRACE_TASK(name) TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(name, true)
+#define TRACE_BEGIN(span) int64_t trace_##span = traceRecorder().now()
+#define TRACE_END(span, name) traceRecorder().record(name, trace_##span, traceRecorder().now(), false)
+#define TRACE_COUNT(counter, value) traceRecorder().count(counter, value)
+#define TRACE_ITERATION() traceRecorder().endIteration()
+#define TRACE_FINISH() traceRecorder().finish()
+
+#else
+
+#define TRACE_SCOPE(name)
+#define TRACE_TASK(name)
+#define TRACE_BEGIN(span)
+#define TRACE_END(span, name)
+#define TRACE_COUNT(counter, value)
+#define TRACE_ITERATION()
+#define TRACE_FINISH()
+
+#endif
+
+#endif
@@ -2,8 +2,9 @@
 // reference: https://github.com/marcoscastro/kmeans
 
 // SUMMARY
-// This implementation of the K-Means clustering algorithm applies fusion optimization by combining the reassignment and sum steps using Intel TBB’s parallelization features. It restructures the loop to first compute an initial sum, then iteratively perform divide, reassign, and sum while any points continue to move between clusters, ensuring efficient centroid updates with minimal synchronization overhead.
-// Samir's code CURRENTLY BROKEN IN SUBMISSION, WANT TO CONTINUE WORKING ON IT AS APPROACH CODE REVIEW
+// This implementation of the K-Means clustering algorithm applies fusion optimization by combining the reassignment and sum steps using Intel TBB’s parallelization features. Every iteration is a single sweep over the points: each block of points is assigned to its nearest centroid (Step 2a) and immediately added to the calling worker's sums (Step 2b.2) while it is still in cache, so the points are streamed from memory once per iteration instead of twice.
+// The per-worker sums (accumulators.h) are merged with a tree reduction whose last round also divides them into the new centroids, so there is no separate divide pass. The centroids are identical to b-parallel's and parallel's, and match serial.cpp (./run.sh check u <dataset>).
+// Samir's code
 
 #include <iostream>
 #include <vector>
@@ -17,63 +18,18 @@
 #include <tbb/parallel_for.h>
 #include <atomic>
 #include <tbb/blocked_range.h>
-#include <tbb/enumerable_thread_specific.h>
-#include <tbb/concurrent_unordered_set.h>
+#include <tbb/global_control.h>
+#include <memory>
+// shared point storage, SIMD kernels and accumulators
+#include "point-matrix.h"
+#include "parallel-text-loader.h"
+#include "dimension-kernels.h"
+#include "accumulators.h"
+#include "bench-report.h"
+#include "trace.h"
 
 using namespace std;
 
-// ============================================================================
-//                              Point Class
-// ============================================================================
-// This class represents a **single data point** in the dataset.
-
-class Point
-{
-private:
-    int id_point;          // Unique identifier for the point
-    int id_cluster;        // ID of the cluster this point is assigned to
-    vector<double> values; // Stores the feature values of the point
-    int total_values;      // Number of features (dimensions) for this point
-    string name;           // Optional name of the point (default: empty)
-
-public:
-    Point(int id_point, vector<double> &values, string name = "")
-    {
-        this->id_point = id_point;    // Assigns the point ID
-        total_values = values.size(); // Stores the total number of features
-        // this->values.reserve(total_values); // DOESN'T WORK - dynamic resizing
-
-        // SAMIR - Loop unrolling
-        int i = 0;
-        for (; i + 3 < total_values; i += 4) // Copy 4 values per loop
-        {
-            this->values.push_back(values[i]);
-            this->values.push_back(values[i + 1]);
-            this->values.push_back(values[i + 2]);
-            this->values.push_back(values[i + 3]);
-        }
-
-        // Handle remaining values
-        for (; i < total_values; i++)
-            this->values.push_back(values[i]);
-
-        this->name = name; // Assigns the name (if provided)
-        id_cluster = -1;   // Initially, the point is not assigned to any cluster (-1)
-    }
-
-    // ============================================================================
-    // Getter Methods: Retrieve information about the point.
-    // ============================================================================
-
-    // SAMIR - Inline small functions
-    inline int getID() const { return id_point; }
-    inline int getCluster() const { return id_cluster; }
-    inline void setCluster(int id_cluster) { this->id_cluster = id_cluster; }
-    inline double getValue(int index) const { return values[index]; }
-    inline int getTotalValues() const { return total_values; }
-    inline string getName() const { return name; }
-};
-
 // ============================================================================
 //                              Cluster Class
 // ============================================================================
@@ -83,30 +39,28 @@ class Cluster
 {
 private:
     int id_cluster;
-    vector<double> central_values; // Centroid coordinates
+    double *central_values; // SAMIR - Row of the KMeans centroid matrix, so the kernels see all K centroids contiguously
 
 public:
-    Cluster(int id_cluster, Point point)
+    Cluster(int id_cluster, double *central_values, const double *point_values, int total_values)
     {
         this->id_cluster = id_cluster;
-
-        int total_values = point.getTotalValues();
-        central_values.reserve(total_values); // SAMIR - reserve space for feature values
+        this->central_values = central_values;
 
         int i = 0;
         // SAMIR - Unroll by copying 4 feature values at a time
         for (; i + 3 < total_values; i += 4)
         {
-            central_values.push_back(point.getValue(i));
-            central_values.push_back(point.getValue(i + 1));
-            central_values.push_back(point.getValue(i + 2));
-            central_values.push_back(point.getValue(i + 3));
+            central_values[i] = point_values[i];
+            central_values[i + 1] = point_values[i + 1];
+            central_values[i + 2] = point_values[i + 2];
+            central_values[i + 3] = point_values[i + 3];
         }
 
         // Copy remaining feature values
         for (; i < total_values; i++)
         {
-            central_values.push_back(point.getValue(i));
+            central_values[i] = point_values[i];
         }
     }
 
@@ -120,57 +74,22 @@ public:
 // ============================================================================
 // Implements the K-Means algorithm.
 
+#define FUSED_BLOCK_POINTS 256 // Points assigned and accumulated together, small enough to stay in L1/L2 between the two
+
 class KMeans
 {
 private:
-    int K;                    // Number of clusters
-    int total_values;         // Number of features per point
-    int total_points;         // Total number of points
-    int max_iterations;       // Maximum iterations allowed
-    vector<Cluster> clusters; // Stores only cluster centroids
-
-    // ======================================================================
-    // Finds the **nearest cluster** to a given point using **Euclidean distance**.
-    // ======================================================================
-    int getIDNearestCenter(Point &point)
-    {
-        // Attempted to parallelize this function but even on big datasets such as 8.txt we get no speedup
-        double min_dist_sq = numeric_limits<double>::max(); // Store squared distance
-        int id_cluster_center = 0;
-
-        for (int i = 0; i < K; i++)
-        {
-            double sum = 0.0;
-            int j = 0;
-
-            // SAMIR - Process 4 values at a time (Loop Unrolling by 4)
-            for (; j + 3 < total_values; j += 4)
-            {
-                double diff0 = clusters[i].getCentralValue(j) - point.getValue(j);
-                double diff1 = clusters[i].getCentralValue(j + 1) - point.getValue(j + 1);
-                double diff2 = clusters[i].getCentralValue(j + 2) - point.getValue(j + 2);
-                double diff3 = clusters[i].getCentralValue(j + 3) - point.getValue(j + 3);
-
-                // SAMIR - Replace pow(x, 2.0) with Direct Multiplication
-                sum += (diff1 * diff1) + (diff2 * diff2) + (diff3 * diff3) + (diff0 * diff0);
-            }
-
-            // Process remaining elements (if any)
-            for (; j < total_values; j++)
-            {
-                double diff = clusters[i].getCentralValue(j) - point.getValue(j);
-                sum += diff * diff;
-            }
-
-            // SAMIR - No sqrt() needed - compare squared distances
-            if (sum < min_dist_sq)
-            {
-                min_dist_sq = sum;
-                id_cluster_center = i;
-            }
-        }
-        return id_cluster_center;
-    }
+    int K;                                 // Number of clusters
+    int total_values;                      // Number of features per point
+    int total_points;                      // Total number of points
+    int max_iterations;                    // Maximum iterations allowed
+    vector<Cluster> clusters;              // Stores only cluster centroids
+    AlignedBuffer<double> centroids;       // K x total_values centroid values, viewed by the clusters
+    SimdLevel simd_level;                  // Instruction set picked at startup
+    NearestCenterKernel nearest_centers;   // Step 2a kernel for that instruction set and dimension count
+    AccumulateKernel accumulate_columns;   // Step 2b.2 kernel reading the columns the Step 2a kernel just read
+    ClusterAccumulators accumulators;      // Per-worker sums and counts, allocated once per run
+    BenchReport bench;                     // Phase timings for benchmark.cpp (bench-report.h)
 
 public:
     KMeans(int K, int total_points, int total_values, int max_iterations)
@@ -179,9 +98,18 @@ public:
         this->total_points = total_points;
         this->total_values = total_values;
         this->max_iterations = max_iterations;
+
+        // SAMIR - pick the widest SIMD kernel this CPU supports once, instead of compiling with -march=native
+        simd_level = detectSimdLevel();
+        nearest_centers = selectNearestCenterKernel(simd_level, total_values); // SAMIR - unrolled for this dataset's dimension count
+        accumulate_columns = selectColumnAccumulateKernel(total_values);
+        centroids.resize((size_t)K * total_values);
+        accumulators.init(K, total_values);
     }
 
-    void run(vector<Point> &points)
+    inline const BenchReport &getBenchReport() const { return bench; }
+
+    void run(PointMatrix &points)
     {
         auto begin = chrono::high_resolution_clock::now();
 
@@ -199,91 +127,63 @@ public:
 
             if (chosen_indexes.insert(index_point).second) // SAMIR - O(1) lookup and insert
             {
-                points[index_point].setCluster(chosen_indexes.size() - 1);             // Assign cluster
-                clusters.emplace_back(chosen_indexes.size() - 1, points[index_point]); // SAMIR - emplace back
+                int id_cluster = chosen_indexes.size() - 1;
+                points.setCluster(index_point, id_cluster); // Assign cluster
+                clusters.emplace_back(id_cluster, centroids.data() + (size_t)id_cluster * total_values, points.row(index_point), total_values); // SAMIR - emplace back
             }
         }
 
         //^^^ Don't want to parallelize this because Time Phase 1 is very small regardless of dataset and it can mess with rand(). Gets too confusing
         auto end_phase1 = chrono::high_resolution_clock::now();
         long long total_iteration_time = 0;
-
-        // Compute initial sums based on random assignments
-        vector<vector<double>> new_centroids(K, vector<double>(total_values, 0.0));
-        vector<int> cluster_sizes(K, 0);
-
-        // Precompute the initial cluster sums
-        for (size_t i = 0; i < points.size(); ++i)
-        {
-            int cluster_id = points[i].getCluster();
-            cluster_sizes[cluster_id]++;
-
-            for (int j = 0; j < total_values; j++)
-            {
-                new_centroids[cluster_id][j] += points[i].getValue(j);
-            }
-        }
-
         int iter = 1;
 
-        tbb::enumerable_thread_specific<vector<vector<double>>> local_sums;
-        tbb::enumerable_thread_specific<vector<int>> local_counts;
+        // Step 2: **Iterate until convergence or max_iterations reached**
         while (true)
         {
             auto iteration_start = chrono::high_resolution_clock::now();
-            // === Divide Step: Compute New Centroids ===
-            tbb::parallel_for(0, K, [&](int i)
-                              {
-                if (cluster_sizes[i] > 0) {
-                    double inv_size = 1.0 / cluster_sizes[i]; // Precompute division
-                    for (int j = 0; j < total_values; j++) {
-                        clusters[i].setCentralValue(j, new_centroids[i][j] * inv_size);
-                    }
-                } });
-
+            TRACE_BEGIN(iteration);
             std::atomic<bool> done(true);
+
             // === Fused Reassign + Sum Step ===
-            tbb::parallel_for(tbb::blocked_range<size_t>(0, points.size()), [&](const tbb::blocked_range<size_t> &r)
+            // Each worker sums into its own cache-line padded slot; the slots are cleared here, every iteration
+            accumulators.zero();
+            TRACE_BEGIN(fused);
+            tbb::parallel_for(tbb::blocked_range<int>(0, total_points), [&](const tbb::blocked_range<int> &r)
                               {
-                auto &local_centroids = local_sums.local();
-                auto &local_cluster_sizes = local_counts.local();
-
-                for (size_t i = r.begin(); i < r.end(); ++i) {
-                    int old_cluster = points[i].getCluster();
-                    int new_cluster = getIDNearestCenter(points[i]);
-
-                    if (old_cluster != new_cluster) {
-                        points[i].setCluster(new_cluster);
-                        done.store(false, std::memory_order_relaxed);
-                    }
-
-                    local_cluster_sizes[new_cluster]++;
-                    for (int j = 0; j < total_values; j++) {
-                        local_centroids[new_cluster][j] += points[i].getValue(j);
-                    }
-                } });
+                TRACE_TASK("fused sweep task");
+                double *local_sums = accumulators.localSums();
+                int *local_counts = accumulators.localCounts();
 
-            // Merge thread-local results
-            tbb::parallel_for(0, K, [&](int i)
-                              {
-                for (const auto &local_centroids : local_sums) {
-                    for (int j = 0; j < total_values; j++) {
-                        new_centroids[i][j] += local_centroids[i][j];
-                    }
-                }
-                for (const auto &local_cluster_sizes : local_counts) {
-                    cluster_sizes[i] += local_cluster_sizes[i];
+                for (int block = r.begin(); block < r.end(); block += FUSED_BLOCK_POINTS)
+                {
+                    int block_end = min(block + FUSED_BLOCK_POINTS, r.end());
+                    // Step 2a: assign the block, SAMIR - SIMD kernel over the column-major copy
+                    int moved = nearest_centers(points, block, block_end, centroids.data(), K, points.getAssignments());
+                    if (moved != 0)
+                        done.store(false, std::memory_order_relaxed); // Mark a change
+                    // Step 2b.2: add the block to its new clusters while its columns are still in cache
+                    accumulate_columns(points, block, block_end, local_sums, local_counts);
+                    TRACE_COUNT(TRACE_POINTS_MOVED, moved);
+                    TRACE_COUNT(TRACE_DISTANCES, (long long)(block_end - block) * K);
+                    TRACE_COUNT(TRACE_BYTES, (long long)(block_end - block) * (total_values * sizeof(double) + sizeof(int32_t))); // Read once for both steps
                 } });
+            TRACE_END(fused, "fused sweep");
 
-            // === Reset for Next Iteration ===
-            fill(cluster_sizes.begin(), cluster_sizes.end(), 0);
-            for (auto &row : new_centroids)
-            {
-                fill(row.begin(), row.end(), 0.0);
-            }
+            auto assign_end = chrono::high_resolution_clock::now();
+
+            // === Merge + Divide Step ===
+            // Tree reduction of the slots; the last round writes the new centroids directly
+            TRACE_BEGIN(merge);
+            accumulators.reduceToMeans(centroids.data());
+            TRACE_END(merge, "merge and divide");
 
             auto iteration_end = chrono::high_resolution_clock::now();
+            TRACE_END(iteration, "iteration");
+            TRACE_ITERATION();
             total_iteration_time += chrono::duration_cast<chrono::microseconds>(iteration_end - iteration_start).count();
+            bench.assignment += benchMicros(assign_end - iteration_start);
+            bench.update += benchMicros(iteration_end - assign_end);
 
             // === Check Stopping Condition ===
             if (done.load() || iter >= max_iterations)
@@ -294,16 +194,11 @@ public:
 
             iter++; // Increment iteration count
         }
-        // === Final Computation of Centroids (Ensure Consistency) ===
-        tbb::parallel_for(0, K, [&](int i)
-                          {
-            if (cluster_sizes[i] > 0) {
-                double inv_size = 1.0 / cluster_sizes[i];
-                for (int j = 0; j < total_values; j++) {
-                    clusters[i].setCentralValue(j, new_centroids[i][j] * inv_size);
-                }
-            } });
         auto end = chrono::high_resolution_clock::now();
+        bench.seeding = benchMicros(end_phase1 - begin);
+        bench.phase2 = benchMicros(end - end_phase1);
+        bench.total = benchMicros(end - begin);
+        bench.iterations = iter;
 
         // Step 3: **Display results**
         for (int i = 0; i < K; i++)
@@ -311,12 +206,12 @@ public:
             cout << "Cluster " << clusters[i].getID() + 1 << endl;
             for (int j = 0; j < total_points; j++)
             {
-                if (points[j].getCluster() == i)
+                if (points.getCluster(j) == i)
                 {
-                    // cout << "Point " << points[j].getID() + 1 << ": ";
+                    // cout << "Point " << j + 1 << ": ";
                     // for (int p = 0; p < total_values; p++)
-                    //     cout << points[j].getValue(p) << " ";
-                    // string point_name = points[j].getName();
+                    //     cout << points.getValue(j, p) << " ";
+                    // string point_name = points.hasNames() ? points.getName(j) : "";
                     // if (point_name != "")
                     //     cout << "- " << point_name;
 
@@ -333,6 +228,8 @@ public:
         cout << "TOTAL EXECUTION TIME = " << chrono::duration_cast<chrono::microseconds>(end - begin).count() << " µs\n";
         cout << "TIME PHASE 1 = " << chrono::duration_cast<chrono::microseconds>(end_phase1 - begin).count() << " µs\n";
         cout << "TIME PHASE 2 = " << chrono::duration_cast<chrono::microseconds>(end - end_phase1).count() << " µs\n";
+        cout << "TIME ITERATIONS = " << total_iteration_time << " µs\n";
+        cout << "SIMD KERNEL = " << simdLevelName(simd_level) << (isFixedDimension(total_values) ? " (dimension-specialized)" : " (generic)") << "\n";
 
         // Calculate and display the **average time per iteration**
         if (iter > 1) // Only compute if we have at least 1 iteration
@@ -362,59 +259,43 @@ int main(int argc, char *argv[])
     // srand(time(NULL));
     srand(10);
 
-    int total_points, total_values, K, max_iterations, has_name;
+    // SAMIR - worker count requested by benchmark.cpp (KMEANS_BENCH_THREADS), TBB's default otherwise
+    unique_ptr<tbb::global_control> thread_limit;
+    if (benchThreads() > 0)
+        thread_limit.reset(new tbb::global_control(tbb::global_control::max_allowed_parallelism, benchThreads()));
 
     // ==========================================================================
-    // Step 1: Read Input Values
+    // Step 1: Read Input Values and Points
     // ==========================================================================
-    // Read the total number of data points, the number of features per point,
+    // The header gives the total number of data points, the number of features per point,
     // the number of clusters (K), the maximum number of iterations, and whether
-    // each point has a name.
-    cin >> total_points >> total_values >> K >> max_iterations >> has_name;
-
-    // Declare a vector to store all points in the dataset
-    vector<Point> points;
-    points.reserve(total_points); // SAMIR - Preallocate memory for all points
-    string point_name;            // To store the optional name of the point
-
-    // ==========================================================================
-    // Step 2: Read Points from Input
-    // ==========================================================================
-    for (int i = 0; i < total_points; i++)
+    // each point has a name. SAMIR - every point is read straight into one contiguous matrix
+    auto begin_load = chrono::high_resolution_clock::now();
+    DatasetHeader header;
+    PointMatrix points;
+    if (!loadPointMatrixParallel(STDIN_FILENO, header, points)) // SAMIR - mmap the dataset and parse it in parallel chunks
     {
-        vector<double> values;        // Store feature values of the current point
-        values.reserve(total_values); // SAMIR - preallocate memory for feature values
-
-        // Read the feature values for the current point
-        for (int j = 0; j < total_values; j++)
-        {
-            double value;
-            cin >> value;
-            values.push_back(value);
-        }
-
-        // If the points have names, read and store the name
-        if (has_name)
-        {
-            cin >> point_name;
-            Point p(i, values, point_name); // Create a Point with a name
-            points.emplace_back(i, values); // SAMIR - emplace back
-        }
-        else
-        {
-            Point p(i, values);             // Create a Point without a name
-            points.emplace_back(i, values); // SAMIR - emplace back
-        }
+        cerr << "Error: malformed dataset on standard input" << endl;
+        return 1;
     }
+    points.buildColumns(); // SAMIR - column-major copy for the SIMD kernels and the fused sums
+    auto end_load = chrono::high_resolution_clock::now();
 
     // ==========================================================================
     // Step 3: Initialize K-Means Algorithm and Run Clustering
     // ==========================================================================
     // Create an instance of KMeans with the input parameters
-    KMeans kmeans(K, total_points, total_values, max_iterations);
+    KMeans kmeans(header.K, header.total_points, header.total_values, header.max_iterations);
 
     // Run the K-Means algorithm on the dataset
     kmeans.run(points);
+    cout << "TIME LOAD = " << chrono::duration_cast<chrono::microseconds>(end_load - begin_load).count() << " µs\n";
+
+    // SAMIR - phase timings as JSON for benchmark.cpp, when it asks for them
+    BenchReport report = kmeans.getBenchReport();
+    report.load = benchMicros(end_load - begin_load);
+    writeBenchReport("usion-parallel", report);
+    TRACE_FINISH(); // SAMIR - per-step summary and Chrome trace, only in -DKMEANS_TRACE builds
 
     // ==========================================================================
     // Step 4: Exit Program
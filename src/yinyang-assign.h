@@ -0,0 +1,316 @@
+// Yinyang bound-based assignment (Step 2a)
+//
+// SUMMARY
+// Sits between Elkan (K lower bounds per point) and Hamerly (one): the centroids are split once, up front, into
+// about K / 10 groups by running a few Lloyd iterations on the initial centroids themselves, and every point keeps one
+// lower bound per group. Filters, cheapest first:
+//   - global: u < min over groups of the group bounds  -> the point keeps its centroid
+//   - group:  u < the bound of group g                 -> no centroid of g can win
+//   - local:  u < (bound of g before this iteration) - (how far c moved) -> centroid c of g cannot win
+// and only the centroids that pass all three are measured. Group bounds loosen by the largest move in their group.
+// As in elkan-assign.h, every distance that is computed uses the direct kernels' arithmetic, ties go to the lower
+// cluster ID and bounds only skip past BOUND_SLACK, so the assignments are exactly the direct kernels' ones.
+// Memory: 1 + K / 10 doubles per point.
+// Samir's code
+
+#ifndef KMEANS_YINYANG_ASSIGN_H
+#define KMEANS_YINYANG_ASSIGN_H
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include "distance-kernels.h"
+
+#define YINYANG_CENTROIDS_PER_GROUP 10
+#define YINYANG_GROUPING_ITERATIONS 5
+
+// ============================================================================
+//                              YinyangAssigner Class
+// ============================================================================
+// Same interface as ElkanAssigner: setCentroids() once per iteration, then assign() from any number of threads on
+// disjoint point ranges.
+
+class YinyangAssigner
+{
+private:
+    int K;                             // Number of clusters
+    int total_values;                  // Number of features per point
+    int total_groups;                  // Number of centroid groups
+    bool bounds_ready;                 // False until the first full pass has set every bound
+    const double *centroids;           // Current K x total_values centroid matrix (owned by KMeans)
+    AlignedBuffer<double> upper;       // Per point: upper bound on the distance to its centroid
+    AlignedBuffer<double> lower;       // Per point: one lower bound per group, excluding the point's own centroid
+    AlignedBuffer<double> previous;    // Centroids of the previous iteration, for the shifts
+    AlignedBuffer<double> shifts;      // How far each centroid moved since the previous iteration
+    AlignedBuffer<double> group_drift; // Per group: largest move of any of its centroids
+    std::vector<int> group_of;         // Group of each centroid
+    std::vector<int> group_begin;      // Group g owns group_members[group_begin[g] .. group_begin[g + 1])
+    std::vector<int> group_members;    // Centroid IDs, ascending within each group
+
+    // Lloyd's algorithm on the initial centroids, seeded with the first total_groups of them (which were picked at
+    // random from the points already), so the grouping is deterministic
+    void groupCentroids()
+    {
+        std::vector<double> group_centers(centroids, centroids + (size_t)total_groups * total_values);
+        group_of.assign(K, 0);
+
+        for (int iteration = 0; iteration < YINYANG_GROUPING_ITERATIONS; iteration++)
+        {
+            for (int c = 0; c < K; c++)
+                group_of[c] = nearestCenterScalar<0>(centroids + (size_t)c * total_values, group_centers.data(),
+                                                     total_groups, total_values);
+
+            std::vector<double> sums((size_t)total_groups * total_values, 0.0);
+            std::vector<int> counts(total_groups, 0);
+            for (int c = 0; c < K; c++)
+            {
+                counts[group_of[c]]++;
+                for (int j = 0; j < total_values; j++)
+                    sums[(size_t)group_of[c] * total_values + j] += centroids[(size_t)c * total_values + j];
+            }
+            for (int g = 0; g < total_groups; g++)
+                if (counts[g] > 0) // An empty group keeps its center
+                    for (int j = 0; j < total_values; j++)
+                        group_centers[(size_t)g * total_values + j] = sums[(size_t)g * total_values + j] / counts[g];
+        }
+
+        group_begin.assign(total_groups + 1, 0);
+        for (int c = 0; c < K; c++)
+            group_begin[group_of[c] + 1]++;
+        for (int g = 0; g < total_groups; g++)
+            group_begin[g + 1] += group_begin[g];
+
+        group_members.assign(K, 0);
+        std::vector<int> next(group_begin.begin(), group_begin.end() - 1);
+        for (int c = 0; c < K; c++)
+            group_members[next[group_of[c]]++] = c;
+    }
+
+    // Group bounds of a point that keeps its centroid
+    void loosen(double *point_lower) const
+    {
+        for (int g = 0; g < total_groups; g++)
+        {
+            double l = point_lower[g] - group_drift[g];
+            point_lower[g] = l > 0.0 ? l : 0.0;
+        }
+    }
+
+    // First iteration: every distance is computed, in cluster order, exactly like nearestCenterScalar
+    int assignAll(const PointMatrix &points, int begin, int end, int32_t *assignments, long long &computed)
+    {
+        std::vector<double> distances(K);
+        int changed = 0;
+
+        for (int i = begin; i < end; i++)
+        {
+            const double *point_values = points.row(i);
+            double *point_lower = lower.data() + (size_t)i * total_groups;
+            double min_dist_sq = DBL_MAX;
+            int id_nearest_center = 0;
+
+            for (int c = 0; c < K; c++)
+            {
+                double dist_sq = squaredDistance<0>(centroids + (size_t)c * total_values, point_values, total_values);
+                distances[c] = dist_sq;
+                if (dist_sq < min_dist_sq)
+                {
+                    min_dist_sq = dist_sq;
+                    id_nearest_center = c;
+                }
+            }
+            computed += K;
+
+            upper[i] = sqrt(min_dist_sq);
+            for (int g = 0; g < total_groups; g++)
+                point_lower[g] = HUGE_VAL;
+            for (int c = 0; c < K; c++)
+                if (c != id_nearest_center && distances[c] < point_lower[group_of[c]])
+                    point_lower[group_of[c]] = distances[c];
+            for (int g = 0; g < total_groups; g++)
+                point_lower[g] = sqrt(point_lower[g]);
+
+            if (assignments[i] != id_nearest_center)
+            {
+                assignments[i] = id_nearest_center;
+                changed++;
+            }
+        }
+        return changed;
+    }
+
+public:
+    YinyangAssigner() : K(0), total_values(0), total_groups(0), bounds_ready(false), centroids(nullptr) {}
+
+    void init(int K, int total_points, int total_values)
+    {
+        this->K = K;
+        this->total_values = total_values;
+        total_groups = K / YINYANG_CENTROIDS_PER_GROUP > 1 ? K / YINYANG_CENTROIDS_PER_GROUP : 1;
+        bounds_ready = false;
+        centroids = nullptr;
+
+        upper.resize(total_points);
+        lower.resize((size_t)total_points * total_groups);
+        previous.resize((size_t)K * total_values);
+        shifts.resize(K);
+        group_drift.resize(total_groups);
+    }
+
+    inline int getTotalGroups() const { return total_groups; }
+
+    // centroids is the K x total_values row-major centroid matrix; it must stay put until the next call
+    void setCentroids(const double *centroids)
+    {
+        bool first_call = this->centroids == nullptr;
+        bounds_ready = !first_call;
+        this->centroids = centroids;
+        if (first_call)
+            groupCentroids();
+
+        tbb::parallel_for(tbb::blocked_range<int>(0, K), [&](const tbb::blocked_range<int> &range)
+                          {
+            for (int c = range.begin(); c < range.end(); c++)
+            {
+                const double *central_values = centroids + (size_t)c * total_values;
+                double *previous_values = previous.data() + (size_t)c * total_values;
+                shifts[c] = first_call ? 0.0 : sqrt(squaredDistance<0>(central_values, previous_values, total_values));
+                memcpy(previous_values, central_values, total_values * sizeof(double));
+            } });
+
+        for (int g = 0; g < total_groups; g++)
+        {
+            group_drift[g] = 0.0;
+            for (int m = group_begin[g]; m < group_begin[g + 1]; m++)
+                if (shifts[group_members[m]] > group_drift[g])
+                    group_drift[g] = shifts[group_members[m]];
+        }
+    }
+
+    // Same contract as ElkanAssigner::assign()
+    int assign(const PointMatrix &points, int begin, int end, int32_t *assignments, long long &computed)
+    {
+        if (!bounds_ready)
+            return assignAll(points, begin, end, assignments, computed);
+
+        // Per group: the two smallest distances (or local-filter bounds) seen in it, and whose the smallest was
+        std::vector<double> group_min(total_groups), group_second(total_groups);
+        std::vector<int> group_min_id(total_groups);
+        std::vector<char> examined(total_groups);
+        int changed = 0;
+
+        for (int i = begin; i < end; i++)
+        {
+            const double *point_values = points.row(i);
+            double *point_lower = lower.data() + (size_t)i * total_groups;
+            int a = assignments[i];
+            double u = upper[i] + shifts[a];
+
+            // Global filter
+            double global_lower = HUGE_VAL;
+            for (int g = 0; g < total_groups; g++)
+            {
+                double l = point_lower[g] - group_drift[g];
+                if (l < global_lower)
+                    global_lower = l;
+            }
+            if (boundSkips(u, global_lower))
+            {
+                upper[i] = u;
+                loosen(point_lower);
+                continue;
+            }
+
+            // Tighten u to the exact distance and try again
+            double dist_sq_a = squaredDistance<0>(centroids + (size_t)a * total_values, point_values, total_values);
+            u = sqrt(dist_sq_a);
+            computed++;
+            if (boundSkips(u, global_lower))
+            {
+                upper[i] = u;
+                loosen(point_lower);
+                continue;
+            }
+
+            int best = a;
+            double best_dist_sq = dist_sq_a, best_dist = u;
+            int group_a = group_of[a];
+
+            for (int g = 0; g < total_groups; g++)
+            {
+                double old_lower = point_lower[g];
+                double l = old_lower - group_drift[g];
+                point_lower[g] = l > 0.0 ? l : 0.0;
+
+                // Group filter
+                examined[g] = !boundSkips(best_dist, point_lower[g]);
+                if (!examined[g])
+                    continue;
+
+                group_min[g] = group_second[g] = HUGE_VAL;
+                group_min_id[g] = -1;
+                for (int m = group_begin[g]; m < group_begin[g + 1]; m++)
+                {
+                    int c = group_members[m];
+                    double value;
+
+                    if (c == a)
+                        value = u;
+                    else
+                    {
+                        // Local filter
+                        double bound = old_lower - shifts[c];
+                        if (boundSkips(best_dist, bound))
+                            value = bound;
+                        else
+                        {
+                            double dist_sq = squaredDistance<0>(centroids + (size_t)c * total_values, point_values, total_values);
+                            value = sqrt(dist_sq);
+                            computed++;
+
+                            // Ties go to the lower cluster ID, like the strictly-less scan of the direct kernels
+                            if (dist_sq < best_dist_sq || (dist_sq == best_dist_sq && c < best))
+                            {
+                                best = c;
+                                best_dist_sq = dist_sq;
+                                best_dist = value;
+                            }
+                        }
+                    }
+
+                    if (value < group_min[g])
+                    {
+                        group_second[g] = group_min[g];
+                        group_min[g] = value;
+                        group_min_id[g] = c;
+                    }
+                    else if (value < group_second[g])
+                        group_second[g] = value;
+                }
+            }
+
+            // New group bounds, excluding whichever centroid the point ends up with
+            for (int g = 0; g < total_groups; g++)
+            {
+                if (examined[g])
+                    point_lower[g] = group_min_id[g] == best ? group_second[g] : group_min[g];
+                else if (g == group_a && best != a && u < point_lower[g])
+                    point_lower[g] = u; // a was excluded from its group's bound while it was the point's centroid
+                if (point_lower[g] < 0.0)
+                    point_lower[g] = 0.0;
+            }
+            upper[i] = best_dist;
+
+            if (assignments[i] != best)
+            {
+                assignments[i] = best;
+                changed++;
+            }
+        }
+        return changed;
+    }
+};
+
+#endif